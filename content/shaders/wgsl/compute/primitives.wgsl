@@ -0,0 +1,240 @@
+// Building blocks of GPU data parallel passes, see ComputePrimitives.h. All kernels share one
+// bind group layout, every operation binds the buffers it uses and a dummy for the rest.
+// Blocks are 1024 items, 256 invocations with 4 consecutive items each.
+//
+// Scan is reduce-then-scan: cs_block_reduce -> cs_scan_partials -> cs_scan_blocks. Decoupled
+// look-back would save a pass but needs forward progress between workgroups, which WebGPU
+// doesn't guarantee.
+// Radix sort is LSD with 4 bits per pass: cs_radix_histogram -> scan of digit-major histogram
+// -> cs_radix_scatter, ranks inside a block are stable so the whole sort is.
+
+struct Params {
+    count: u32,      // items, or segments for cs_segmented_reduce
+    num_blocks: u32,
+    shift: u32,      // radix digit
+    op: u32,         // 0 sum, 1 min, 2 max; for radix passes 1 when values are sorted too
+};
+struct Words {
+    data: array<u32>,
+};
+
+@group(0) @binding(0) var<uniform> p : Params;
+@group(0) @binding(1) var<storage, read> src : Words;
+@group(0) @binding(2) var<storage, read_write> dst : Words;
+@group(0) @binding(3) var<storage, read_write> partials : Words;
+@group(0) @binding(4) var<storage, read> aux : Words; // offsets, scanned flags or histograms
+@group(0) @binding(5) var<storage, read> src_values : Words;
+@group(0) @binding(6) var<storage, read_write> dst_values : Words;
+
+const wg_size: u32 = 256u;
+const per_invo: u32 = 4u;
+const block_items: u32 = 1024u;
+const radix_digits: u32 = 16u;
+
+fn identity() -> u32 {
+    return select(0u, 0xffffffffu, p.op == 1u);
+}
+
+fn combine(a: u32, b: u32) -> u32 {
+    switch p.op {
+        case 1u: { return min(a, b); }
+        case 2u: { return max(a, b); }
+        default: { return a + b; }
+    }
+}
+
+var<workgroup> shared_words: array<u32, 256>;
+
+// tree reduce of shared_words, result in shared_words[0]
+fn workgroupReduce(lid: u32) {
+    for (var stride = wg_size / 2u; stride > 0u; stride >>= 1u) {
+        workgroupBarrier();
+        if lid < stride {
+            shared_words[lid] = combine(shared_words[lid], shared_words[lid + stride]);
+        }
+    }
+    workgroupBarrier();
+}
+
+// work-efficient (Blelloch) exclusive sum of shared_words, returns the total
+fn workgroupExclusiveSum(lid: u32) -> u32 {
+    for (var stride = 1u; stride < wg_size; stride <<= 1u) {
+        workgroupBarrier();
+        let i = (lid + 1u) * stride * 2u - 1u;
+        if i < wg_size {
+            shared_words[i] += shared_words[i - stride];
+        }
+    }
+    workgroupBarrier();
+    let total = shared_words[wg_size - 1u];
+    workgroupBarrier();
+    if lid == 0u { shared_words[wg_size - 1u] = 0u; }
+    for (var stride = wg_size / 2u; stride > 0u; stride >>= 1u) {
+        workgroupBarrier();
+        let i = (lid + 1u) * stride * 2u - 1u;
+        if i < wg_size {
+            let left = shared_words[i - stride];
+            shared_words[i - stride] = shared_words[i];
+            shared_words[i] += left;
+        }
+    }
+    workgroupBarrier();
+    return total;
+}
+
+@compute @workgroup_size(256)
+fn cs_block_reduce(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) lid: u32) {
+    let first = wid.x * block_items + lid * per_invo;
+    var acc = identity();
+    for (var k = 0u; k < per_invo; k++) {
+        if first + k < p.count { acc = combine(acc, src.data[first + k]); }
+    }
+    shared_words[lid] = acc;
+    workgroupReduce(lid);
+    if lid == 0u { partials.data[wid.x] = shared_words[0]; }
+}
+
+// single workgroup, exclusive sum of block partials in place, total goes after the last one
+@compute @workgroup_size(256)
+fn cs_scan_partials(@builtin(local_invocation_index) lid: u32) {
+    let n = p.num_blocks;
+    let run_len = (n + wg_size - 1u) / wg_size;
+    let begin = min(lid * run_len, n);
+    let end = min(begin + run_len, n);
+    var sum = 0u;
+    for (var i = begin; i < end; i++) {
+        sum += partials.data[i];
+    }
+    shared_words[lid] = sum;
+    let total = workgroupExclusiveSum(lid);
+    var run = shared_words[lid];
+    for (var i = begin; i < end; i++) {
+        let v = partials.data[i];
+        partials.data[i] = run;
+        run += v;
+    }
+    if lid == 0u { partials.data[n] = total; }
+}
+
+// 'dst' holds count + 1 entries, the last one is the total
+@compute @workgroup_size(256)
+fn cs_scan_blocks(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) lid: u32) {
+    let first = wid.x * block_items + lid * per_invo;
+    var items: array<u32, 4>;
+    var sum = 0u;
+    for (var k = 0u; k < per_invo; k++) {
+        items[k] = select(0u, src.data[first + k], first + k < p.count);
+        sum += items[k];
+    }
+    shared_words[lid] = sum;
+    workgroupExclusiveSum(lid);
+    var run = partials.data[wid.x] + shared_words[lid];
+    for (var k = 0u; k < per_invo; k++) {
+        if first + k < p.count { dst.data[first + k] = run; }
+        run += items[k];
+    }
+    if wid.x == 0u && lid == 0u { dst.data[p.count] = partials.data[p.num_blocks]; }
+}
+
+// single workgroup, reduces block partials into dst[0]
+@compute @workgroup_size(256)
+fn cs_reduce_final(@builtin(local_invocation_index) lid: u32) {
+    var acc = identity();
+    for (var i = lid; i < p.num_blocks; i += wg_size) {
+        acc = combine(acc, partials.data[i]);
+    }
+    shared_words[lid] = acc;
+    workgroupReduce(lid);
+    if lid == 0u { dst.data[0] = shared_words[0]; }
+}
+
+// one invocation per segment, segment s is src[aux[s]..aux[s + 1]]. Meant for short segments
+// such as cells of a spatial table
+@compute @workgroup_size(64)
+fn cs_segmented_reduce(@builtin(global_invocation_id) gid: vec3u) {
+    let s = gid.x;
+    if s >= p.count { return; }
+    var acc = identity();
+    for (var i = aux.data[s]; i < aux.data[s + 1u]; i++) {
+        acc = combine(acc, src.data[i]);
+    }
+    dst.data[s] = acc;
+}
+
+// aux holds exclusive scan of 0/1 flags (count + 1 entries), kept items are the ones whose
+// offset grows
+@compute @workgroup_size(256)
+fn cs_compact_scatter(@builtin(global_invocation_id) gid: vec3u) {
+    let i = gid.x;
+    if i >= p.count { return; }
+    let offset = aux.data[i];
+    if aux.data[i + 1u] != offset { dst.data[offset] = src.data[i]; }
+}
+
+var<workgroup> digit_counts: array<atomic<u32>, 16>;
+
+fn digitOf(key: u32) -> u32 {
+    return (key >> p.shift) & (radix_digits - 1u);
+}
+
+// partials[digit * num_blocks + block] = keys of the block with that digit
+@compute @workgroup_size(256)
+fn cs_radix_histogram(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) lid: u32) {
+    if lid < radix_digits { atomicStore(&digit_counts[lid], 0u); }
+    workgroupBarrier();
+    let first = wid.x * block_items + lid * per_invo;
+    for (var k = 0u; k < per_invo; k++) {
+        if first + k < p.count { atomicAdd(&digit_counts[digitOf(src.data[first + k])], 1u); }
+    }
+    workgroupBarrier();
+    if lid < radix_digits {
+        partials.data[lid * p.num_blocks + wid.x] = atomicLoad(&digit_counts[lid]);
+    }
+}
+
+// per invocation digit counts, two 16 bit lanes per word (a block has at most 1024 of a digit)
+var<workgroup> lane_counts: array<u32, 2048>; // 8 words x 256 invocations, word major
+
+// aux is exclusive scan of the histogram, output offset of every (digit, block)
+@compute @workgroup_size(256)
+fn cs_radix_scatter(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_index) lid: u32) {
+    let first = wid.x * block_items + lid * per_invo;
+    var keys: array<u32, 4>;
+    var mine: array<u32, 8>;
+    for (var w = 0u; w < 8u; w++) { mine[w] = 0u; }
+    for (var k = 0u; k < per_invo; k++) {
+        keys[k] = select(0u, src.data[first + k], first + k < p.count);
+        if first + k < p.count {
+            let d = digitOf(keys[k]);
+            mine[d / 2u] += 1u << ((d % 2u) * 16u);
+        }
+    }
+    for (var w = 0u; w < 8u; w++) { lane_counts[w * wg_size + lid] = mine[w]; }
+
+    // inclusive Hillis-Steele over invocations, lanes can't overflow into each other
+    for (var offset = 1u; offset < wg_size; offset <<= 1u) {
+        workgroupBarrier();
+        var add: array<u32, 8>;
+        for (var w = 0u; w < 8u; w++) {
+            add[w] = select(0u, lane_counts[w * wg_size + max(lid, offset) - offset], lid >= offset);
+        }
+        workgroupBarrier();
+        for (var w = 0u; w < 8u; w++) { lane_counts[w * wg_size + lid] += add[w]; }
+    }
+    workgroupBarrier();
+
+    var seen: array<u32, 8>; // digits met so far in this invocation, same lanes
+    for (var w = 0u; w < 8u; w++) { seen[w] = 0u; }
+    for (var k = 0u; k < per_invo; k++) {
+        if first + k >= p.count { break; }
+        let d = digitOf(keys[k]);
+        let w = d / 2u;
+        let lane = (d % 2u) * 16u;
+        let before = ((lane_counts[w * wg_size + lid] - mine[w]) >> lane) & 0xffffu;
+        let rank = before + ((seen[w] >> lane) & 0xffffu);
+        seen[w] += 1u << lane;
+        let dst_index = aux.data[d * p.num_blocks + wid.x] + rank;
+        dst.data[dst_index] = keys[k];
+        if p.op != 0u { dst_values.data[dst_index] = src_values.data[first + k]; }
+    }
+}
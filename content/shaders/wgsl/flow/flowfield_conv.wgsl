@@ -10,7 +10,7 @@ alias mtx4 =  mat4x4<f32>;
 struct Args {
     size: v2u32,
     flags: u32,
-    dummy: u32,
+    smooth_radius: u32,
 }
 struct Cells {
     cells: array<u32>,
@@ -22,6 +22,7 @@ struct Vectors {
 @group(0) @binding(0) var<uniform> args : Args; 
 @group(0) @binding(1) var<storage> distances : Cells;
 @group(0) @binding(2) var<storage, read_write> flow_directions : Vectors;
+@group(0) @binding(3) var<storage, read_write> smooth_tmp : Vectors;
 // @group(0) @binding(3) var<storage, write> output_gpu : Vectors;
 
 const dist_mask: u32 = ~(1u<<15u);
@@ -53,75 +54,143 @@ const vecs: array<v2f, 8> = array<v2f, 8>(
 
 override disabled:bool = false;
 
-@compute @workgroup_size(64)
-fn cs_main(@builtin(workgroup_id) gid: vec3u, @builtin(local_invocation_id) lid: vec3u, @builtin(num_workgroups) num_workers: vec3u) {
+// one invocation per cell, a workgroup covers conv_tile x conv_tile cells and loads them with
+// one cell of halo around into shared memory. Cells outside of the map read as oob_val, its wall
+// bit makes them behave like walls. ComputeFields::k_conv_tile
+const conv_tile: u32 = 16u;
+const halo_side: u32 = conv_tile + 2u;
+var<workgroup> tile_dist: array<u32, halo_side * halo_side>;
+
+// neighbours in the same order as vecs, as offsets inside tile_dist
+const tile_offsets: array<i32, 8> = array<i32, 8>(
+    -i32(halo_side) - 1, // top-left
+    -i32(halo_side), // top
+    -i32(halo_side) + 1, // top-right
+    -1, // left
+    1, // right
+    i32(halo_side) - 1, // bot-left
+    i32(halo_side), // bot
+    i32(halo_side) + 1, // bot-right
+);
+
+fn loadDist(cell: vec2i) -> u32 {
+    if any(cell < vec2i(0)) || any(vec2u(cell) >= args.size) { return oob_val; }
+    return distances.cells[u32(cell.y) * args.size.x + u32(cell.x)];
+}
+
+@compute @workgroup_size(conv_tile, conv_tile)
+fn cs_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_id) lid: vec3u,
+    @builtin(local_invocation_index) lidx: u32) {
 
     if disabled { return;}
 
     let k_wallbias: bool = (args.flags & 1u) > 0;
-    let k_smooth: bool = (args.flags & 2u) > 0;
-
-    let loc_idx: u32 = lid.x;
-    let size_1d: u32 = args.size.x * args.size.y;
-    let stride: u32 = (size_1d / (num_workers.x * 64));
-    let group_offset = gid.x * stride * 64;
-    let start_idx: u32 = loc_idx * stride + group_offset;// + stride * 64 * gid.x;
-    if start_idx >= size_1d {
-        return;
+
+    let tile_origin = vec2i(wid.xy * conv_tile) - vec2i(1, 1);
+    for (var i = lidx; i < halo_side * halo_side; i += conv_tile * conv_tile) {
+        tile_dist[i] = loadDist(tile_origin + vec2i(i32(i % halo_side), i32(i / halo_side)));
     }
-    let len: u32 = stride;// select(stride, size_1d  stride, loc_idx == 63);
-    let offsets: array<i32, 8> = array<i32, 8>(
-        -i32(args.size.x) - 1, // top-left
-        -i32(args.size.x) + 0, // top (CW sart)
-        -i32(args.size.x) + 1, // top-right
-        -1, // left
-        1, // right
-        i32(args.size.x) - 1, // bot-left
-        i32(args.size.x) + 0, // bot
-        i32(args.size.x) + 1, // bot-right
-    );
-
-    var c_grid: array<i32, 8> = array(0, 0, 0, 0, 0, 0, 0, 0);
-
-    for (var i: u32 = 0; i < len; i++) {
-        let cur_i: u32 = i + start_idx;
-        let row_x: u32 = cur_i % args.size.x;
-
-        let cell_raw: u32 = distances.cells[cur_i];
-        let cell_val: i32 = i32(cell_raw & dist_mask);
+    workgroupBarrier();
+
+    let cell = wid.xy * conv_tile + lid.xy;
+    if any(cell >= args.size) { return; }
+    let cur_i = cell.y * args.size.x + cell.x;
+    let center = i32((lid.y + 1u) * halo_side + lid.x + 1u);
 
+    let cell_raw: u32 = tile_dist[center];
+    let cell_val: i32 = i32(cell_raw & dist_mask);
+    let skip_blocked = (cell_raw & (1u << 15u)) != 0;
+    if skip_blocked || (cell_val == 0) {
         flow_directions.cells[cur_i] = v2f(0, 0);
+        return;
+    }
 
-        let skip_blocked = u32(cell_raw & (1u << 15u)) != 0;
-        if skip_blocked || (cell_val == 0) { continue;}
+    let wall_val: i32 = cell_val + i32(k_wallbias) * 1;
+    var r: v2f = v2f();
+    for (var j: i32 = 0; j < 8; j++) {
+        let neighbor_val: u32 = tile_dist[center + tile_offsets[j]];
+        let neighbor_wall: bool = (neighbor_val & (1u << 15u)) > 0;
+        let n = select(i32(neighbor_val & dist_mask), wall_val, neighbor_wall);
+        r += vecs[j] * f32(sign(cell_val - n));
+    }
 
-        let wall_val: i32 = cell_val + i32(k_wallbias) * 1;
+    flow_directions.cells[cur_i] = select(v2f(0, 0), normalize(r), r.x != 0 || r.y != 0);
+}
 
-        for (var j: i32 = 0; j < 8; j++) {
-            let loc_offset: u32 = u32(offsets[j] + i32(cur_i));
-            let loc_row_x: u32 = loc_offset % args.size.x;
+// smoothing: one workgroup handles a run of 64 cells along a row (or a column) and loads
+// it together with max_radius halo on both sides into shared memory once.
+override smooth_vertical: bool = false;
+const max_radius: u32 = 8u; // ComputeFields::k_max_smooth_radius
+const tile_len: u32 = 64u + 2u * max_radius;
+var<workgroup> tile_vec: array<v2f, tile_len>;
+var<workgroup> tile_open: array<u32, tile_len>; // 0 for walls and cells outside of map
+
+fn smoothLoad(line: u32, pos: i32, line_len: u32) -> v2f {
+    if pos < 0 || u32(pos) >= line_len { return v2f(0, 0); }
+    let idx = select(line * args.size.x + u32(pos), u32(pos) * args.size.x + line, smooth_vertical);
+    return select(flow_directions.cells[idx], smooth_tmp.cells[idx], smooth_vertical);
+}
 
-            let oob: bool = (loc_offset >= size_1d) || (abs(i32(loc_row_x) - i32(row_x)) > 22);
-            // test grid boundry
-            c_grid[j] = wall_val;
-            if oob {continue;}
-            let neighbor_val: u32 = distances.cells[loc_offset];
-            let neighbor_wall: bool = (neighbor_val & (1u << 15u)) > 0;
-            c_grid[j] = select(i32(neighbor_val & dist_mask), wall_val, neighbor_wall);
-        }
+fn smoothIsOpen(line: u32, pos: i32, line_len: u32) -> u32 {
+    if pos < 0 || u32(pos) >= line_len { return 0u; }
+    let idx = select(line * args.size.x + u32(pos), u32(pos) * args.size.x + line, smooth_vertical);
+    let raw = distances.cells[idx];
+    // goal and unreachable cells have no direction to contribute
+    return u32((raw & (1u << 15u)) == 0 && (raw & dist_mask) != 0);
+}
 
-        var r: v2f = v2f();
-        for (var j: i32 = 0; j < 8; j++) {
-            let sign_val = sign(cell_val - c_grid[j]) ;// > 0;
-            var v: v2f = vecs[j] * f32(sign_val);
-            //v *= f32(c_grid[j] != 0);
-            r += v;
+@compute @workgroup_size(64)
+fn cs_postprocess_main(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_id) lid: vec3u) {
+    // horizontal pass: flow_directions -> smooth_tmp, vertical: smooth_tmp -> flow_directions
+    let line_len = select(args.size.x, args.size.y, smooth_vertical);
+    let num_lines = select(args.size.y, args.size.x, smooth_vertical);
+    let line = wid.y;
+    let run_start = i32(wid.x * 64u);
+    let radius = i32(min(args.smooth_radius, max_radius));
+
+    // wid.y is uniform for the group so early exit does not break barrier below
+    if line >= num_lines { return; }
+
+    let pos = run_start + i32(lid.x);
+    let tile_pos = lid.x + max_radius;
+    tile_vec[tile_pos] = smoothLoad(line, pos, line_len);
+    tile_open[tile_pos] = smoothIsOpen(line, pos, line_len);
+    if lid.x < 2u * max_radius {
+        // first 16 threads fill the halo, left side then right side
+        let halo_pos = select(run_start - i32(max_radius) + i32(lid.x),
+            run_start + 64 + i32(lid.x) - i32(max_radius), lid.x >= max_radius);
+        let halo_tile = select(lid.x, lid.x + 64u, lid.x >= max_radius);
+        tile_vec[halo_tile] = smoothLoad(line, halo_pos, line_len);
+        tile_open[halo_tile] = smoothIsOpen(line, halo_pos, line_len);
+    }
+    workgroupBarrier();
+
+    if pos >= i32(line_len) { return; }
+    let out_idx = select(line * args.size.x + u32(pos), u32(pos) * args.size.x + line, smooth_vertical);
+
+    var r = tile_vec[tile_pos];
+    if tile_open[tile_pos] != 0u {
+        r *= f32(radius + 1);
+        // triangle weights, walk away from the center until the first wall on each side
+        // so flow never leaks through thin walls
+        var open_l = true;
+        var open_r = true;
+        for (var d: i32 = 1; d <= radius; d++) {
+            let w = f32(radius + 1 - d);
+            let l = u32(i32(tile_pos) - d);
+            let rt = u32(i32(tile_pos) + d);
+            open_l = open_l && tile_open[l] != 0u;
+            open_r = open_r && tile_open[rt] != 0u;
+            r += select(v2f(0, 0), tile_vec[l] * w, open_l);
+            r += select(v2f(0, 0), tile_vec[rt] * w, open_r);
         }
+        // keep original direction if neighbours cancel it out
+        r = select(tile_vec[tile_pos], normalize(r), dot(r, r) > 1e-6);
+    }
 
-        flow_directions.cells[cur_i] = select(v2f(0, 0), normalize(r), r.x != 0 || r.y != 0);
+    if smooth_vertical {
+        flow_directions.cells[out_idx] = r;
+    } else {
+        smooth_tmp.cells[out_idx] = r;
     }
 }
-
-@compute @workgroup_size(64)
-fn cs_postprocess_main(@builtin(global_invocation_id) gid: vec3u, @builtin(local_invocation_id) lid: vec3u) {
-}
\ No newline at end of file
@@ -0,0 +1,33 @@
+// replace_start
+const pi : f32 = 3.14159265359;
+const pi2 : f32 = pi * 2;
+alias v2f = vec2<f32>;
+alias v4f = vec4<f32>;
+alias v2u32 = vec2<u32>;
+alias mtx4 =  mat4x4<f32>;
+// replace_end
+
+// Copies final flow field of flowfield_conv.wgsl into a filterable texture, particles sample it
+// bilinearly instead of snapping to the direction of their cell. rg16float can't be a storage
+// texture in core WebGPU, so flow lives in xy of rgba16float.
+
+struct Args {
+    size: v2u32,
+    flags: u32,
+    smooth_radius: u32,
+}
+struct Vectors {
+    cells: array<v2f>,
+};
+
+@group(0) @binding(0) var<uniform> args : Args;
+@group(0) @binding(1) var<storage, read> flow_directions : Vectors;
+@group(0) @binding(2) var flow_tex : texture_storage_2d<rgba16float, write>;
+
+// ComputeFields::k_tex_tile
+@compute @workgroup_size(8, 8)
+fn cs_to_texture(@builtin(global_invocation_id) gid: vec3u) {
+    if any(gid.xy >= args.size) { return; }
+    let flow = flow_directions.cells[gid.y * args.size.x + gid.x];
+    textureStore(flow_tex, gid.xy, v4f(flow, 0, 0));
+}
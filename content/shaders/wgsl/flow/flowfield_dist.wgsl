@@ -0,0 +1,207 @@
+// replace_start
+const pi : f32 = 3.14159265359;
+const pi2 : f32 = pi * 2;
+alias v2f = vec2<f32>;
+alias v4f = vec4<f32>;
+alias v2i32 = vec2<i32>;
+alias v2u32 = vec2<u32>;
+alias mtx4 =  mat4x4<f32>;
+// replace_end
+
+// GPU distance solver - same metric as CPU BFS (every step costs 1), computed by iterative
+// relaxation over 8x8 tiles. Only tiles that changed last iteration (and their neighbours)
+// are relaxed, their list is rebuilt every iteration and consumed by indirect dispatch so a
+// converged field costs empty dispatches only. Args of that dispatch are written by
+// cs_write_args of flowfield_dist_args.wgsl, on its own bind group.
+// Crowd feedback: cs_apply_density turns particle density into extra cost of entering a cell
+// (kept in open_cells) and marks tiles whose cost changed. Relaxation recomputes every cell
+// from its neighbours instead of only lowering it, so raised costs propagate without restart.
+
+struct Args {
+    size: v2u32,
+    tiles: v2u32,
+    goal: v2u32,
+    flags: u32, // 1 - allow diagonal
+    // see CrowdCost in ParticleSymCpu.h
+    density_weight: f32,
+    density_comfort: f32,
+    max_extra_cost: u32,
+    padding: v2u32,
+};
+struct Cells {
+    cells: array<u32>,
+};
+struct Control {
+    iteration: u32,
+    frontier_len: atomic<u32>,
+    last_frontier_len: u32,
+    dummy: u32,
+};
+
+@group(0) @binding(0) var<uniform> args : Args;
+// cost of entering the cell, 0 blocked. Map upload writes 1, cs_apply_density adds crowd cost
+@group(0) @binding(1) var<storage, read_write> open_cells : Cells;
+@group(0) @binding(2) var<storage, read_write> dist : Cells;
+@group(0) @binding(3) var<storage, read_write> tile_stamp : Cells; // iteration of last change
+@group(0) @binding(4) var<storage, read_write> frontier : Cells;
+@group(0) @binding(5) var<storage, read_write> control : Control;
+@group(0) @binding(6) var<storage, read_write> out_cells : Cells; // ProcessedData layout
+struct Density {
+    cells: array<v4f>,
+};
+// x particles, w their speed relative to max, written by cs_density of flowfield_hash.wgsl
+@group(0) @binding(7) var<storage, read> density : Density;
+
+const inf: u32 = 0xffffffffu;
+const blocked_bit: u32 = 1u << 15u;
+const dist_max: u32 = 0x7fffu;
+const tile_sz: u32 = 8u;
+const halo_sz: u32 = tile_sz + 2u;
+const inner_steps: u32 = 16u; // enough for a path to cross the tile twice
+// pads the last dispatch row of the frontier, see flowfield_dist_args.wgsl
+const no_tile: u32 = 0xffffffffu;
+// size of per cell and per tile passes, WorkgroupTuning picks it
+override wg_size: u32 = 64u;
+
+fn cellIdx(xy: v2u32) -> u32 { return xy.y * args.size.x + xy.x; }
+
+@compute @workgroup_size(wg_size)
+fn cs_init(@builtin(global_invocation_id) gid: vec3u) {
+    let num_cells = args.size.x * args.size.y;
+    let num_tiles = args.tiles.x * args.tiles.y;
+    let idx = gid.x;
+    if idx < num_cells {
+        dist.cells[idx] = select(inf, 0u, idx == cellIdx(args.goal));
+    }
+    if idx < num_tiles {
+        let goal_tile = (args.goal.y / tile_sz) * args.tiles.x + args.goal.x / tile_sz;
+        // goal tile is 'changed' in iteration 0 and seeds the first frontier
+        tile_stamp.cells[idx] = select(inf, 0u, idx == goal_tile);
+    }
+    if idx == 0u {
+        control.iteration = 0u;
+        atomicStore(&control.frontier_len, 0u);
+        control.last_frontier_len = 1u;
+    }
+}
+
+@compute @workgroup_size(wg_size)
+fn cs_build_frontier(@builtin(global_invocation_id) gid: vec3u) {
+    let num_tiles = args.tiles.x * args.tiles.y;
+    let t = gid.x;
+    if t >= num_tiles { return; }
+    let it = control.iteration;
+    let tx = i32(t % args.tiles.x);
+    let ty = i32(t / args.tiles.x);
+    var active = false;
+    for (var dy: i32 = -1; dy <= 1; dy++) {
+        for (var dx: i32 = -1; dx <= 1; dx++) {
+            let nx = tx + dx;
+            let ny = ty + dy;
+            if nx < 0 || ny < 0 || nx >= i32(args.tiles.x) || ny >= i32(args.tiles.y) { continue; }
+            active = active || tile_stamp.cells[u32(ny) * args.tiles.x + u32(nx)] == it;
+        }
+    }
+    if active {
+        frontier.cells[atomicAdd(&control.frontier_len, 1u)] = t;
+    }
+}
+
+// same as CrowdCost::cost
+fn crowdCost(d: v4f) -> u32 {
+    let crowd = max(d.x - args.density_comfort, 0.0) * (1.0 - d.w);
+    return 1u + min(u32(crowd * args.density_weight), args.max_extra_cost);
+}
+
+// runs before the frontier build, tiles stamped with the current iteration join the frontier
+// along with their neighbours
+@compute @workgroup_size(wg_size)
+fn cs_apply_density(@builtin(global_invocation_id) gid: vec3u) {
+    let idx = gid.x;
+    if idx >= args.size.x * args.size.y { return; }
+    let old_cost = open_cells.cells[idx];
+    if old_cost == 0u { return; }
+    let cost = crowdCost(density.cells[idx]);
+    if cost == old_cost { return; }
+    open_cells.cells[idx] = cost;
+    let xy = v2u32(idx % args.size.x, idx / args.size.x);
+    tile_stamp.cells[(xy.y / tile_sz) * args.tiles.x + xy.x / tile_sz] = control.iteration;
+}
+
+var<workgroup> tile_dist: array<u32, 100>; // halo_sz * halo_sz
+var<workgroup> tile_changed: atomic<u32>;
+
+fn tileLoad(origin: vec2<i32>, local: u32) {
+    let xy = origin + vec2<i32>(i32(local % halo_sz), i32(local / halo_sz)) - vec2<i32>(1, 1);
+    var v = inf;
+    if xy.x >= 0 && xy.y >= 0 && u32(xy.x) < args.size.x && u32(xy.y) < args.size.y {
+        v = dist.cells[cellIdx(v2u32(xy))];
+    }
+    tile_dist[local] = v;
+}
+
+@compute @workgroup_size(8, 8)
+fn cs_relax(@builtin(workgroup_id) wid: vec3u, @builtin(local_invocation_id) lid: vec3u,
+    @builtin(local_invocation_index) lidx: u32, @builtin(num_workgroups) num_groups: vec3u) {
+    let t = frontier.cells[wid.y * num_groups.x + wid.x];
+    // padding groups can't return early (barriers below), they just see an empty tile
+    let valid = t != no_tile;
+    let tile_xy = select(v2u32(0u, 0u), v2u32(t % args.tiles.x, t / args.tiles.x), valid);
+    let origin = vec2<i32>(tile_xy * tile_sz);
+
+    if lidx == 0u { atomicStore(&tile_changed, 0u); }
+    tileLoad(origin, lidx);
+    if lidx < 100u - 64u { tileLoad(origin, lidx + 64u); }
+    workgroupBarrier();
+
+    let xy = origin + vec2<i32>(lid.xy);
+    let inside = valid && u32(xy.x) < args.size.x && u32(xy.y) < args.size.y;
+    let cost = select(0u, open_cells.cells[cellIdx(v2u32(xy))], inside);
+    let walkable = cost != 0u;
+    let is_goal = inside && all(v2u32(xy) == args.goal);
+    let diag = (args.flags & 1u) != 0u;
+    let center = (lid.y + 1u) * halo_sz + lid.x + 1u;
+    var changed = false;
+
+    for (var step: u32 = 0u; step < inner_steps; step++) {
+        // recomputed from neighbours (not min with itself), raised costs raise distances too
+        var best = select(tile_dist[center], select(inf, 0u, is_goal), walkable);
+        if walkable && !is_goal {
+            for (var dy: i32 = -1; dy <= 1; dy++) {
+                for (var dx: i32 = -1; dx <= 1; dx++) {
+                    let is_diag = dx != 0 && dy != 0;
+                    if (dx == 0 && dy == 0) || (is_diag && !diag) { continue; }
+                    let n = tile_dist[u32(i32(center) + dy * i32(halo_sz) + dx)];
+                    // blocked neighbours always hold inf so they never propagate
+                    if n != inf { best = min(best, n + cost); }
+                }
+            }
+        }
+        workgroupBarrier();
+        if best != tile_dist[center] {
+            tile_dist[center] = best;
+            changed = true;
+        }
+        workgroupBarrier();
+    }
+
+    if changed {
+        dist.cells[cellIdx(v2u32(xy))] = tile_dist[center];
+        atomicStore(&tile_changed, 1u);
+    }
+    workgroupBarrier();
+    if lidx == 0u && valid && atomicLoad(&tile_changed) != 0u {
+        tile_stamp.cells[t] = control.iteration;
+    }
+}
+
+// converts solver state into ProcessedData layout read by flow field & heatmap
+@compute @workgroup_size(wg_size)
+fn cs_finalize(@builtin(global_invocation_id) gid: vec3u) {
+    let idx = gid.x;
+    if idx >= args.size.x * args.size.y { return; }
+    let d = dist.cells[idx];
+    // unreachable cells stay 0, same as CPU BFS
+    let val = select(min(d, dist_max), 0u, d == inf);
+    out_cells.cells[idx] = select(val, blocked_bit, open_cells.cells[idx] == 0u);
+}
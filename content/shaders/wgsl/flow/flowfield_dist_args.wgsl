@@ -0,0 +1,53 @@
+// replace_start
+const pi : f32 = 3.14159265359;
+const pi2 : f32 = pi * 2;
+alias v2f = vec2<f32>;
+alias v4f = vec4<f32>;
+alias v2i32 = vec2<i32>;
+alias v2u32 = vec2<u32>;
+alias mtx4 =  mat4x4<f32>;
+// replace_end
+
+// Turns the frontier built by cs_build_frontier of flowfield_dist.wgsl into indirect args of
+// cs_relax and starts the next iteration. Args are writable only in this bind group: cs_relax
+// is dispatched from them, a buffer can't be writable storage and indirect in one dispatch.
+
+struct Control {
+    iteration: u32,
+    frontier_len: u32,
+    last_frontier_len: u32,
+    dummy: u32,
+};
+struct Cells {
+    cells: array<u32>,
+};
+struct DispatchArgs {
+    x: u32,
+    y: u32,
+    z: u32,
+};
+
+@group(0) @binding(0) var<storage, read_write> control : Control;
+@group(0) @binding(1) var<storage, read_write> frontier : Cells;
+@group(0) @binding(2) var<storage, read_write> indirect_args : DispatchArgs;
+
+// frontier is dispatched as rows of this many groups to stay under per-dimension limit,
+// GpuDistanceSolver::k_frontier_row
+const frontier_row: u32 = 256u;
+const no_tile: u32 = 0xffffffffu; // same as flowfield_dist.wgsl
+
+@compute @workgroup_size(1)
+fn cs_write_args() {
+    let len = control.frontier_len;
+    let rows = (len + frontier_row - 1u) / frontier_row;
+    indirect_args.x = min(len, frontier_row);
+    indirect_args.y = rows;
+    indirect_args.z = 1u;
+    // pad last row, those groups run but skip all work
+    for (var i = len; i < rows * frontier_row; i++) {
+        frontier.cells[i] = no_tile;
+    }
+    control.last_frontier_len = len;
+    control.frontier_len = 0u;
+    control.iteration += 1u;
+}
@@ -16,7 +16,7 @@ struct Args {
     cell_size: v2f,
 
     num_particles: u32,
-    table_depth: u32,
+    table_cells: u32, // spatial_table_size.x * spatial_table_size.y
 
     speed_base: f32,
     radius: f32,
@@ -28,85 +28,232 @@ struct Args {
     speed_max: f32,
 
     delta_time: f32,
-    flags: u32,     
+    flags: u32,
+    num_groups: u32,
+    wall_subdiv: u32,
 };
 
 struct Vectors {
     cells: array<v2f>,
 }; 
-struct Particle {
-    pos: v2f,
-    vel: v2f,
-}
-struct ParticleData {
-    data: array<Particle>,
-};  
-struct IndexEntry { 
-    index: atomic<u32>, 
-}  
-struct HelperAtomicTable {
-    cells: array<IndexEntry>,
-}; 
-struct Table {
-    cells: array<i32>,
-};  
-struct Dbg {
+struct Density {
+    cells: array<v4f>,
+};
+// particle storage, see ParticleFormat: 4 words (f32 pos, vel) or 2 words when packed
+// (unorm16 pos relative to grid rect, f16 vel)
+struct ParticleWords {
+    words: array<u32>,
+};
+struct Counters {
+    cells: array<atomic<u32>>,
+};
+struct Indices {
     cells: array<u32>,
-};  
+};
+struct Slots {
+    cells: array<v2u32>,
+};
+struct Control {
+    live: u32,
+    spawn_count: u32,
+    capacity: u32,
+    arrived: u32,
+    disorder: atomic<u32>, // neighbours in buffer order that are far apart in the table
+};
+
+// Exact spatial hash built by counting sort, no per-cell capacity:
+// cs_zero -> cs_count (histogram + rank inside cell) -> exclusive scan of cell_count into
+// cell_start (wgfx::compute::ScanPlan, primitives.wgsl) -> cs_scatter -> cs_order. Particles of
+// cell c are
+// sorted[cell_start[c]..cell_start[c + 1]], their positions are copied to sorted_pos.
+// With sort_key_morton the same passes (without cs_order) sort particles by Morton code of
+// their map cell instead, flowfield_ps_resort.wgsl then moves them into that order.
+@group(0) @binding(0) var<uniform> u : Args;
+@group(0) @binding(1) var<storage, read> particles: ParticleWords;
+@group(0) @binding(2) var<storage, read> cell_start : Indices; // table_cells + 1 entries
+@group(0) @binding(3) var<storage, read_write> sorted : Indices; // particle indices
+@group(0) @binding(4) var<storage, read_write> slots : Slots; // per particle (cell, rank)
+@group(0) @binding(5) var<storage, read_write> sorted_pos : Vectors; // same order as sorted
+@group(0) @binding(6) var<storage, read_write> control : Control; // see flowfield_ps_life.wgsl
+// per map cell: x particle count, yz average velocity, w its speed relative to speed_max.
+// Written by cs_density, read by flowfield_dist.wgsl as crowd cost
+@group(0) @binding(7) var<storage, read_write> density : Density;
+@group(0) @binding(8) var<storage, read_write> cell_count : Counters; // table_cells entries
 
-@group(0) @binding(0) var<uniform> u : Args;  
-@group(0) @binding(1) var<storage, read> particles: ParticleData; 
-@group(0) @binding(2) var<storage, read_write> help_table : HelperAtomicTable;  
-@group(0) @binding(3) var<storage, read_write> table : Table; 
-@group(0) @binding(4) var<storage, read_write> dbg : Dbg; 
+override packed_particles: bool = false;
+override sort_key_morton: bool = false;
+// size of per table cell and per map cell passes, WorkgroupTuning picks it. Per particle passes
+// stay at 64, their dispatch args are written on GPU by flowfield_ps_life.wgsl
+override wg_size: u32 = 64u;
 
-fn hash(pos: v2i32) -> u32 {
-    return u32(pos.x) | (u32(pos.y) << 12);
+fn loadPos(i: u32) -> v2f {
+    if packed_particles {
+        return u.grid_min + unpack2x16unorm(particles.words[i * 2u]) * u.grid_size;
+    }
+    return bitcast<v2f>(v2u32(particles.words[i * 4u], particles.words[i * 4u + 1u]));
 }
- 
-@compute @workgroup_size(64)  
-fn cs_zero(@builtin(workgroup_id) wgid: vec3u, @builtin(global_invocation_id) gid: vec3u, @builtin(num_workgroups) num_groups: vec3u) {
-
-    let total_size_1d = u.spatial_table_size.x * u.spatial_table_size.y;
-    let per_invo = total_size_1d / (num_groups.x * 64) + 1;
-    let start = gid.x * per_invo;
-    for (var line_idx = u32(start); line_idx < start + per_invo; line_idx++) {
-        if line_idx >= total_size_1d {return;}
-        atomicStore(&help_table.cells[line_idx].index, 0u);
-        let loc_idx = line_idx * u.table_depth;
-        for (var i = 0u; i < u.table_depth; i++) {
-            table.cells[loc_idx + i] = -1;
-        }
+
+fn loadVel(i: u32) -> v2f {
+    if packed_particles {
+        return unpack2x16float(particles.words[i * 2u + 1u]);
+    }
+    return bitcast<v2f>(v2u32(particles.words[i * 4u + 2u], particles.words[i * 4u + 3u]));
+}
+
+fn particleCell(pos: v2f) -> u32 {
+    let orig = u.grid_min + v2f(0, u.grid_size.y);
+    let cell_sz = u.grid_size.y / f32(u.spatial_table_size.y);
+    let pos_rel = pos - orig;
+    let cell_x = min(u32(pos_rel.x / cell_sz), u.spatial_table_size.x - 1u);
+    let cell_y = min(u32(abs(pos_rel.y) / cell_sz), u.spatial_table_size.y - 1u);
+    return cell_y * u.spatial_table_size.x + cell_x;
+}
+
+fn spreadBits(v: u32) -> u32 {
+    var x = v & 0xffffu;
+    x = (x | (x << 8u)) & 0x00ff00ffu;
+    x = (x | (x << 4u)) & 0x0f0f0f0fu;
+    x = (x | (x << 2u)) & 0x33333333u;
+    x = (x | (x << 1u)) & 0x55555555u;
+    return x;
+}
+
+// Morton codes of map cells fill a power of two square
+fn mortonSide() -> u32 {
+    let side = max(max(u.size.x, u.size.y), 1u);
+    return 1u << (32u - countLeadingZeros(side - 1u));
+}
+
+fn mortonCell(pos: v2f) -> u32 {
+    let rel = (pos - u.grid_min) / u.cell_size;
+    let cell_x = min(u32(max(rel.x, 0.0)), u.size.x - 1u);
+    let cell_y = min(u32(max(rel.y, 0.0)), u.size.y - 1u);
+    return spreadBits(cell_x) | (spreadBits(cell_y) << 1u);
+}
+
+fn keyCount() -> u32 {
+    if sort_key_morton {
+        let side = mortonSide();
+        return side * side;
     }
+    return u.table_cells;
 }
 
-override disabled = true;
+@compute @workgroup_size(wg_size)
+fn cs_zero(@builtin(global_invocation_id) gid: vec3u) {
+    if gid.x == 0u { atomicStore(&control.disorder, 0u); }
+    if gid.x >= keyCount() { return; }
+    atomicStore(&cell_count.cells[gid.x], 0u);
+}
 
-@compute @workgroup_size(64)  
-fn cs_count(@builtin(global_invocation_id)  gid: vec3u, @builtin(local_invocation_id) lid: vec3u) {
+@compute @workgroup_size(64)
+fn cs_count(@builtin(global_invocation_id) gid: vec3u) {
     let particle_idx: u32 = gid.x;
+    if particle_idx >= control.live { return; }
+    let pos = loadPos(particle_idx);
+    let cell = select(particleCell(pos), mortonCell(pos), sort_key_morton);
+    let rank = atomicAdd(&cell_count.cells[cell], 1u);
+    slots.cells[particle_idx] = v2u32(cell, rank);
+}
 
-    if particle_idx >= u.num_particles {return;}
-    let pos = particles.data[particle_idx].pos;
+@compute @workgroup_size(64)
+fn cs_scatter(@builtin(global_invocation_id) gid: vec3u) {
+    let particle_idx: u32 = gid.x;
+    if particle_idx >= control.live { return; }
+    let slot = slots.cells[particle_idx];
+    sorted.cells[cell_start.cells[slot.x] + slot.y] = particle_idx;
 
-    let orig = u.grid_min + v2f(0, u.grid_size.y); // -8,8
-    let cell_sz = u.grid_size.y / f32(u.spatial_table_size.y);
-    let pos_rel = pos - orig;
-    var cell_x = u32(pos_rel.x / cell_sz);
-    var cell_y = u32(abs(pos_rel.y) / cell_sz);
-    cell_x = min(cell_x, u.spatial_table_size.x);
-    cell_y = min(cell_y, u.spatial_table_size.y);
-    let this_cell: v2i32 = v2i32(i32(cell_x), i32(cell_y));
-    let table_idx = cell_y * u.spatial_table_size.x + cell_x;
-
-   // dbg.cells[particle_idx * 4] = u32(cell_x);
-    let write_pos: u32 = atomicAdd(&help_table.cells[table_idx].index, 1u);
-    //workgroupBarrier();
-    // dbg.cells[particle_idx * 4 + 1] = u32(cell_y);
-    // dbg.cells[particle_idx * 4 + 2] = u32(table_idx);
-    // dbg.cells[particle_idx * 4 + 3] = u32(write_pos);
-    let do_not_modify: bool = write_pos >= u.table_depth;
-    if do_not_modify == false {
-        table.cells[table_idx + write_pos] = i32(particle_idx);
+    // buffer neighbours further apart than adjacent cells, read back for the resort heuristic
+    if particle_idx > 0u && !sort_key_morton {
+        let w = u.spatial_table_size.x;
+        let prev = slots.cells[particle_idx - 1u].x;
+        let dx = abs(i32(slot.x % w) - i32(prev % w));
+        let dy = abs(i32(slot.x / w) - i32(prev / w));
+        if dx > 1 || dy > 1 { atomicAdd(&control.disorder, 1u); }
+    }
+}
+
+// cells up to this many particles are insertion sorted, longer ones (crowds piled up in one
+// table cell) heap sorted so one invocation stays O(k log k)
+const insertion_sort_max: u32 = 16u;
+
+fn swapSorted(a: u32, b: u32) {
+    let v = sorted.cells[a];
+    sorted.cells[a] = sorted.cells[b];
+    sorted.cells[b] = v;
+}
+
+// max-heap of sorted[base..base + n], restores it below 'root'
+fn siftDown(base: u32, root_in: u32, n: u32) {
+    var root = root_in;
+    loop {
+        var child = root * 2u + 1u;
+        if child >= n { break; }
+        if child + 1u < n && sorted.cells[base + child] < sorted.cells[base + child + 1u] {
+            child++;
+        }
+        if sorted.cells[base + root] >= sorted.cells[base + child] { break; }
+        swapSorted(base + root, base + child);
+        root = child;
+    }
+}
+
+fn heapSort(base: u32, n: u32) {
+    for (var i = n / 2u; i > 0u; i--) {
+        siftDown(base, i - 1u, n);
+    }
+    for (var last = n - 1u; last > 0u; last--) {
+        swapSorted(base, base + last);
+        siftDown(base, 0u, last);
+    }
+}
+
+// ranks from cs_count depend on atomic order, sorting each cell by particle index makes the
+// neighbour order and so the solver's float sums identical between runs
+@compute @workgroup_size(wg_size)
+fn cs_order(@builtin(global_invocation_id) gid: vec3u) {
+    let cell = gid.x;
+    if cell >= u.table_cells { return; }
+    let begin = cell_start.cells[cell];
+    let end = cell_start.cells[cell + 1u];
+    if end - begin > insertion_sort_max {
+        heapSort(begin, end - begin);
+    } else {
+        for (var i = begin + 1u; i < end; i++) {
+            let v = sorted.cells[i];
+            var j = i;
+            while j > begin && sorted.cells[j - 1u] > v {
+                sorted.cells[j] = sorted.cells[j - 1u];
+                j--;
+            }
+            sorted.cells[j] = v;
+        }
+    }
+    for (var i = begin; i < end; i++) {
+        sorted_pos.cells[i] = loadPos(sorted.cells[i]);
+    }
+}
+
+// splats the table into map cells, runs after cs_order. Table cells split map cells evenly
+// (spatial_table_size = size * subdiv) so every map cell just sums its subdiv^2 table cells
+@compute @workgroup_size(wg_size)
+fn cs_density(@builtin(global_invocation_id) gid: vec3u) {
+    let idx = gid.x;
+    if idx >= u.size.x * u.size.y { return; }
+    let subdiv = max(u.spatial_table_size.x / max(u.size.x, 1u), 1u);
+    let cell = v2u32(idx % u.size.x, idx / u.size.x) * subdiv;
+    var count = 0u;
+    var vel = v2f(0.0, 0.0);
+    for (var sy = 0u; sy < subdiv; sy++) {
+        let row = (cell.y + sy) * u.spatial_table_size.x + cell.x;
+        let begin = cell_start.cells[row];
+        let end = cell_start.cells[row + subdiv];
+        for (var i = begin; i < end; i++) {
+            vel += loadVel(sorted.cells[i]);
+        }
+        count += end - begin;
     }
+    let avg = select(v2f(0.0, 0.0), vel / f32(count), count > 0u);
+    let speed = clamp(length(avg) / max(u.speed_max, 1e-4), 0.0, 1.0);
+    density.cells[idx] = v4f(f32(count), avg, speed);
 }
@@ -0,0 +1,59 @@
+// replace_start
+const pi : f32 = 3.14159265359;
+const pi2 : f32 = pi * 2;
+alias v2f = vec2<f32>;
+alias v4f = vec4<f32>;
+alias v2i32 = vec2<i32>;
+alias v2u32 = vec2<u32>;
+alias mtx4 =  mat4x4<f32>;
+// replace_end
+
+// Publishes the live count after append and compaction of flowfield_ps_life.wgsl and turns it
+// into indirect args for particle passes. Args are writable only in this bind group, which is
+// never set while a pass dispatches from them: a buffer bound as writable storage can't be the
+// indirect buffer of the same dispatch. Both kernels are dispatched directly, 1x1x1.
+
+struct Control {
+    live: u32,
+    spawn_count: u32, // written by CPU before the frame, consumed by cs_append_commit
+    capacity: u32,
+    arrived: u32,
+};
+struct Cells {
+    cells: array<u32>,
+};
+// ParticleSym::IndirectArgs
+struct DispatchArgs {
+    x: u32,
+    y: u32,
+    z: u32,
+    padding: u32,
+};
+
+@group(0) @binding(0) var<storage, read_write> control : Control;
+@group(0) @binding(1) var<storage, read> offsets : Cells; // see cs_compact_scan
+@group(0) @binding(2) var<storage, read_write> indirect : DispatchArgs;
+
+const particle_wg: u32 = 64u; // workgroup size of every per particle pass
+
+fn particleGroups(live: u32) -> u32 {
+    return (live + particle_wg - 1u) / particle_wg;
+}
+
+@compute @workgroup_size(1)
+fn cs_append_commit() {
+    let live = min(control.live + control.spawn_count, control.capacity);
+    control.live = live;
+    control.spawn_count = 0u;
+    indirect.x = particleGroups(live);
+}
+
+@compute @workgroup_size(1)
+fn cs_compact_commit() {
+    if control.arrived == 0u { return; }
+    // offsets[blocks] holds the new live count, blocks are particle_wg wide
+    let live = offsets.cells[particleGroups(control.live)];
+    control.live = live;
+    control.arrived = 0u;
+    indirect.x = particleGroups(live);
+}
@@ -0,0 +1,77 @@
+// replace_start
+const pi : f32 = 3.14159265359;
+const pi2 : f32 = pi * 2;
+alias v2f = vec2<f32>;
+alias v4f = vec4<f32>;
+alias v2i32 = vec2<i32>;
+alias v2u32 = vec2<u32>;
+alias mtx4 =  mat4x4<f32>;
+// replace_end
+
+// Builds compacted list of particles inside the camera rectangle, draw is instanced over it
+// with instance count written here, vertex shader never sees off-screen particles.
+
+struct Args {
+    camera_vp: mtx4,
+    margin: v2f, // world space, keeps particles partially on screen
+    grid_min: v2f,
+    grid_size: v2f,
+    dummy: v2f,
+};
+// particle storage, see ParticleFormat in ParticleSymCpu.h
+struct ParticleWords {
+    words: array<u32>,
+};
+struct Cells {
+    cells: array<u32>,
+};
+struct Control {
+    live: u32,
+    spawn_count: u32,
+    capacity: u32,
+    arrived: u32,
+};
+// ParticleSym::DrawArgs, its own buffer: cs_cull is dispatched from the particle dispatch args
+struct DrawArgs {
+    vertex_count: u32,
+    instance_count: atomic<u32>,
+    first_vertex: u32,
+    first_instance: u32,
+};
+
+@group(0) @binding(0) var<uniform> args : Args;
+@group(0) @binding(1) var<storage, read> particles: ParticleWords;
+@group(0) @binding(2) var<storage, read> control : Control;
+@group(0) @binding(3) var<storage, read_write> visible : Cells;
+@group(0) @binding(4) var<storage, read_write> indirect : DrawArgs;
+
+const quad_verts: u32 = 4u; // triangle strip
+override packed_particles: bool = false;
+
+fn loadPos(i: u32) -> v2f {
+    if packed_particles {
+        return args.grid_min + unpack2x16unorm(particles.words[i * 2u]) * args.grid_size;
+    }
+    return bitcast<v2f>(v2u32(particles.words[i * 4u], particles.words[i * 4u + 1u]));
+}
+
+@compute @workgroup_size(1)
+fn cs_cull_reset() {
+    indirect.vertex_count = quad_verts;
+    atomicStore(&indirect.instance_count, 0u);
+    indirect.first_vertex = 0u;
+    indirect.first_instance = 0u;
+}
+
+@compute @workgroup_size(64)
+fn cs_cull(@builtin(global_invocation_id) gid: vec3u) {
+    let idx = gid.x;
+    if idx >= control.live { return; }
+    let pos = loadPos(idx);
+    let clip = args.camera_vp * v4f(pos, 0, 1);
+    let ext = abs((args.camera_vp * v4f(args.margin, 0, 0)).xy);
+    let ndc = clip.xy / clip.w;
+    let lim = v2f(1, 1) + ext / clip.w;
+    if any(abs(ndc) > lim) { return; }
+    visible.cells[atomicAdd(&indirect.instance_count, 1u)] = idx;
+}
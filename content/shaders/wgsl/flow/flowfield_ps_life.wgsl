@@ -0,0 +1,213 @@
+// replace_start
+const pi : f32 = 3.14159265359;
+const pi2 : f32 = pi * 2;
+alias v2f = vec2<f32>;
+alias v4f = vec4<f32>;
+alias v2i32 = vec2<i32>;
+alias v2u32 = vec2<u32>;
+alias mtx4 =  mat4x4<f32>;
+// replace_end
+
+// Particle lifetime: appends spawned batches after the live set and compacts it once some
+// particles arrived at the goal (cs_main clears their 'alive' flag). Live count only exists on
+// GPU, in control.live. cs_append_commit and cs_compact_commit of flowfield_ps_commit.wgsl
+// publish it after these passes and turn it into indirect args for particle passes.
+// 'alive' holds group + 1 of every live particle, compaction moves it along with the particle
+// through the tail of compact_tmp (after 'capacity' particles).
+
+struct Particle {
+    pos: v2f,
+    vel: v2f,
+}
+struct ParticleData {
+    data: array<Particle>,
+};
+// particle storage, see ParticleFormat in ParticleSymCpu.h. Spawned batch is always
+// full precision, live set is copied around as raw words
+struct ParticleWords {
+    words: array<u32>,
+};
+struct Cells {
+    cells: array<u32>,
+};
+struct Control {
+    live: atomic<u32>,
+    spawn_count: u32, // written by CPU before the frame, consumed by cs_append_commit
+    capacity: u32,
+    arrived: atomic<u32>,
+};
+
+@group(0) @binding(0) var<storage, read_write> control : Control;
+@group(0) @binding(1) var<storage, read_write> particles: ParticleWords;
+@group(0) @binding(2) var<storage, read_write> alive : Cells;
+@group(0) @binding(3) var<storage, read> spawned: ParticleData;
+@group(0) @binding(4) var<storage, read_write> compact_tmp: ParticleWords;
+@group(0) @binding(5) var<storage, read_write> offsets : Cells;
+// simulation args, only the grid rect is used here
+struct Args {
+    spatial_table_size: v2u32,
+    size: v2u32,
+    grid_min: v2f,
+    grid_size: v2f,
+};
+@group(0) @binding(6) var<uniform> u : Args;
+// group of every particle in 'spawned'
+@group(0) @binding(7) var<storage, read> spawned_groups: Cells;
+
+const scan_wg: u32 = 256u;
+const particle_wg: u32 = 64u;
+override packed_particles: bool = false;
+
+fn particleStride() -> u32 {
+    return select(4u, 2u, packed_particles);
+}
+
+fn storeParticle(i: u32, p: Particle) {
+    if packed_particles {
+        particles.words[i * 2u] = pack2x16unorm((p.pos - u.grid_min) / u.grid_size);
+        particles.words[i * 2u + 1u] = pack2x16float(p.vel);
+        return;
+    }
+    let w = bitcast<vec4<u32>>(v4f(p.pos, p.vel));
+    particles.words[i * 4u] = w.x;
+    particles.words[i * 4u + 1u] = w.y;
+    particles.words[i * 4u + 2u] = w.z;
+    particles.words[i * 4u + 3u] = w.w;
+}
+
+fn groupSlot(i: u32) -> u32 {
+    return control.capacity * particleStride() + i;
+}
+
+@compute @workgroup_size(64)
+fn cs_append(@builtin(global_invocation_id) gid: vec3u) {
+    let i = gid.x;
+    let dst = atomicLoad(&control.live) + i;
+    if i >= control.spawn_count || dst >= control.capacity { return; }
+    storeParticle(dst, spawned.data[i]);
+    alive.cells[dst] = spawned_groups.cells[i] + 1u;
+}
+
+var<workgroup> partial: array<u32, 256>;
+var<workgroup> block_flags: array<u32, 64>;
+var<workgroup> wg_live: u32;
+
+// Compaction scans alive flags in blocks of particle_wg, one block per workgroup of the
+// particle dispatch: cs_compact_count sums every block, cs_compact_scan scans the block sums
+// and cs_compact_scatter scans inside its block. offsets[0..blocks] holds block offsets,
+// offsets[blocks] the new live count, cs_compact_commit publishes it.
+fn compactBlocks(live: u32) -> u32 {
+    return (live + particle_wg - 1u) / particle_wg;
+}
+
+// live count for the compaction passes, 0 when nothing arrived. One invocation loads it, the
+// uniform load keeps early outs in front of barriers in uniform control flow
+fn compactLive(lid: u32) -> u32 {
+    if lid == 0u {
+        wg_live = select(0u, atomicLoad(&control.live), atomicLoad(&control.arrived) != 0u);
+    }
+    return workgroupUniformLoad(&wg_live);
+}
+
+fn aliveFlag(i: u32, live: u32) -> u32 {
+    return select(0u, 1u, i < live && alive.cells[i] != 0u);
+}
+
+@compute @workgroup_size(64)
+fn cs_compact_count(@builtin(local_invocation_index) lid: u32,
+    @builtin(workgroup_id) wid: vec3u) {
+    let live = compactLive(lid);
+    if live == 0u { return; }
+    block_flags[lid] = aliveFlag(wid.x * particle_wg + lid, live);
+    workgroupBarrier();
+    for (var width = particle_wg / 2u; width > 0u; width >>= 1u) {
+        if lid < width {
+            block_flags[lid] += block_flags[lid + width];
+        }
+        workgroupBarrier();
+    }
+    if lid == 0u {
+        offsets.cells[wid.x] = block_flags[0];
+    }
+}
+
+// exclusive scan of block sums in place by a single workgroup. Each invocation sums a run of
+// live / (particle_wg * scan_wg) block sums, a Hillis-Steele scan over the workgroup turns the
+// run totals into run offsets, then each invocation writes its run back as a running sum
+@compute @workgroup_size(256)
+fn cs_compact_scan(@builtin(local_invocation_index) lid: u32) {
+    let live = compactLive(lid);
+    if live == 0u { return; }
+    let n = compactBlocks(live);
+    let per_invo = (n + scan_wg - 1u) / scan_wg;
+    let begin = min(lid * per_invo, n);
+    let end = min(begin + per_invo, n);
+
+    var sum = 0u;
+    for (var i = begin; i < end; i++) {
+        sum += offsets.cells[i];
+    }
+    partial[lid] = sum;
+    workgroupBarrier();
+
+    for (var offset = 1u; offset < scan_wg; offset <<= 1u) {
+        let v = select(0u, partial[max(lid, offset) - offset], lid >= offset);
+        workgroupBarrier();
+        partial[lid] += v;
+        workgroupBarrier();
+    }
+
+    var run = partial[lid] - sum;
+    for (var i = begin; i < end; i++) {
+        let block_sum = offsets.cells[i];
+        offsets.cells[i] = run;
+        run += block_sum;
+    }
+    if lid == scan_wg - 1u {
+        // new live count is published by cs_compact_commit, scatter still needs the old one
+        offsets.cells[n] = partial[lid];
+    }
+}
+
+@compute @workgroup_size(64)
+fn cs_compact_scatter(@builtin(local_invocation_index) lid: u32,
+    @builtin(workgroup_id) wid: vec3u) {
+    let live = compactLive(lid);
+    if live == 0u { return; }
+    let i = wid.x * particle_wg + lid;
+    let flag = aliveFlag(i, live);
+    block_flags[lid] = flag;
+    workgroupBarrier();
+    for (var offset = 1u; offset < particle_wg; offset <<= 1u) {
+        let v = select(0u, block_flags[max(lid, offset) - offset], lid >= offset);
+        workgroupBarrier();
+        block_flags[lid] += v;
+        workgroupBarrier();
+    }
+    if flag != 0u {
+        let stride = particleStride();
+        let slot = offsets.cells[wid.x] + block_flags[lid] - 1u;
+        let dst = slot * stride;
+        for (var w = 0u; w < stride; w++) {
+            compact_tmp.words[dst + w] = particles.words[i * stride + w];
+        }
+        compact_tmp.words[groupSlot(slot)] = alive.cells[i];
+    }
+}
+
+@compute @workgroup_size(64)
+fn cs_compact_copy(@builtin(global_invocation_id) gid: vec3u) {
+    let i = gid.x;
+    let old_live = atomicLoad(&control.live);
+    if atomicLoad(&control.arrived) == 0u || i >= old_live { return; }
+    let new_live = offsets.cells[compactBlocks(old_live)];
+    if i < new_live {
+        let stride = particleStride();
+        for (var w = i * stride; w < (i + 1u) * stride; w++) {
+            particles.words[w] = compact_tmp.words[w];
+        }
+        alive.cells[i] = compact_tmp.words[groupSlot(i)];
+    } else {
+        alive.cells[i] = 0u;
+    }
+}
@@ -13,75 +13,65 @@ struct Uniforms {
      color2: v4f,
     // facing: v4f,   would be needed later when rotation is possible
      size: v4f, 
+     grid: v4f, // grid_min, grid_size for packed particles
      flags: u32,
 };  
 
 struct Vectors {
     cells: array<v2f>,
 };  
-struct Particle {
-    pos: v2f,
-    vel: v2f,
-}
-struct ParticleData {
-    data: array<Particle>,
-};  
+// particle storage, see ParticleFormat in ParticleSymCpu.h
+struct ParticleWords {
+    words: array<u32>,
+};
 @group(0) @binding(0) var<uniform> u: Uniforms;
-@group(0) @binding(1) var<storage, read> particles: ParticleData;
+@group(0) @binding(1) var<storage, read> particles: ParticleWords;
 @group(0) @binding(2) var texture: texture_2d<f32>;
 @group(0) @binding(3) var tex_sampler: sampler;
 
+struct Cells {
+    cells: array<u32>,
+};
+// particles that passed cs_cull, one instance each
+@group(0) @binding(4) var<storage, read> visible: Cells;
+
+override packed_particles: bool = false;
+
+fn loadPos(i: u32) -> v2f {
+    if packed_particles {
+        return u.grid.xy + unpack2x16unorm(particles.words[i * 2u]) * u.grid.zw;
+    }
+    return bitcast<v2f>(v2u32(particles.words[i * 4u], particles.words[i * 4u + 1u]));
+}
+
 struct VertexOutput { 
     @builtin(position) pos: vec4<f32>,
     @location(0) uv: v2f,
     @location(1) color: v4f,
 }
 
+// one triangle strip quad per instance
 @vertex
-fn vs_main(@builtin(vertex_index) i: u32) -> VertexOutput {
+fn vs_main(@builtin(vertex_index) i: u32, @builtin(instance_index) inst: u32) -> VertexOutput {
     const uv = array(
-        vec2(1.0, 0.0),
-        vec2(1.0, 1.0),
-        vec2(0.0, 1.0),
-        vec2(1.0, 0.0),
         vec2(0.0, 1.0),
+        vec2(1.0, 1.0),
         vec2(0.0, 0.0),
+        vec2(1.0, 0.0),
     );
-
-    let num_cell: u32 = i / 6;
-    //let cell_xy = v2u32(num_cell % u.bounds.x, num_cell / u.bounds.x);
-    let particle = particles.data[num_cell];
-    let dir = particle.vel;
-
-    let size: v2f = u.size.xy;
-    // let v_end = dir * size.y ;
-    // let dx = dir.x * size.x ;
-    // let dy = dir.y * size.x;
-
-    let v_end = v2f(0, 1) * size.y ;
-    let dx = size.x ;
-    let dy = size.y;
-    let orig: v2f = particle.pos;
     const pos = array(
-        vec2(1.0, 1.0),
-        vec2(1.0, -1.0),
-        vec2(-1.0, -1.0),
-        vec2(1.0, 1.0),
         vec2(-1.0, -1.0),
+        vec2(1.0, -1.0),
         vec2(-1.0, 1.0),
+        vec2(1.0, 1.0),
     );
-    let positions = array(
-        vec2(dy, -dx),
-        v_end + vec2(dy, -dx),
-        v_end + vec2(-dy, dx),
-        vec2(dy, -dx), // second tri
-        v_end + vec2(-dy, dx),
-        vec2(-dy, dx),
-    );
-    let p: v2f = orig + pos[i % 6] * dx;
+
+    let center = loadPos(visible.cells[inst]);
+    let size: v2f = u.size.xy;
+    let p: v2f = center + pos[i] * size.x;
     var output: VertexOutput;
     output.pos = u.camera_vp * v4f(p.x, p.y, 0, 1);
-    output.uv = uv[i % 6];
+    output.uv = uv[i];
     return output;
 } 
 
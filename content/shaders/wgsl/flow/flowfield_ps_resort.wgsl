@@ -0,0 +1,63 @@
+// replace_start
+const pi : f32 = 3.14159265359;
+const pi2 : f32 = pi * 2;
+alias v2f = vec2<f32>;
+alias v4f = vec4<f32>;
+alias v2i32 = vec2<i32>;
+alias v2u32 = vec2<u32>;
+alias mtx4 =  mat4x4<f32>;
+// replace_end
+
+// Moves particles into Morton order of their map cell so neighbours in space are neighbours in
+// memory. Order comes from flowfield_hash.wgsl run with sort_key_morton, runs right after append
+// when every live particle is alive, before any pass caches particle indices. Group flags in
+// 'alive' travel through the tail of 'tmp', same as in compaction of flowfield_ps_life.wgsl.
+
+// particle storage, see ParticleFormat in ParticleSymCpu.h, copied as raw words
+struct ParticleWords {
+    words: array<u32>,
+};
+struct Cells {
+    cells: array<u32>,
+};
+struct Control {
+    live: u32,
+    spawn_count: u32,
+    capacity: u32,
+    arrived: u32,
+};
+
+@group(0) @binding(0) var<storage, read_write> particles: ParticleWords;
+@group(0) @binding(1) var<storage, read_write> tmp: ParticleWords;
+@group(0) @binding(2) var<storage, read> order : Cells; // new index -> old index
+@group(0) @binding(3) var<storage, read> control : Control;
+@group(0) @binding(4) var<storage, read_write> alive : Cells; // group + 1
+
+override packed_particles: bool = false;
+
+fn particleStride() -> u32 {
+    return select(4u, 2u, packed_particles);
+}
+
+@compute @workgroup_size(64)
+fn cs_resort_gather(@builtin(global_invocation_id) gid: vec3u) {
+    let i = gid.x;
+    if i >= control.live { return; }
+    let src = order.cells[i];
+    let stride = particleStride();
+    for (var w = 0u; w < stride; w++) {
+        tmp.words[i * stride + w] = particles.words[src * stride + w];
+    }
+    tmp.words[control.capacity * stride + i] = alive.cells[src];
+}
+
+@compute @workgroup_size(64)
+fn cs_resort_copy(@builtin(global_invocation_id) gid: vec3u) {
+    let i = gid.x;
+    if i >= control.live { return; }
+    let stride = particleStride();
+    for (var w = i * stride; w < (i + 1u) * stride; w++) {
+        particles.words[w] = tmp.words[w];
+    }
+    alive.cells[i] = tmp.words[control.capacity * stride + i];
+}
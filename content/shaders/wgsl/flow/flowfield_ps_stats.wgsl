@@ -0,0 +1,135 @@
+// replace_start
+const pi : f32 = 3.14159265359;
+const pi2 : f32 = pi * 2;
+alias v2f = vec2<f32>;
+alias v4f = vec4<f32>;
+alias v2i32 = vec2<i32>;
+alias v2u32 = vec2<u32>;
+alias mtx4 =  mat4x4<f32>;
+// replace_end
+
+// Crowd metrics for UI, reduced on GPU so CPU reads back one small struct instead of the
+// particles. Runs after movement and before compaction: particles that arrived this frame are
+// still flagged in control.arrived and leave the live set right after. Speeds are summed in
+// fixed point, one atomic per workgroup into a 64-bit sum split over two words.
+// Hand written rather than wgfx::compute::ReducePlan: particle count only exists on GPU
+// (indirect dispatch), four values come out of one read of the particles, the speed sum needs
+// 64 bits and density is v4f per cell while plans reduce contiguous u32 words.
+// max_density reads the density of the last simulated step (cs_density runs on its first
+// substep). On frames without a fixed step particles don't move, so it still matches them,
+// only particles appended since that step aren't counted until the next one.
+
+// simulation args, prefix of SimulateUBO
+struct Args {
+    spatial_table_size: v2u32,
+    size: v2u32,
+    grid_min: v2f,
+    grid_size: v2f,
+    cell_size: v2f,
+    num_particles: u32,
+    table_cells: u32,
+    speed_base: f32,
+};
+// particle storage, see ParticleFormat in ParticleSymCpu.h
+struct ParticleWords {
+    words: array<u32>,
+};
+struct Cells {
+    cells: array<u32>,
+};
+struct Control {
+    live: u32,
+    spawn_count: u32,
+    capacity: u32,
+    arrived: u32,
+};
+// x: particles in map cell, see cs_density of flowfield_hash.wgsl
+struct Density {
+    cells: array<v4f>,
+};
+// ParticleSym::StatsGpu
+struct Stats {
+    arrived_total: u32, // since init or restore
+    moving: u32,
+    speed_sum_lo: atomic<u32>, // cells per second, speed_scale units
+    speed_sum_hi: atomic<u32>,
+    max_density: atomic<u32>,
+    stuck: atomic<u32>,
+    max_speed: atomic<u32>, // speed_scale units, sizes substeps of the next steps
+    padding: u32,
+};
+
+@group(0) @binding(0) var<uniform> args : Args;
+@group(0) @binding(1) var<storage, read> particles: ParticleWords;
+@group(0) @binding(2) var<storage, read> alive : Cells;
+@group(0) @binding(3) var<storage, read> control : Control;
+@group(0) @binding(4) var<storage, read> density : Density;
+@group(0) @binding(5) var<storage, read_write> stats : Stats;
+
+const speed_scale: f32 = 256.0;
+// slower than this fraction of base speed counts as stuck
+const stuck_speed: f32 = 0.1;
+override packed_particles: bool = false;
+// size of the per map cell pass, ComputePipeline::workgroup_size
+override wg_size: u32 = 64u;
+
+fn loadVel(i: u32) -> v2f {
+    if packed_particles {
+        return unpack2x16float(particles.words[i * 2u + 1u]);
+    }
+    return bitcast<v2f>(v2u32(particles.words[i * 4u + 2u], particles.words[i * 4u + 3u]));
+}
+
+@compute @workgroup_size(1)
+fn cs_stats_begin() {
+    stats.arrived_total += control.arrived;
+    stats.moving = control.live - control.arrived;
+    atomicStore(&stats.speed_sum_lo, 0u);
+    atomicStore(&stats.speed_sum_hi, 0u);
+    atomicStore(&stats.max_density, 0u);
+    atomicStore(&stats.stuck, 0u);
+    atomicStore(&stats.max_speed, 0u);
+}
+
+var<workgroup> wg_speed: atomic<u32>;
+var<workgroup> wg_stuck: atomic<u32>;
+var<workgroup> wg_max: atomic<u32>;
+var<workgroup> wg_max_speed: atomic<u32>;
+
+@compute @workgroup_size(64)
+fn cs_stats_particles(
+    @builtin(global_invocation_id) gid: vec3u, @builtin(local_invocation_index) lid: u32) {
+    let idx = gid.x;
+    if idx < control.live && alive.cells[idx] != 0u {
+        let speed = length(loadVel(idx));
+        let fixed_speed = u32(speed / args.cell_size.x * speed_scale);
+        atomicAdd(&wg_speed, fixed_speed);
+        atomicMax(&wg_max_speed, fixed_speed);
+        if speed < args.speed_base * stuck_speed {
+            atomicAdd(&wg_stuck, 1u);
+        }
+    }
+    workgroupBarrier();
+    if lid == 0u {
+        let sum = atomicLoad(&wg_speed);
+        let old = atomicAdd(&stats.speed_sum_lo, sum);
+        if old + sum < old {
+            atomicAdd(&stats.speed_sum_hi, 1u);
+        }
+        atomicAdd(&stats.stuck, atomicLoad(&wg_stuck));
+        atomicMax(&stats.max_speed, atomicLoad(&wg_max_speed));
+    }
+}
+
+@compute @workgroup_size(wg_size)
+fn cs_stats_cells(
+    @builtin(global_invocation_id) gid: vec3u, @builtin(local_invocation_index) lid: u32) {
+    let idx = gid.x;
+    if idx < args.size.x * args.size.y {
+        atomicMax(&wg_max, u32(density.cells[idx].x));
+    }
+    workgroupBarrier();
+    if lid == 0u {
+        atomicMax(&stats.max_density, atomicLoad(&wg_max));
+    }
+}
@@ -16,7 +16,7 @@ struct Args {
     cell_size: v2f,
 
     num_particles: u32,
-    table_depth: u32,
+    table_cells: u32, // spatial_table_size.x * spatial_table_size.y
 
     speed_base: f32,
     radius: f32,
@@ -28,35 +28,65 @@ struct Args {
     speed_max: f32,
 
     delta_time: f32,
-    flags: u32,     
+    flags: u32,
+    num_groups: u32,
+    wall_subdiv: u32, // WallField samples per cell side
+    padding: v2u32,
+    // xy: cell where particles of the group despawn, see SimulateUBO::GroupGoal
+    group_goals: array<vec4<u32>, 16>,
 };
 
 struct Vectors {
     cells: array<v2f>,
 }; 
-struct Particle {
-    pos: v2f,
-    vel: v2f,
-}
-struct ParticleData {
-    data: array<Particle>,
-};  
+// particle storage, see ParticleFormat: 4 words (f32 pos, vel) or 2 words when packed
+// (unorm16 pos relative to grid rect, f16 vel)
+struct ParticleWords {
+    words: array<u32>,
+};
 struct Cells {
     cells: array<u32>,
 }; 
+// see WallField.h
+struct WallSample {
+    grad: u32, // f16x2, points away from walls
+    dist: f32, // signed, in cells
+};
+struct WallSamples {
+    cells: array<WallSample>,
+};
 
 @group(0) @binding(0) var<uniform> args : Args;  
-@group(0) @binding(1) var<storage, read_write> particles: ParticleData;
-@group(0) @binding(2) var<storage, read> flow_directions : Vectors;   
-@group(0) @binding(3) var<storage, read> map_data : Cells; 
+@group(0) @binding(1) var<storage, read_write> particles: ParticleWords;
+// one flow field per agent group, layer after layer
+@group(0) @binding(2) var<storage, read> flow_directions : Vectors;
+@group(0) @binding(3) var<storage, read> walls : WallSamples;
 
 
-struct Table {
-    cells: array<i32>,
-};   
-@group(0) @binding(4) var<storage, read> table : Table;  
-@group(0) @binding(5) var<storage, read_write> dbg : Table; 
-//@group(0) @binding(4) var<storage, read_write> particles: ParticleData;
+// spatial hash built by flowfield_hash.wgsl, positions of particles in cell c are
+// sorted_pos[cell_start[c]..cell_start[c + 1]], a copy taken before the solve
+@group(0) @binding(4) var<storage, read> cell_start : Cells;
+@group(0) @binding(5) var<storage, read> sorted_pos : Vectors;
+
+struct Clearance {
+    cells: array<f32>,
+};
+// distance from cell center to the closest wall cell center, in cells
+@group(0) @binding(6) var<storage, read> clearance : Clearance;
+struct Control {
+    live: u32,
+    spawn_count: u32,
+    capacity: u32,
+    arrived: atomic<u32>,
+};
+// group + 1 of live particles, particles that reached their goal are flagged with 0 here and
+// removed by flowfield_ps_life.wgsl
+@group(0) @binding(7) var<storage, read_write> alive : Cells;
+@group(0) @binding(8) var<storage, read_write> control : Control;
+// flow layers again as filterable texture array, see ParticleSym::InitArgs::flow_texture. Texel
+// centers are cell centers, so a sample blends directions of the 4 closest cells
+@group(0) @binding(9) var flow_tex : texture_2d_array<f32>;
+@group(0) @binding(10) var flow_sampler : sampler;
 
 fn hash(pos: v2i32) -> u32 {
     return u32(pos.x) | (u32(pos.y) << 12);
@@ -71,218 +101,129 @@ fn lerpVec(s: v2f, e: v2f, t: f32) -> v2f {
 override disabled:bool = false;
 override solver_disabled:bool = false;
 override buckets_disabled:bool = false;
+override packed_particles: bool = false;
+override flow_texture: bool = false;
 
- 
-fn solve_v1(row_offset: u32, row_idx: u32, lines_per_inv: u32) {
-    let offsets: array<i32, 9> = array<i32, 9>(
-        0, // self
-        -i32(args.spatial_table_size.x) - 1, // top-left
-        -i32(args.spatial_table_size.x) + 0, // top (CW sart)
-        -i32(args.spatial_table_size.x) + 1, // top-right
-        -1, // left
-        1, // right
-        i32(args.spatial_table_size.x) - 1, // bot-left
-        i32(args.spatial_table_size.x) + 0, // bot
-        i32(args.spatial_table_size.x) + 1, // bot-right
-    );
-
-    let max_index = args.spatial_table_size.x * (args.spatial_table_size.y - 1);
-
-    let base_idx = (row_offset + row_idx) * args.spatial_table_size.x;
-    let r = args.radius;
-    let len = (args.spatial_table_size.x - 1);
- 
-    // dbg.cells[dbg_c] = i32(row_idx + row_offset);
-    // dbg.cells[dbg_c + 1u] = i32(row_offset);
-
-    for (var num_line = 0u; num_line < lines_per_inv; num_line++) {
-
-        //   dbg.cells[(num_line * args.spatial_table_size.x + base_idx) * 2] = i32(row_offset);
-        //    dbg.cells[(num_line * args.spatial_table_size.x + base_idx) * 2 + 1] = i32(row_idx + num_line);
-
-        for (var this_line_index: u32 = 1u; this_line_index < len; this_line_index++) {
-            let actual_idx: u32 = this_line_index + base_idx + num_line * args.spatial_table_size.x;
-            //dbg.cells[actual_idx * 2] = i32(actual_idx);
-            //dbg.cells[actual_idx * 2 + 1] = i32(row_idx + row_offset + num_line);
-            if actual_idx >= max_index {return;}
-
-            // for every entry in list untill -1 or list len
-            for (var cell_depth_pos: u32 = 0u; cell_depth_pos < args.table_depth ; cell_depth_pos++) {
-
-                let main_particle_idx: i32 = table.cells[actual_idx + cell_depth_pos];
-                if main_particle_idx < 0 {break;} // use select
-
-                let pos: v2f = particles.data[main_particle_idx].pos;
-
-                // for every neighboring cell AND self
-                for (var j: u32 = 0u; j < 9u ; j++) {
-                    let neighbor_cell_idx: u32 = u32(offsets[j] + i32(actual_idx));
-                
-                    // again, iter list of enries
-                    for (var inner_depth_pos = 0u; inner_depth_pos < args.table_depth ; inner_depth_pos++) {
-                        let other_particle_idx = table.cells[neighbor_cell_idx + inner_depth_pos];
-                        if other_particle_idx < 0 {break;} // use select
-
-                        let pos_other = particles.data[other_particle_idx].pos;
-                        let diff = pos_other - pos;
-                        let separate: f32 = (length(diff) - 2 * r) * 0.15 ;
-
-
-                        particles.data[main_particle_idx].vel += select(v2f(), normalize(-diff) * abs(separate), diff.x != 0 && separate < 0);
-                        particles.data[other_particle_idx].vel += select(v2f(), normalize(diff) * abs(separate), diff.x != 0 && separate < 0);
-                    }
-                }
-            }
-        }
+fn loadPos(i: u32) -> v2f {
+    if packed_particles {
+        return args.grid_min + unpack2x16unorm(particles.words[i * 2u]) * args.grid_size;
     }
+    return bitcast<v2f>(v2u32(particles.words[i * 4u], particles.words[i * 4u + 1u]));
 }
-
-const solver_chunk  = v2i32(4,4);
-override use_solver_v1 = false;
-// quads 8 * 8  
-
-// dbg.cells[va * 6] = i32(va);
-// dbg.cells[va * 6 + 1] = i32(a_idx);
-// dbg.cells[va * 6 + 2] = i32(b_idx);
-// dbg.cells[va * 6 + 3] = i32(separate * 100);
-// dbg.cells[va * 6 + 4] = i32(11111111);
-// dbg.cells[va * 6 + 5] = i32(invalid_cycle);
-
-fn cell_to_idx(cell: v2i32, offset: i32) -> i32 {
-    let v = cell.x + cell.y * i32(args.spatial_table_size.y) + offset;
-    return v;
+fn loadVel(i: u32) -> v2f {
+    if packed_particles {
+        return unpack2x16float(particles.words[i * 2u + 1u]);
+    }
+    return bitcast<v2f>(v2u32(particles.words[i * 4u + 2u], particles.words[i * 4u + 3u]));
 }
- 
-fn cell_to_cell_collision(a: v2i32, b: v2i32, cap: u32) {
-    let dummy_particle: i32 = (i32(args.num_particles) - 1);
-    let iter_cnt = i32(args.table_depth);
-    for (var sx = 0; sx <= iter_cnt; sx++) {
-        var va = cell_to_idx(a, 0); 
-        // #todo check validity
-        var a_idx: i32 = table.cells[va];
-
-        var invalid_cycle: bool = (a_idx < 0) || (a_idx > dummy_particle);
-        a_idx = select(a_idx, dummy_particle, invalid_cycle);
-        let pos = particles.data[a_idx].pos;
-
-        for (var sy = 0; sy <= iter_cnt; sy++) {
-            let ba = cell_to_idx(b, sy);
-
-            var b_idx: i32 = table.cells[ba];
-            invalid_cycle = invalid_cycle || (b_idx < 0) || (b_idx > dummy_particle);
-            invalid_cycle = invalid_cycle || (b_idx == a_idx);
-            b_idx = select(b_idx, dummy_particle, invalid_cycle);
-
-            let pos_other = particles.data[b_idx].pos;
-            let diff = pos_other - pos;
-            let separate: f32 = (length(diff) - 3.5 * args.radius);
-
-            invalid_cycle = invalid_cycle || (separate > 0) || (diff.x == 0);
-
-
-            let diff_norm = normalize(diff);
-            let sep_mag = args.radius * 0.15;
-            if !invalid_cycle {
-                particles.data[a_idx].vel += (v2f(-diff_norm.x, -diff_norm.y)) * sep_mag;
-                particles.data[b_idx].vel += diff_norm * sep_mag;
-            }
-        }
+fn storePos(i: u32, pos: v2f) {
+    if packed_particles {
+        particles.words[i * 2u] = pack2x16unorm((pos - args.grid_min) / args.grid_size);
+        return;
     }
+    let w = bitcast<v2u32>(pos);
+    particles.words[i * 4u] = w.x;
+    particles.words[i * 4u + 1u] = w.y;
+}
+fn storeVel(i: u32, vel: v2f) {
+    if packed_particles {
+        particles.words[i * 2u + 1u] = pack2x16float(vel);
+        return;
+    }
+    let w = bitcast<v2u32>(vel);
+    particles.words[i * 4u + 2u] = w.x;
+    particles.words[i * 4u + 3u] = w.y;
 }
 
-fn solve_v2(gid: u32, num_groups: u32, dbg_val: i32) {
-    let depth_len = args.table_depth;
-    let max_index = (args.spatial_table_size.x) * (args.spatial_table_size.y) * args.table_depth;
-    let stride_x = args.spatial_table_size.x;
-
-    let chunks_in_row: u32 = (args.spatial_table_size.y - 2) / u32(solver_chunk.x) + 1u;
-    let box_y: i32 = i32(gid / chunks_in_row);
-    let box_x: i32 = i32(gid % chunks_in_row);
-
-    let quad_tl: v2i32 = v2i32(i32(box_x * solver_chunk.x) + 1, i32(box_y * solver_chunk.y) + 1);
-
-    let limit_x: i32 = min(i32(quad_tl.x) + solver_chunk.x, i32(args.spatial_table_size.x - 1));
-    let limit_y: i32 = min(i32(quad_tl.y) + solver_chunk.y, i32(args.spatial_table_size.y - 1));
 
-    for (var x: i32 = quad_tl.x; x < limit_x; x++) {
-        for (var y: i32 = quad_tl.y; y < limit_y; y++) {
+fn table_cell(pos: v2f) -> v2i32 {
+    let orig = args.grid_min + v2f(0, args.grid_size.y);
+    let cell_sz = args.grid_size.y / f32(args.spatial_table_size.y);
+    let pos_rel = pos - orig;
+    let cell_x = min(u32(pos_rel.x / cell_sz), args.spatial_table_size.x - 1u);
+    let cell_y = min(u32(abs(pos_rel.y) / cell_sz), args.spatial_table_size.y - 1u);
+    return v2i32(i32(cell_x), i32(cell_y));
+}
 
-            let cur_cell: v2i32 = v2i32(x, y);
+// Gather-only separation: every invocation reads neighbour positions from the sorted copy and
+// writes only its own velocity, so there are no write conflicts and the result does not depend
+// on scheduling (cells are ordered by particle index in cs_order). Same math as ParticleSymCpu.
+@compute @workgroup_size(64)
+fn cs_solve(@builtin(global_invocation_id) gid: vec3u) {
+    let idx: u32 = gid.x;
+    if idx >= control.live { return; }
 
-            for (var sx = -1; sx <= 1; sx++) {
-                for (var sy = -1; sy <= 1; sy++) {
-                    let other_cell: v2i32 = cur_cell + v2i32(sx, sy);
-                    cell_to_cell_collision(cur_cell, other_cell, max_index);
-                }
-            }
+    let r = args.radius;
+    let range = 3.5 * r;
+    let range_sq = range * range;
+    let cell_sz = args.grid_size.y / f32(args.spatial_table_size.y);
+    let reach = i32(ceil(range / cell_sz));
+    let pos = loadPos(idx);
+    let cell = table_cell(pos);
+
+    let x0 = max(cell.x - reach, 0);
+    let x1 = min(cell.x + reach, i32(args.spatial_table_size.x) - 1);
+    let y0 = max(cell.y - reach, 0);
+    let y1 = min(cell.y + reach, i32(args.spatial_table_size.y) - 1);
+    var acc = v2f(0, 0);
+    for (var y = y0; y <= y1; y++) {
+        // cells of one row are adjacent in sorted order, one contiguous span
+        let row = u32(y) * args.spatial_table_size.x;
+        let last = cell_start.cells[row + u32(x1) + 1u];
+        for (var j = cell_start.cells[row + u32(x0)]; j < last; j++) {
+            let diff = sorted_pos.cells[j] - pos;
+            let d_sq = dot(diff, diff);
+            // self and exact overlaps have no direction and are skipped
+            let hit = d_sq < range_sq && d_sq > 0;
+            acc -= select(v2f(0, 0), diff * inverseSqrt(d_sq), hit);
         }
     }
+    storeVel(idx, loadVel(idx) + acc * (r * 0.15));
 }
 
-
-@compute @workgroup_size(64)  
-fn cs_solve(@builtin(workgroup_id) groupd_id: vec3u, @builtin(global_invocation_id) gid: vec3u, @builtin(num_workgroups) num_groups: vec3u) {
-    solve_v2(gid.x * 2 + 0, num_groups.x, 10);
-}
-@compute @workgroup_size(64)  
-fn cs_solve_second_pass(@builtin(workgroup_id) groupd_id: vec3u, @builtin(global_invocation_id) gid: vec3u, @builtin(num_workgroups) num_groups: vec3u) {
-    solve_v2(gid.x * 2 + 1, num_groups.x, 20);
-}
-
-
 @compute @workgroup_size(64)
 fn cs_solve_few(@builtin(global_invocation_id) gid: vec3u, @builtin(local_invocation_id) lid: vec3u) {
    // if solver_disabled { return;}
     let idx: u32 = gid.x;
-    if idx > args.num_particles { return;}
+    if idx >= control.live { return;}
 
     let rsq = args.radius * args.radius;
-    let mpos = particles.data[idx].pos;
-    let mvel = particles.data[idx].vel;
+    let mpos = loadPos(idx);
     var separate: v2f = v2f(0, 0);
-    let l = args.num_particles;
+    let l = control.live;
     var ni = 8;
     for (var i = 0u; i < l; i++) {
-        let pos = particles.data[i].pos.xy;
+        let pos = loadPos(i);
         let diff = pos - mpos;
         separate -= f32((diff.x * diff.x + diff.y * diff.y) < rsq * 1.502) * f32(i != idx) * diff;
     }
-    particles.data[idx].vel += select(v2f(), normalize(separate) * args.radius * 12.5, separate.x != 0);
+    storeVel(idx, loadVel(idx) + select(v2f(), normalize(separate) * args.radius * 12.5, separate.x != 0));
 }
 
-fn wall_collide(center: v2f, cell: v2i32, delta_vec: v2f) -> v2f {
-    // #fixme - collide with walls
-    let oob = cell.x < 0 || cell.y < 0 || cell.x >= i32(args.size.x) || cell.y >= i32(args.size.y) ;
-    if !oob {
-        let blocked = (map_data.cells[cell.x + cell.y * i32(args.size.x)] & (1u << 15u)) == 0;
-        if blocked {
-            return delta_vec;
-        }
-    }
-
-    let cell_f = v2f(cell);
-    let orig = v2f(args.grid_min.x, args.grid_min.y + args.grid_size.y);
-
-    let box_tl = v2f(orig + v2f(args.cell_size.x * cell_f.x, -args.cell_size.y * cell_f.y));
-    let box_br = v2f(orig + v2f(args.cell_size.x * (cell_f.x + 1), -args.cell_size.y * (cell_f.y + 1)));
-
-    let moved_center = center + delta_vec;
-    let cx = clamp(moved_center.x, box_tl.x, box_br.x);
-    let cy = clamp(moved_center.y, box_br.y, box_tl.y);
+// bilinear lookup of WallField, pushes the moved particle out to its radius along the distance
+// gradient. Field is in cells with y growing down from the top edge of the map
+fn wall_collide(center: v2f, delta_vec: v2f) -> v2f {
+    let moved = center + delta_vec;
+    let top = args.grid_min.y + args.grid_size.y;
+    let in_cells = v2f(moved.x - args.grid_min.x, top - moved.y) / args.cell_size;
+    let field_size = args.size * args.wall_subdiv + 1u;
+    let s = clamp(in_cells * f32(args.wall_subdiv), v2f(0, 0), v2f(field_size - 1u));
+    let s0 = min(v2u32(s), field_size - 2u);
+    let t = s - v2f(s0);
+    let i = s0.y * field_size.x + s0.x;
+    let a = walls.cells[i];
+    let b = walls.cells[i + 1u];
+    let c = walls.cells[i + field_size.x];
+    let d = walls.cells[i + field_size.x + 1u];
+    let dist_top = mix(a.dist, b.dist, t.x);
+    let dist = mix(dist_top, mix(c.dist, d.dist, t.x), t.y) * args.cell_size.x;
+    let grad_top = mix(unpack2x16float(a.grad), unpack2x16float(b.grad), t.x);
+    let grad = mix(grad_top, mix(unpack2x16float(c.grad), unpack2x16float(d.grad), t.x), t.y);
 
-    let diff = v2f(cx, cy) - moved_center;
-    let diff_len_sq = diff.x * diff.x + diff.y * diff.y;
     let r = args.radius;
-    if diff_len_sq > r * r { return delta_vec;}
-
-    if diff_len_sq == 0 {
-        return delta_vec - delta_vec * 0.999;
-    }
-
-    let out_v = delta_vec - normalize(diff) * (r - sqrt(diff_len_sq));
-
-    return  out_v;
-} 
+    if dist >= r || all(grad == v2f(0, 0)) { return delta_vec; }
+    return delta_vec + normalize(v2f(grad.x, -grad.y)) * (r - dist);
+}
 
 @compute @workgroup_size(64)
 fn cs_main(@builtin(global_invocation_id)gid: vec3u, @builtin(local_invocation_id)lid: vec3u) {
@@ -294,13 +235,14 @@ fn cs_main(@builtin(global_invocation_id)gid: vec3u, @builtin(local_invocation_i
         1, // right 
         i32(args.size.x) + 0, // bot 
     );
-    if idx > args.num_particles { return;}
+    if idx >= control.live || alive.cells[idx] == 0u { return;}
+    let group = min(alive.cells[idx] - 1u, args.num_groups - 1u);
 
     let dt = select(args.delta_time, 0.032, args.delta_time > 0.032);
 
     let grid_min = args.grid_min;
     let cell_sz = args.cell_size;
-    let pos = particles.data[idx].pos;
+    let pos = loadPos(idx);
     let pos_rel_to_min = pos - grid_min;
     //pos_rel_to_min.y = args.grid_size.y - pos_rel_to_min.y; // flip y;
 
@@ -308,12 +250,27 @@ fn cs_main(@builtin(global_invocation_id)gid: vec3u, @builtin(local_invocation_i
     var cell_y = args.size.y - u32(((pos_rel_to_min.y / cell_sz.y) + 1.0));
     cell_x = min(cell_x, args.size.x);
     cell_y = min(cell_y, args.size.y);
-    let this_cell: v2i32 = v2i32(i32(cell_x), i32(cell_y));
     let cell_idx = cell_y * args.size.x + cell_x;
 
-    var flow_dir: v2f = flow_directions.cells[cell_idx];
+    if all(v2u32(cell_x, cell_y) == args.group_goals[group].xy) {
+        alive.cells[idx] = 0u;
+        atomicAdd(&control.arrived, 1u);
+        return;
+    }
+
+    var flow_dir: v2f;
+    if flow_texture {
+        // cells count from the top edge of the map, like cell_y
+        let top = f32(args.size.y) * cell_sz.y;
+        let uv = v2f(pos_rel_to_min.x, top - pos_rel_to_min.y) / cell_sz / v2f(args.size);
+        let f = textureSampleLevel(flow_tex, flow_sampler, uv, group, 0.0).xy;
+        // blend of diverging directions is shorter, steer at full speed anyway
+        flow_dir = select(f, normalize(f), dot(f, f) > 1e-6);
+    } else {
+        flow_dir = flow_directions.cells[group * args.size.x * args.size.y + cell_idx];
+    }
 
-    let cur_vel = particles.data[idx].vel;
+    let cur_vel = loadVel(idx);
     let target_vel = flow_dir * args.speed_base * 2 ;
  
     // for (let i = 0; i < 4;)      
@@ -322,30 +279,18 @@ fn cs_main(@builtin(global_invocation_id)gid: vec3u, @builtin(local_invocation_i
     vel = select(vel, target_vel, vel.x == 0 && vel.y == 0);
     vel = lerpVec(vel, target_vel, dt * ((2 - args.inertia) * 2 + 0.5));
 
-    particles.data[idx].vel = clamp(vel, v2f(-4, -4), v2f(4, 4));
-    var delta_vec = particles.data[idx].vel * dt * 0.5 ; 
+    vel = clamp(vel, v2f(-4, -4), v2f(4, 4));
+    storeVel(idx, vel);
+    var delta_vec = vel * dt * 0.5 ; 
 
-    // #fixme only check in direction of movement
-    delta_vec = wall_collide(pos, this_cell + v2i32(0, 1), delta_vec);
-    delta_vec = wall_collide(pos, this_cell + v2i32(0, -1), delta_vec);
-    delta_vec = wall_collide(pos, this_cell + v2i32(-1, 0), delta_vec);
-    delta_vec = wall_collide(pos, this_cell + v2i32(1, 0), delta_vec);
- 
-    delta_vec = wall_collide(pos, this_cell + v2i32(1, 1), delta_vec);
-    delta_vec = wall_collide(pos, this_cell + v2i32(-1, -1), delta_vec);
-    delta_vec = wall_collide(pos, this_cell + v2i32(-1, 1), delta_vec);
-    delta_vec = wall_collide(pos, this_cell + v2i32(1, -1), delta_vec);
-    // split into two to reduce chance of glitching out
-    delta_vec = particles.data[idx].vel * dt * 0.5 ;
-    delta_vec = wall_collide(pos, this_cell + v2i32(0, 1), delta_vec);
-    delta_vec = wall_collide(pos, this_cell + v2i32(0, -1), delta_vec);
-    delta_vec = wall_collide(pos, this_cell + v2i32(-1, 0), delta_vec);
-    delta_vec = wall_collide(pos, this_cell + v2i32(1, 0), delta_vec);
-
-    delta_vec = wall_collide(pos, this_cell + v2i32(1, 1), delta_vec);
-    delta_vec = wall_collide(pos, this_cell + v2i32(-1, -1), delta_vec);
-    delta_vec = wall_collide(pos, this_cell + v2i32(-1, 1), delta_vec);
-    delta_vec = wall_collide(pos, this_cell + v2i32(1, -1), delta_vec);
-  
-    particles.data[idx].pos += delta_vec;
+    // wall can't be closer than clearance minus half diagonal of the wall cell and of this one,
+    // if particle can't reach it this frame the wall field lookup can be skipped
+    let free_space = (clearance.cells[cell_idx] - 1.5) * cell_sz.x;
+    if free_space > args.radius + length(vel * dt) {
+        storePos(idx, pos + delta_vec);
+        return;
+    }
+
+    delta_vec = wall_collide(pos, delta_vec);
+    storePos(idx, pos + delta_vec);
 }
@@ -0,0 +1,89 @@
+// replace_start
+const pi : f32 = 3.14159265359;
+const pi2 : f32 = pi * 2;
+alias v2f = vec2<f32>;
+alias v4f = vec4<f32>;
+alias v2u32 = vec2<u32>;
+alias mtx4 =  mat4x4<f32>;
+// replace_end
+
+// Flow field lookup paths of the particle move pass, timed by 'bench: flow sampling' of the
+// pathfinder demo. Every invocation walks 'steps' half cells along the field from its own start,
+// so every lookup depends on the previous one like a moving particle. Starts follow row order,
+// neighbouring invocations stay close like particles after a Morton resort.
+
+struct Args {
+    size: v2u32,
+    steps: u32,
+    padding: u32,
+};
+struct Vectors {
+    cells: array<v2f>,
+};
+
+@group(0) @binding(0) var<uniform> args : Args;
+@group(0) @binding(1) var<storage, read> flow_directions : Vectors;
+@group(0) @binding(2) var flow_tex : texture_2d<f32>;
+@group(0) @binding(3) var flow_sampler : sampler;
+@group(0) @binding(4) var<storage, read_write> walked : Vectors;
+
+fn cellAt(c: vec2i) -> v2f {
+    let cc = clamp(c, vec2i(0), vec2i(args.size) - vec2i(1));
+    return flow_directions.cells[u32(cc.y) * args.size.x + u32(cc.x)];
+}
+
+// same result as the linear clamp sampler, at full precision
+fn sampleBilinear(p: v2f) -> v2f {
+    let q = p - 0.5;
+    let c0 = vec2i(floor(q));
+    let t = q - floor(q);
+    let top = mix(cellAt(c0), cellAt(c0 + vec2i(1, 0)), t.x);
+    let bot = mix(cellAt(c0 + vec2i(0, 1)), cellAt(c0 + vec2i(1, 1)), t.x);
+    return mix(top, bot, t.y);
+}
+
+fn startOf(i: u32) -> v2f {
+    let cell = v2u32(i % args.size.x, (i / args.size.x) % args.size.y);
+    let h = (i * 0x9e3779b9u) >> 16u;
+    return v2f(cell) + v2f(f32(h & 0xffu), f32(h >> 8u)) / 256.0;
+}
+
+fn walk(p: v2f, flow: v2f) -> v2f {
+    return clamp(p + flow * 0.5, v2f(0, 0), v2f(args.size) - 0.001);
+}
+
+@compute @workgroup_size(64)
+fn cs_buffer_nearest(@builtin(global_invocation_id) gid: vec3u) {
+    var p = startOf(gid.x);
+    var acc = v2f(0, 0);
+    for (var s = 0u; s < args.steps; s++) {
+        let flow = cellAt(vec2i(p));
+        acc += flow;
+        p = walk(p, flow);
+    }
+    walked.cells[gid.x] = acc;
+}
+
+@compute @workgroup_size(64)
+fn cs_buffer_bilinear(@builtin(global_invocation_id) gid: vec3u) {
+    var p = startOf(gid.x);
+    var acc = v2f(0, 0);
+    for (var s = 0u; s < args.steps; s++) {
+        let flow = sampleBilinear(p);
+        acc += flow;
+        p = walk(p, flow);
+    }
+    walked.cells[gid.x] = acc;
+}
+
+@compute @workgroup_size(64)
+fn cs_texture_linear(@builtin(global_invocation_id) gid: vec3u) {
+    var p = startOf(gid.x);
+    var acc = v2f(0, 0);
+    for (var s = 0u; s < args.steps; s++) {
+        let flow = textureSampleLevel(flow_tex, flow_sampler, p / v2f(args.size), 0.0).xy;
+        acc += flow;
+        p = walk(p, flow);
+    }
+    walked.cells[gid.x] = acc;
+}
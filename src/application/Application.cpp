@@ -269,6 +269,7 @@ i32 vex::Application::runLoop()
 
             mINI::INIFile file("cfg.ini");
             mINI::INIStructure ini;
+            file.read(ini); // keep sections written by others, e.g. workgroup sizes
 
             ini["window"sv]["pos"sv] = fmt::format("{} {}", pos.x, pos.y);
             ini["window"sv]["size"sv] = fmt::format("{} {}", size.x, size.y);
@@ -0,0 +1,47 @@
+#pragma once
+#include <VCore/Utils/CoreTemplates.h>
+#include <VCore/Utils/VUtilsBase.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace vex
+{
+    // Splits [0, count) into contiguous ranges and invokes fn(begin, end) for each of them,
+    // calling thread takes the first range. Ranges are never smaller than min_chunk, so small
+    // inputs run inline. Web build has no pthreads, there it is always a single serial call.
+    template <typename Fn>
+    inline void parallelFor(u32 count, u32 min_chunk, Fn&& fn)
+    {
+        if (count == 0)
+            return;
+#ifdef __EMSCRIPTEN__
+        fn(0u, count);
+#else
+        min_chunk = min_chunk > 0 ? min_chunk : 1;
+        const u32 hw_threads = std::max(1u, std::thread::hardware_concurrency());
+        const u32 num_chunks = std::min(hw_threads, (count + min_chunk - 1) / min_chunk);
+        if (num_chunks <= 1)
+        {
+            fn(0u, count);
+            return;
+        }
+        const u32 per_chunk = (count + num_chunks - 1) / num_chunks;
+
+        std::vector<std::thread> workers;
+        workers.reserve(num_chunks - 1);
+        for (u32 c = 1; c < num_chunks; ++c)
+        {
+            const u32 begin = c * per_chunk;
+            const u32 end = std::min(count, begin + per_chunk);
+            if (begin >= end)
+                break;
+            workers.emplace_back([&fn, begin, end] { fn(begin, end); });
+        }
+        fn(0u, std::min(count, per_chunk));
+        for (auto& it : workers)
+            it.join();
+#endif
+    }
+} // namespace vex
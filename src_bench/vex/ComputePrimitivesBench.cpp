@@ -0,0 +1,59 @@
+#include <webgpu/render/ComputePrimitivesCpu.h>
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "../bench_config.h"
+
+using namespace wgfx::compute;
+
+// CPU references of the compute primitives against the standard library, baseline for the GPU
+// throughput printed by 'bench: compute primitives' of the pathfinder demo.
+BENCH("Compute primitives reference", "[compute]")
+{
+    for (u32 count : {1u << 16, 1u << 20, 1u << 22})
+    {
+        std::vector<u32> keys(count);
+        u32 seed = 3;
+        for (u32& k : keys)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            k = seed ^ (seed >> 15);
+        }
+        std::vector<u32> flags(count);
+        for (u32 i = 0; i < count; ++i)
+            flags[i] = keys[i] & 1;
+        std::vector<u32> out(count + 1);
+        const std::string size = std::to_string(count >> 10) + "k";
+
+        bench::Bench b;
+        b.timeUnit(std::chrono::milliseconds(1), "ms").unit("item").batch(count).epochs(3);
+        b.run("scan ref " + size, [&] {
+            bench::doNotOptimizeAway(ref::exclusiveScan({keys.data(), count}, out.data()));
+        });
+        b.run("scan std " + size, [&] {
+            std::exclusive_scan(keys.begin(), keys.end(), out.begin(), 0u);
+            bench::doNotOptimizeAway(out.data());
+        });
+        b.run("reduce min ref " + size, [&] {
+            bench::doNotOptimizeAway(ref::reduce({keys.data(), count}, ReduceOp::k_min));
+        });
+        b.run("compact ref " + size, [&] {
+            bench::doNotOptimizeAway(
+                ref::compact({keys.data(), count}, {flags.data(), count}, out.data()));
+        });
+        b.run("radix sort ref " + size, [&] {
+            std::vector<u32> sorted = keys;
+            ref::radixSort(sorted);
+            bench::doNotOptimizeAway(sorted.data());
+        });
+        b.run("std::sort " + size, [&] {
+            std::vector<u32> sorted = keys;
+            std::sort(sorted.begin(), sorted.end());
+            bench::doNotOptimizeAway(sorted.data());
+        });
+    }
+}
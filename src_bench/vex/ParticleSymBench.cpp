@@ -0,0 +1,219 @@
+#include <webgpu/demos/path/ParticleSymCpu.h>
+#include <webgpu/demos/path/SimSession.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../bench_config.h"
+
+using namespace vex;
+using namespace vex::flow;
+
+// Simulation cost per frame of the headless particle system, open 256x256 map with a walled
+// border, particles spread over the whole map. GPU timings of the same sizes come from the
+// 'bench: particles' button of the pathfinder demo (FlowfieldPF::benchParticles), this binary
+// has no device.
+BENCH("ParticleSymCpu stress", "[flow]")
+{
+    constexpr u32 map_side = 256;
+
+    SimulateUBO ubo{};
+    ubo.bounds = {map_side, map_side};
+    ubo.grid_min = {-f32(map_side) / 2, -f32(map_side) / 2};
+    ubo.grid_size = {f32(map_side), f32(map_side)};
+    ubo.cell_size = {1, 1};
+    ubo.radius = 0.25f;
+    ubo.spatial_table_size = {map_side * 4, map_side * 4};
+    ubo.table_cells = ubo.spatial_table_size.x * ubo.spatial_table_size.y;
+    ubo.delta_time = 1.0f / 60.0f;
+
+    std::vector<u8> walkable(map_side * map_side, 1);
+    std::vector<v2f> flow(map_side * map_side, v2f{0.6f, 0.8f});
+    std::vector<f32> clearance(map_side * map_side, 0.0f);
+    for (u32 y = 0; y < map_side; ++y)
+        for (u32 x = 0; x < map_side; ++x)
+        {
+            const u32 edge = std::min(std::min(x, y), std::min(map_side - 1 - x, map_side - 1 - y));
+            walkable[y * map_side + x] = edge == 0 ? 0 : 1;
+            clearance[y * map_side + x] = f32(edge);
+        }
+    WallField walls;
+    walls.build({walkable.data(), (u32)walkable.size()}, {map_side, map_side});
+    const ParticleSymCpu::MapView map{
+        .walls = &walls,
+        .flow = {flow.data(), (u32)flow.size()},
+        .clearance = {clearance.data(), (u32)clearance.size()},
+    };
+
+    for (u32 count : {100'000u, 250'000u, 500'000u, 1'000'000u, 2'000'000u})
+    {
+        u32 seed = 7;
+        auto rnd = [&]() {
+            seed = seed * 1664525u + 1013904223u;
+            return f32(seed >> 8) / f32(1u << 24);
+        };
+        const f32 extent = f32(map_side) - 4.0f;
+        std::vector<Particle> spawn(count);
+        for (Particle& p : spawn)
+            p = {{(rnd() - 0.5f) * extent, (rnd() - 0.5f) * extent}, {0, 0}};
+
+        ParticleSymCpu sym;
+        sym.spawn({spawn.data(), count});
+        ubo.num_particles = count;
+        bench::Bench()
+            .timeUnit(std::chrono::milliseconds(1), "ms")
+            .unit("frame")
+            .epochs(3)
+            .minEpochIterations(2)
+            .run("step " + std::to_string(count / 1000) + "k", [&] {
+                sym.step(ubo, map);
+                bench::doNotOptimizeAway(sym.pos_x.data());
+            });
+    }
+}
+
+// Scripted session (spawns in waves, goal moves twice, uneven frame times) replayed on the
+// headless simulation, then every pass timed on the state the replay ends in. Replays are
+// deterministic (see the session replay tests), so a change in times comes from the code and
+// not from the session. Only the CPU simulation is replayed: it has a single flow field and no
+// despawn, group goals and the GPU passes are covered by 'session: replay' of the demo, which
+// sums the particle profiler scopes over the replay.
+BENCH("ParticleSymCpu session replay", "[flow]")
+{
+    constexpr u32 map_side = 128;
+
+    SimulateUBO ubo{};
+    ubo.bounds = {map_side, map_side};
+    ubo.grid_min = {-f32(map_side) / 2, -f32(map_side) / 2};
+    ubo.grid_size = {f32(map_side), f32(map_side)};
+    ubo.cell_size = {1, 1};
+    ubo.radius = 0.25f;
+    ubo.spatial_table_size = {map_side * 4, map_side * 4};
+    ubo.table_cells = ubo.spatial_table_size.x * ubo.spatial_table_size.y;
+    ubo.delta_time = 1.0f / 120.0f;
+
+    std::vector<u8> walkable(map_side * map_side, 1);
+    std::vector<v2f> flow(map_side * map_side);
+    std::vector<f32> clearance(map_side * map_side, 0.0f);
+    for (u32 y = 0; y < map_side; ++y)
+        for (u32 x = 0; x < map_side; ++x)
+        {
+            const u32 edge = std::min(std::min(x, y), std::min(map_side - 1 - x, map_side - 1 - y));
+            walkable[y * map_side + x] = edge == 0 ? 0 : 1;
+            clearance[y * map_side + x] = f32(edge);
+            // swirl around the map center
+            const v2f d = {f32(x) - map_side / 2.0f, f32(y) - map_side / 2.0f};
+            flow[y * map_side + x] = glm::length(d) > 0 ? glm::normalize(v2f(-d.y, d.x)) : v2f{};
+        }
+    WallField walls;
+    walls.build({walkable.data(), (u32)walkable.size()}, {map_side, map_side});
+    const ParticleSymCpu::MapView map{
+        .walls = &walls,
+        .flow = {flow.data(), (u32)flow.size()},
+        .clearance = {clearance.data(), (u32)clearance.size()},
+    };
+
+    // 64x64 block of particles centered on the cell, cell rows grow downwards
+    auto spawn = [&](v2u32 cell, u32 counter)
+    {
+        std::vector<Particle> batch;
+        for (u32 i = 0; i < 64 * 64; ++i)
+        {
+            const f32 jitter = f32((i * 2654435761u + counter) >> 24) / 256.0f * 0.1f;
+            const v2f offset = {f32(i % 64) * 0.5f - 16.0f + jitter, f32(i / 64) * 0.5f - 16.0f};
+            batch.push_back({{ubo.grid_min.x + f32(cell.x) + offset.x,
+                                 ubo.grid_min.y + ubo.grid_size.y - f32(cell.y) - offset.y},
+                {0, 0}});
+        }
+        return batch;
+    };
+
+    SessionRecord rec;
+    rec.start.map_version = contentHash({walkable.data(), (u32)walkable.size()});
+    for (u32 frame = 0; frame < 240; ++frame)
+    {
+        rec.addFrame(frame % 7 == 0 ? 1.0f / 24.0f : 1.0f / 60.0f);
+        if (frame % 40 == 0)
+            rec.addEvent(SessionEvent::Kind::k_spawn, 0, {32 + frame / 4, 40});
+        if (frame == 100 || frame == 200)
+            rec.addEvent(SessionEvent::Kind::k_goal, 0, {frame / 2, 90});
+    }
+
+    ParticleSymCpu replayed;
+    bench::Bench()
+        .timeUnit(std::chrono::milliseconds(1), "ms")
+        .unit("session")
+        .epochs(3)
+        .minEpochIterations(1)
+        .run("replay 240 frames", [&] {
+            ParticleSymCpu sym;
+            bench::doNotOptimizeAway(replayCpu(sym, rec, ubo, map, spawn));
+            replayed = std::move(sym);
+        });
+
+    // passes of one step on the end state, each on its own copy so they don't feed each other
+    ubo.num_particles = replayed.size();
+    auto timePass = [&](const char* name, auto&& pass)
+    {
+        ParticleSymCpu sym = replayed;
+        sym.hash(ubo);
+        bench::Bench()
+            .timeUnit(std::chrono::milliseconds(1), "ms")
+            .unit("step")
+            .epochs(3)
+            .minEpochIterations(4)
+            .run(name, [&] {
+                pass(sym);
+                bench::doNotOptimizeAway(sym.pos_x.data());
+            });
+    };
+    timePass("replay end state: hash", [&](ParticleSymCpu& sym) { sym.hash(ubo); });
+    timePass("replay end state: separate", [&](ParticleSymCpu& sym) { sym.separate(ubo); });
+    timePass("replay end state: move", [&](ParticleSymCpu& sym) { sym.move(ubo, map); });
+}
+
+// Storage formats of ParticleFormat against each other, one integrate pass that reads and
+// writes every particle like the GPU passes do. Packed halves the bytes moved but pays for
+// unpacking and packing, the GPU side of the same trade is the 'bench: particles' button run
+// once per pf.PtSym_PackedParticles setting.
+BENCH("Particle storage format", "[flow]")
+{
+    const v2f grid_min = {-128, -128};
+    const v2f grid_size = {256, 256};
+    const f32 dt = 1.0f / 120.0f;
+
+    for (u32 count : {200'000u, 1'000'000u})
+    {
+        u32 seed = 5;
+        auto rnd = [&]() {
+            seed = seed * 1664525u + 1013904223u;
+            return f32(seed >> 8) / f32(1u << 24);
+        };
+        std::vector<Particle> full(count);
+        for (Particle& p : full)
+            p = {grid_min + v2f{rnd(), rnd()} * grid_size, {rnd() - 0.5f, rnd() - 0.5f}};
+        std::vector<PackedParticle> packed(count);
+        for (u32 i = 0; i < count; ++i)
+            packed[i] = PackedParticle::pack(full[i], grid_min, grid_size);
+
+        const std::string size = std::to_string(count / 1000) + "k";
+        bench::Bench b;
+        b.timeUnit(std::chrono::milliseconds(1), "ms").unit("pass");
+        b.epochs(3).minEpochIterations(16);
+        b.run("format f32 " + size, [&] {
+            for (Particle& p : full)
+                p.pos = glm::clamp(p.pos + p.vel * dt, grid_min, grid_min + grid_size);
+            bench::doNotOptimizeAway(full.data());
+        });
+        b.run("format packed " + size, [&] {
+            for (PackedParticle& packed_p : packed)
+            {
+                Particle p = packed_p.unpack(grid_min, grid_size);
+                p.pos = glm::clamp(p.pos + p.vel * dt, grid_min, grid_min + grid_size);
+                packed_p = PackedParticle::pack(p, grid_min, grid_size);
+            }
+            bench::doNotOptimizeAway(packed.data());
+        });
+    }
+}
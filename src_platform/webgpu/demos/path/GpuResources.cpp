@@ -2,6 +2,10 @@
 
 #include <spdlog/stopwatch.h>
 #include <webgpu/render/LayoutManagement.h>
+
+#include <algorithm>
+#include <initializer_list>
+
 using namespace vex;
 using namespace vex::flow;
 using namespace wgfx;
@@ -346,8 +350,22 @@ void vex::flow::CellHeatmapV1::draw(
         args.buffer.byteSize() % 4 == 0, "buffer size must satisfy constraints (mul of 4)");
 
     updateUniform(ctx, uniform_buf, vbo);
-    wgpuQueueWriteBuffer(
-        ctx.queue, storage_buf.buffer, 0, args.buffer.data, args.buffer.byteSize());
+    // empty span - storage buffer is filled on GPU
+    if (args.buffer.len > 0 && args.dirty)
+    {
+        const u32 row_len = args.bounds.x;
+        args.dirty->forEachSpan(
+            [&](u32 first_row, u32 row_count)
+            {
+                const u64 offset = (u64)first_row * row_len * sizeof(u32);
+                wgpuQueueWriteBuffer(ctx.queue, storage_buf.buffer, offset,
+                    args.buffer.data + first_row * row_len, (u64)row_count * row_len * sizeof(u32));
+            });
+        args.dirty->clear();
+    }
+    else if (args.buffer.len > 0)
+        wgpuQueueWriteBuffer(
+            ctx.queue, storage_buf.buffer, 0, args.buffer.data, args.buffer.byteSize());
     {
         auto rpass_enc = ctx.render_pass;
         wgpuRenderPassEncoderPushDebugGroup(rpass_enc, "draw heatmap");
@@ -378,8 +396,52 @@ bool vex::flow::CellHeatmapV1::reloadShaders(
     return true;
 }
 
+wgfx::TextureView vex::flow::createFlowTexture(WGPUDevice device, const char* label, v2u32 size,
+    u32 layers, WGPUTextureUsageFlags usage, bool as_array)
+{
+    const WGPUTextureDescriptor tex_desc{
+        .label = label,
+        .usage = usage,
+        .dimension = WGPUTextureDimension_2D,
+        .size = {size.x, size.y, layers},
+        .format = k_flow_tex_format,
+        .mipLevelCount = 1,
+        .sampleCount = 1,
+    };
+    WGPUTexture texture = wgpuDeviceCreateTexture(device, &tex_desc);
+    check_(texture);
+    const WGPUTextureViewDescriptor view_desc{
+        .format = k_flow_tex_format,
+        .dimension = as_array ? WGPUTextureViewDimension_2DArray : WGPUTextureViewDimension_2D,
+        .baseMipLevel = 0,
+        .mipLevelCount = 1,
+        .baseArrayLayer = 0,
+        .arrayLayerCount = layers,
+    };
+    const WGPUSamplerDescriptor sampler_desc{
+        .addressModeU = WGPUAddressMode_ClampToEdge,
+        .addressModeV = WGPUAddressMode_ClampToEdge,
+        .addressModeW = WGPUAddressMode_ClampToEdge,
+        .magFilter = WGPUFilterMode_Linear,
+        .minFilter = WGPUFilterMode_Linear,
+        .mipmapFilter = WGPUFilterMode_Nearest,
+        .lodMinClamp = 0.0f,
+        .lodMaxClamp = 1.0f,
+        .maxAnisotropy = 1,
+    };
+    return TextureView{
+        .size = {size.x, size.y, layers},
+        .mip_level_count = 1,
+        .format = k_flow_tex_format,
+        .dimension = WGPUTextureDimension_2D,
+        .texture = texture,
+        .view = wgpuTextureCreateView(texture, &view_desc),
+        .sampler = wgpuDeviceCreateSampler(device, &sampler_desc),
+    };
+}
+
 void vex::flow::ComputeFields::init(const wgfx::GpuContext& ctx, const TextShaderLib& text_shad_lib,
-    const char* in_shader_file, wgfx::GpuBuffer& map_data_buf, v2u32 size)
+    const char* in_shader_file, wgfx::GpuBuffer& map_data_buf, v2u32 size, bool texture_output)
 {
     cf_shader_file = in_shader_file;
     vex::InlineBufferAllocator<4096> temp_alloc_resource;
@@ -403,46 +465,114 @@ void vex::flow::ComputeFields::init(const wgfx::GpuContext& ctx, const TextShade
                         .usage = WGPUBufferUsage_CopySrc | WGPUBufferUsage_Storage,
                         .size = (u32)(size.x * size.y * sizeof(v2f)),
                     });
-    staging_buf = GpuBuffer::create(
+    smooth_tmp_buf = GpuBuffer::create(
         ctx.device, {
-                        .label = "f32 vec stage",
-                        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead,
+                        .label = "f32 vec smooth tmp",
+                        .usage = WGPUBufferUsage_Storage,
                         .size = (u32)(size.x * size.y * sizeof(v2f)),
                     });
+    readback.init(ctx.device, (u32)(size.x * size.y * sizeof(v2f)), 2, "f32 vec readback");
 
     auto [layout,
         binding] = BGLCombinedBuilder{.al = tmp_alloc} //
                        .addUniform(sizeof(UBO), uniform_buf, 0, WGPUShaderStage_Compute)
                        .addStorageBuffer(16 * 16, map_data_buf, WGPUShaderStage_Compute, true)
                        .addStorageBuffer(16 * 16, output_buf, WGPUShaderStage_Compute, false)
+                       .addStorageBuffer(16 * 16, smooth_tmp_buf, WGPUShaderStage_Compute, false)
                        .createLayoutAndGroup(ctx.device);
 
     bgl_layout = layout;
     pipeline = pipeline_data.createPipeline(ctx, shad, layout);
+    smooth_h_pipeline = smooth_h_data.createPipeline(ctx, shad, layout);
+    smooth_v_pipeline = smooth_v_data.createPipeline(ctx, shad, layout);
     bind_group = binding;
+
+    if (!texture_output)
+        return;
+    auto* tex_src = text_shad_lib.shad_src.find(tex_shader_file);
+    if (!checkAlwaysRel(tex_src, "shader not found"))
+        return;
+    WGPUShaderModule tex_shad = shaderFromSrc(ctx.device, tex_src->text.c_str());
+    defer_ { WGPU_REL(ShaderModule, tex_shad); };
+    flow_tex = createFlowTexture(ctx.device, "flow field tex", size, 1,
+        WGPUTextureUsage_StorageBinding | WGPUTextureUsage_TextureBinding |
+            WGPUTextureUsage_CopySrc);
+    temp_alloc_resource.reset();
+    auto [tex_layout, tex_binding] =
+        BGLCombinedBuilder{.al = tmp_alloc} //
+            .addUniform(sizeof(UBO), uniform_buf, 0, WGPUShaderStage_Compute)
+            .addStorageBuffer(16 * 16, output_buf, WGPUShaderStage_Compute, true)
+            .addStorageTexture(flow_tex.view, k_flow_tex_format)
+            .createLayoutAndGroup(ctx.device);
+    tex_bgl_layout = tex_layout;
+    tex_bind_group = tex_binding;
+    to_tex_pipeline = to_tex_data.createPipeline(ctx, tex_shad, tex_layout);
 }
 
 void vex::flow::ComputeFields::compute(wgfx::CompContext& ctx, const ComputeArgs& args)
 { //
     wgpuComputePassEncoderSetPipeline(ctx.comp_pass, pipeline);
     wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, bind_group, 0, nullptr);
+    const u32 smooth_radius = std::min(args.smooth_radius, (u32)k_max_smooth_radius);
     UBO vbo{
         .size = args.map_size,
         .flags = args.flags,
+        .smooth_radius = smooth_radius,
     };
     updateUniform(ctx, uniform_buf, vbo);
 
-    const auto work_size = args.map_size.x * args.map_size.y;
-    check_((work_size % 64) == 0);
-
-    u32 num_groups = (work_size / (64 * 32));
+    // one invocation per cell in k_conv_tile^2 tiles, edge tiles are partial
+    const u32 tiles_x = (args.map_size.x + k_conv_tile - 1) / k_conv_tile;
+    const u32 tiles_y = (args.map_size.y + k_conv_tile - 1) / k_conv_tile;
+    wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, tiles_x, tiles_y, 1);
 
-    wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, num_groups > 0 ? num_groups : 1, 1, 1);
+    // separable smoothing, one workgroup per 64 cell run of a row (then column) + halo
+    if ((args.flags & k_flag_smooth) && smooth_radius > 0)
+    {
+        if (args.profiler)
+            args.profiler->beginScope(ctx.comp_pass, k_prof_scope_smooth);
+        const u32 runs_x = (args.map_size.x + 63) / 64;
+        const u32 runs_y = (args.map_size.y + 63) / 64;
+        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, smooth_h_pipeline);
+        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, runs_x, args.map_size.y, 1);
+        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, smooth_v_pipeline);
+        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, runs_y, args.map_size.x, 1);
+        if (args.profiler)
+            args.profiler->endScope(ctx.comp_pass, k_prof_scope_smooth);
+    }
+    if (to_tex_pipeline)
+    {
+        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, to_tex_pipeline);
+        wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, tex_bind_group, 0, nullptr);
+        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass,
+            (args.map_size.x + k_tex_tile - 1) / k_tex_tile,
+            (args.map_size.y + k_tex_tile - 1) / k_tex_tile, 1);
+    }
 
     wgpuComputePassEncoderEnd(ctx.comp_pass);
     WGPU_REL(ComputePassEncoder, ctx.comp_pass);
-    wgpuCommandEncoderCopyBufferToBuffer(
-        ctx.encoder, output_buf.buffer, 0, staging_buf.buffer, 0, staging_buf.desc.size);
+    // one copy in flight at a time, keeps readback latency bounded and bandwidth low
+    if (readback_requested && !readback_ticket.isValid())
+    {
+        readback_ticket = readback.request(ctx.encoder, output_buf.buffer, 0,
+            (u64)args.map_size.x * args.map_size.y * sizeof(v2f));
+        readback_requested = !readback_ticket.isValid();
+    }
+}
+
+void vex::flow::ComputeFields::pollReadback()
+{
+    readback.submitted();
+    if (!readback_ticket.isValid() || readback.isPending(readback_ticket))
+        return;
+    ROSpan<u8> bytes = readback.tryGet(readback_ticket);
+    if (bytes.len > 0)
+    {
+        cpu_flow.len = 0;
+        cpu_flow.addUninitialized(bytes.len / sizeof(v2f));
+        std::memcpy(cpu_flow.data(), bytes.data, bytes.len);
+    }
+    readback.release(readback_ticket);
 }
 
 bool vex::flow::ComputeFields::reloadShaders(
@@ -453,11 +583,258 @@ bool vex::flow::ComputeFields::reloadShaders(
         return false;
 
     WGPU_REL(ComputePipeline, pipeline);
+    WGPU_REL(ComputePipeline, smooth_h_pipeline);
+    WGPU_REL(ComputePipeline, smooth_v_pipeline);
     pipeline = pipeline_data.createPipeline(context, compute, bgl_layout);
-    check_(pipeline);
+    smooth_h_pipeline = smooth_h_data.createPipeline(context, compute, bgl_layout);
+    smooth_v_pipeline = smooth_v_data.createPipeline(context, compute, bgl_layout);
+    check_(pipeline && smooth_h_pipeline && smooth_v_pipeline);
+    if (to_tex_pipeline)
+    {
+        WGPUShaderModule tex_shader = reloadShader(shader_lib, context, tex_shader_file);
+        if (tex_shader)
+        {
+            WGPU_REL(ComputePipeline, to_tex_pipeline);
+            to_tex_pipeline = to_tex_data.createPipeline(context, tex_shader, tex_bgl_layout);
+            check_(to_tex_pipeline);
+        }
+    }
+    return true;
+}
+
+void vex::flow::GpuDistanceSolver::init(const wgfx::GpuContext& ctx,
+    const TextShaderLib& text_shad_lib, const char* in_shader_file, wgfx::GpuBuffer& out_cells_buf,
+    v2u32 in_size)
+{
+    shader_file = in_shader_file;
+    size = in_size;
+    tiles = {(size.x + k_tile_size - 1) / k_tile_size, (size.y + k_tile_size - 1) / k_tile_size};
+    vex::InlineBufferAllocator<4096> temp_alloc_resource;
+    auto tmp_alloc = temp_alloc_resource.makeAllocatorHandle();
+
+    auto* src = text_shad_lib.shad_src.find(shader_file);
+    if (!checkAlwaysRel(src, "shader not found"))
+        return;
+    WGPUShaderModule shad = shaderFromSrc(ctx.device, src->text.c_str());
+
+    const u32 num_cells = size.x * size.y;
+    const u32 num_tiles = tiles.x * tiles.y;
+    // frontier is padded to full dispatch rows
+    const u32 frontier_len = (num_tiles + k_frontier_row - 1) / k_frontier_row * k_frontier_row;
+
+    uniform_buf = GpuBuffer::create(ctx.device, {
+                                                    .label = "dist uni buf",
+                                                    .usage = WGPUBufferUsage_CopyDst |
+                                                             WGPUBufferUsage_Uniform,
+                                                    .size = sizeof(UBO),
+                                                });
+    open_buf = GpuBuffer::create(ctx.device, {
+                                                 .label = "dist open cells",
+                                                 .usage = WGPUBufferUsage_CopyDst |
+                                                          WGPUBufferUsage_Storage,
+                                                 .size = num_cells * 4,
+                                             });
+    density_buf = GpuBuffer::create(ctx.device, {
+                                                    .label = "dist crowd density",
+                                                    .usage = WGPUBufferUsage_CopyDst |
+                                                             WGPUBufferUsage_Storage,
+                                                    .size = num_cells * (u32)sizeof(v4f),
+                                                });
+    dist_buf = GpuBuffer::create(ctx.device, {
+                                                 .label = "dist state",
+                                                 .usage = WGPUBufferUsage_Storage,
+                                                 .size = num_cells * 4,
+                                             });
+    stamp_buf = GpuBuffer::create(ctx.device, {
+                                                  .label = "dist tile stamps",
+                                                  .usage = WGPUBufferUsage_Storage,
+                                                  .size = num_tiles * 4,
+                                              });
+    frontier_buf = GpuBuffer::create(ctx.device, {
+                                                     .label = "dist frontier",
+                                                     .usage = WGPUBufferUsage_Storage,
+                                                     .size = frontier_len * 4,
+                                                 });
+    control_buf = GpuBuffer::create(ctx.device, {
+                                                    .label = "dist control",
+                                                    .usage = WGPUBufferUsage_Storage |
+                                                             WGPUBufferUsage_CopySrc,
+                                                    .size = sizeof(Control),
+                                                });
+    indirect_buf = GpuBuffer::create(ctx.device, {
+                                                     .label = "dist indirect",
+                                                     .usage = WGPUBufferUsage_Storage |
+                                                              WGPUBufferUsage_Indirect,
+                                                     .size = 3 * sizeof(u32),
+                                                 });
+
+    auto [layout, binding] =
+        BGLCombinedBuilder{.al = tmp_alloc} //
+            .addUniform(sizeof(UBO), uniform_buf, 0, WGPUShaderStage_Compute)
+            .addStorageBuffer(16 * 16, open_buf, WGPUShaderStage_Compute, false)
+            .addStorageBuffer(16 * 16, dist_buf, WGPUShaderStage_Compute, false)
+            .addStorageBuffer(16, stamp_buf, WGPUShaderStage_Compute, false)
+            .addStorageBuffer(16, frontier_buf, WGPUShaderStage_Compute, false)
+            .addStorageBuffer(sizeof(Control), control_buf, WGPUShaderStage_Compute, false)
+            .addStorageBuffer(16 * 16, out_cells_buf, WGPUShaderStage_Compute, false)
+            .addStorageBuffer(16 * 16, density_buf, WGPUShaderStage_Compute, true)
+            .createLayoutAndGroup(ctx.device);
+
+    bgl_layout = layout;
+    bind_group = binding;
+    init_pipeline = init_pipeline_data.createPipeline(ctx, shad, layout);
+    frontier_pipeline = frontier_pipeline_data.createPipeline(ctx, shad, layout);
+    relax_pipeline = relax_pipeline_data.createPipeline(ctx, shad, layout);
+    finalize_pipeline = finalize_pipeline_data.createPipeline(ctx, shad, layout);
+    density_pipeline = density_pipeline_data.createPipeline(ctx, shad, layout);
+
+    auto* args_src = text_shad_lib.shad_src.find(args_shader_file);
+    if (!checkAlwaysRel(args_src, "shader not found"))
+        return;
+    WGPUShaderModule args_shad = shaderFromSrc(ctx.device, args_src->text.c_str());
+    auto [args_layout, args_binding] =
+        BGLCombinedBuilder{.al = tmp_alloc} //
+            .addStorageBuffer(sizeof(Control), control_buf, WGPUShaderStage_Compute, false)
+            .addStorageBuffer(16, frontier_buf, WGPUShaderStage_Compute, false)
+            .addStorageBuffer(3 * sizeof(u32), indirect_buf, WGPUShaderStage_Compute, false)
+            .createLayoutAndGroup(ctx.device);
+    args_bgl_layout = args_layout;
+    args_bind_group = args_binding;
+    args_pipeline = args_pipeline_data.createPipeline(ctx, args_shad, args_layout);
+}
+
+void vex::flow::GpuDistanceSolver::setMap(const wgfx::GpuContext& ctx, ROSpan<u8> source)
+{
+    check_(source.len == size.x * size.y);
+    vex::Buffer<u32> open;
+    open.reserve((i32)source.len);
+    for (u32 i = 0; i < source.len; ++i)
+        open.add(source.data[i] ? 1 : 0);
+    wgpuQueueWriteBuffer(ctx.queue, open_buf.buffer, 0, open.data(), open.byteSize());
+}
+
+void vex::flow::GpuDistanceSolver::compute(wgfx::CompContext& ctx, const SolveArgs& args)
+{
+    UBO ubo{
+        .size = size,
+        .tiles = tiles,
+        .goal = args.goal,
+        .flags = args.allow_diagonal ? 1u : 0u,
+        .density_weight = args.crowd.weight,
+        .density_comfort = args.crowd.comfort,
+        .max_extra_cost = args.crowd.max_extra,
+    };
+    updateUniform(ctx, uniform_buf, ubo);
+
+    const u32 num_cells = size.x * size.y;
+    const u32 num_tiles = tiles.x * tiles.y;
+    auto pass = ctx.comp_pass;
+    wgpuComputePassEncoderSetBindGroup(pass, 0, bind_group, 0, nullptr);
+    if (args.restart)
+        init_pipeline_data.dispatch(pass, init_pipeline, num_cells);
+    // crowd costs from last frame's density, one more pass after weight drops to 0 resets them
+    if (args.crowd.weight > 0 || crowd_applied)
+    {
+        density_pipeline_data.dispatch(pass, density_pipeline, num_cells);
+        crowd_applied = args.crowd.weight > 0;
+    }
+    for (u32 i = 0; i < args.iterations; ++i)
+    {
+        frontier_pipeline_data.dispatch(pass, frontier_pipeline, num_tiles);
+        wgpuComputePassEncoderSetBindGroup(pass, 0, args_bind_group, 0, nullptr);
+        wgpuComputePassEncoderSetPipeline(pass, args_pipeline);
+        wgpuComputePassEncoderDispatchWorkgroups(pass, 1, 1, 1);
+        wgpuComputePassEncoderSetBindGroup(pass, 0, bind_group, 0, nullptr);
+        wgpuComputePassEncoderSetPipeline(pass, relax_pipeline);
+        wgpuComputePassEncoderDispatchWorkgroupsIndirect(pass, indirect_buf.buffer, 0);
+    }
+    finalize_pipeline_data.dispatch(pass, finalize_pipeline, num_cells);
+}
+
+u32 vex::flow::GpuDistanceSolver::readLastFrontierBlocking(const wgfx::GpuContext& ctx)
+{
+    Control control;
+    if (!readBufferBlocking(ctx, control_buf.buffer, 0, sizeof(Control), &control))
+        return 0;
+    return control.last_frontier_len;
+}
+
+bool vex::flow::GpuDistanceSolver::reloadShaders(
+    vex::TextShaderLib& shader_lib, const wgfx::GpuContext& context)
+{
+    WGPUShaderModule args_shad = reloadShader(shader_lib, context, args_shader_file);
+    if (args_shad)
+    {
+        WGPU_REL(ComputePipeline, args_pipeline);
+        args_pipeline = args_pipeline_data.createPipeline(context, args_shad, args_bgl_layout);
+        check_(args_pipeline);
+    }
+    WGPUShaderModule shad = reloadShader(shader_lib, context, shader_file);
+    if (!shad)
+        return false;
+
+    WGPU_REL(ComputePipeline, init_pipeline);
+    WGPU_REL(ComputePipeline, frontier_pipeline);
+    WGPU_REL(ComputePipeline, relax_pipeline);
+    WGPU_REL(ComputePipeline, finalize_pipeline);
+    WGPU_REL(ComputePipeline, density_pipeline);
+    init_pipeline = init_pipeline_data.createPipeline(context, shad, bgl_layout);
+    frontier_pipeline = frontier_pipeline_data.createPipeline(context, shad, bgl_layout);
+    relax_pipeline = relax_pipeline_data.createPipeline(context, shad, bgl_layout);
+    finalize_pipeline = finalize_pipeline_data.createPipeline(context, shad, bgl_layout);
+    density_pipeline = density_pipeline_data.createPipeline(context, shad, bgl_layout);
+    check_(isValid());
     return true;
 }
 
+void vex::flow::GpuDistanceSolver::setWorkgroupSizes(const wgfx::WorkgroupTuning& tuning)
+{
+    for (wgfx::ComputePipeline* data : {&init_pipeline_data, &frontier_pipeline_data,
+             &density_pipeline_data, &finalize_pipeline_data})
+        data->workgroup_size = tuning.sizeOr(data->label);
+}
+
+void vex::flow::GpuDistanceSolver::tuneWorkgroupSizes(const wgfx::GpuContext& ctx,
+    const TextShaderLib& text_shad_lib, wgfx::WorkgroupTuning& tuning)
+{
+    auto* src = text_shad_lib.shad_src.find(shader_file);
+    if (!checkAlwaysRel(src, "shader not found"))
+        return;
+    WGPUShaderModule shad = shaderFromSrc(ctx.device, src->text.c_str());
+    defer_ { WGPU_REL(ShaderModule, shad); };
+
+    // crowd weight makes cs_apply_density do its full work on every open cell
+    const UBO ubo{
+        .size = size,
+        .tiles = tiles,
+        .goal = size / 2u,
+        .flags = 1,
+        .density_weight = 1,
+        .density_comfort = 0,
+        .max_extra_cost = 15,
+    };
+    updateUniform(ctx, uniform_buf, ubo);
+    const u32 num_cells = size.x * size.y;
+    const u32 num_tiles = tiles.x * tiles.y;
+    const std::pair<wgfx::ComputePipeline*, u32> kernels[] = {
+        {&init_pipeline_data, num_cells},
+        {&frontier_pipeline_data, num_tiles},
+        {&density_pipeline_data, num_cells},
+        {&finalize_pipeline_data, num_cells},
+    };
+    for (auto [data, items] : kernels)
+    {
+        tuning.tune(ctx, {
+                             .data = data,
+                             .shader = shad,
+                             .layout = bgl_layout,
+                             .bind_group = bind_group,
+                             .items = items,
+                             .sync_buf = &control_buf,
+                         });
+    }
+}
+
 void vex::flow::FlowFieldsOverlay::init(const wgfx::GpuContext& ctx,
     const TextShaderLib& text_shad_lib, wgfx::GpuBuffer& flow_v2f_buf, const char* in_shader_file)
 {
@@ -550,11 +927,224 @@ bool vex::flow::FlowFieldsOverlay::reloadShaders(
     return true;
 }
 
-void vex::flow::ParticleSym::spawnForSymulation(const wgfx::GpuContext& ctx, ROSpan<Particle> parts)
+u32 vex::flow::ParticleSym::appendParticles(
+    const wgfx::GpuContext& ctx, ROSpan<Particle> parts, u32 group)
+{
+    auto& life = life_data;
+    const u32 free_slots = life.max_spawn_batch - life.pending_spawn;
+    const u32 count = parts.len < free_slots ? parts.len : free_slots;
+    if (count == 0)
+        return 0;
+    if (!checkAlwaysRel(
+            group < group_data.count, "particles appended to a group that doesn't exist"))
+        return 0;
+    wgpuQueueWriteBuffer(ctx.queue, life.spawn_buf.buffer, life.pending_spawn * sizeof(Particle),
+        (u8*)parts.data, count * sizeof(Particle));
+    const std::vector<u32> groups(count, group);
+    wgpuQueueWriteBuffer(ctx.queue, life.spawn_groups_buf.buffer, life.pending_spawn * sizeof(u32),
+        (u8*)groups.data(), count * sizeof(u32));
+    life.pending_spawn += count;
+    life.queued_total += count;
+    return count;
+}
+
+void vex::flow::ParticleSym::pollReadback()
+{
+    auto& stats = stats_data;
+    stats.readback.submitted();
+    if (stats.readback_ticket.isValid() && !stats.readback.isPending(stats.readback_ticket))
+    {
+        ROSpan<u8> bytes = stats.readback.tryGet(stats.readback_ticket);
+        if (bytes.len >= sizeof(StatsGpu))
+        {
+            const StatsGpu* gpu = reinterpret_cast<const StatsGpu*>(bytes.data);
+            const f64 speed_sum =
+                (f64(gpu->speed_sum_hi) * 4294967296.0 + f64(gpu->speed_sum_lo)) /
+                k_stats_speed_scale;
+            stats.last = CrowdStats{
+                .arrived = gpu->arrived_total,
+                .moving = gpu->moving,
+                .mean_speed = gpu->moving > 0 ? f32(speed_sum / gpu->moving) : 0.0f,
+                .max_speed = f32(gpu->max_speed / k_stats_speed_scale),
+                .max_density = gpu->max_density,
+                .stuck = gpu->stuck,
+            };
+        }
+        stats.readback.release(stats.readback_ticket);
+    }
+
+    auto& life = life_data;
+    life.readback.submitted();
+    if (!life.readback_ticket.isValid() || life.readback.isPending(life.readback_ticket))
+        return;
+    ROSpan<u8> bytes = life.readback.tryGet(life.readback_ticket);
+    if (bytes.len >= sizeof(LiveControl))
+    {
+        const LiveControl* control = reinterpret_cast<const LiveControl*>(bytes.data);
+        life.last_live = control->live;
+        // counts taken before the last resort would trigger it again
+        if (life.readback_frame > resort_data.last_frame)
+            resort_data.last_disorder =
+                control->live > 1 ? f32(control->disorder) / f32(control->live) : 0.0f;
+    }
+    life.readback.release(life.readback_ticket);
+}
+
+u32 vex::flow::ParticleSym::createGroup(v2u32 goal)
+{
+    if (group_data.count >= sym_data.max_groups)
+        return ~0u;
+    group_data.goals[group_data.count] = {.cell = goal};
+    return group_data.count++;
+}
+
+void vex::flow::ParticleSym::retargetGroup(u32 group, v2u32 goal)
+{
+    if (checkAlwaysRel(group < group_data.count, "retargeting group that doesn't exist"))
+        group_data.goals[group].cell = goal;
+}
+
+void vex::flow::ParticleSym::updateGroupFlow(WGPUCommandEncoder encoder, u32 group,
+    const wgfx::GpuBuffer& flow, const wgfx::TextureView* flow_tex)
+{
+    if (!checkAlwaysRel(group < sym_data.max_groups, "flow layer out of range"))
+        return;
+    // buffer layers are kept in texture mode too, snapshots read them
+    wgpuCommandEncoderCopyBufferToBuffer(encoder, flow.buffer, 0, sym_data.flow_layers_buf.buffer,
+        group * sym_data.flow_layer_bytes, sym_data.flow_layer_bytes);
+    if (!sym_data.flow_texture)
+        return;
+    if (!checkAlwaysRel(flow_tex && flow_tex->texture, "flow texture missing in texture mode"))
+        return;
+    const WGPUImageCopyTexture src{
+        .texture = flow_tex->texture,
+        .mipLevel = 0,
+        .origin = {0, 0, 0},
+        .aspect = WGPUTextureAspect_All,
+    };
+    const WGPUImageCopyTexture dst{
+        .texture = sym_data.flow_layers_tex.texture,
+        .mipLevel = 0,
+        .origin = {0, 0, group},
+        .aspect = WGPUTextureAspect_All,
+    };
+    const WGPUExtent3D extent{flow_tex->size.x, flow_tex->size.y, 1};
+    wgpuCommandEncoderCopyTextureToTexture(encoder, &src, &dst, &extent);
+}
+
+bool vex::flow::ParticleSym::readParticlesBlocking(const wgfx::GpuContext& ctx,
+    std::vector<Particle>& out, std::vector<u32>& groups, std::vector<v2f>& flow_layers)
+{
+    out.clear();
+    groups.clear();
+    flow_layers.resize(group_data.count * sym_data.flow_layer_bytes / sizeof(v2f));
+    if (!flow_layers.empty() &&
+        !readBufferBlocking(ctx, sym_data.flow_layers_buf.buffer, 0,
+            flow_layers.size() * sizeof(v2f), flow_layers.data()))
+        return false;
+    if (life_data.queued_total == 0)
+        return true;
+    LiveControl control;
+    if (!readBufferBlocking(ctx, life_data.control_buf.buffer, 0, sizeof(control), &control))
+        return false;
+    const u32 live = std::min(control.live, sym_data.max_particles);
+    if (live == 0)
+        return true;
+    const u32 stride = particleStride(format);
+    std::vector<u8> bytes((size_t)live * stride);
+    if (!readBufferBlocking(ctx, hash_data.particle_data_buf.buffer, 0, bytes.size(), bytes.data()))
+        return false;
+    groups.resize(live);
+    if (!readBufferBlocking(
+            ctx, life_data.alive_buf.buffer, 0, live * sizeof(u32), groups.data()))
+        return false;
+    for (u32& g : groups) // alive flag to group, arrived ones are dropped by next compaction
+        g = g > 0 ? g - 1 : 0;
+    out.resize(live);
+    if (format == ParticleFormat::k_packed)
+    {
+        const PackedParticle* packed = reinterpret_cast<const PackedParticle*>(bytes.data());
+        for (u32 i = 0; i < live; ++i)
+            out[i] = packed[i].unpack(sym_data.grid_min, sym_data.grid_size);
+    }
+    else
+        std::memcpy(out.data(), bytes.data(), bytes.size());
+    return true;
+}
+
+void vex::flow::ParticleSym::restoreParticles(const wgfx::GpuContext& ctx,
+    ROSpan<Particle> parts, ROSpan<u32> groups, ROSpan<v2f> flow_layers)
 {
-    sym_data.num_particles = parts.len;
-    wgpuQueueWriteBuffer(
-        ctx.queue, hash_data.particle_data_buf.buffer, 0, (u8*)parts.data, parts.byteSize());
+    auto& life = life_data;
+    const u32 live = std::min(parts.len, sym_data.max_particles);
+    if (live < parts.len)
+        SPDLOG_WARN("restored particles don't fit capacity, dropped {}", parts.len - live);
+    if (format == ParticleFormat::k_packed)
+    {
+        if (!checkAlwaysRel(sym_data.grid_size.x > 0, "packed particles restored before compute"))
+            return;
+        std::vector<PackedParticle> packed(live);
+        for (u32 i = 0; i < live; ++i)
+            packed[i] = PackedParticle::pack(parts.data[i], sym_data.grid_min, sym_data.grid_size);
+        wgpuQueueWriteBuffer(ctx.queue, hash_data.particle_data_buf.buffer, 0, (u8*)packed.data(),
+            live * sizeof(PackedParticle));
+    }
+    else if (live > 0)
+        wgpuQueueWriteBuffer(ctx.queue, hash_data.particle_data_buf.buffer, 0, (u8*)parts.data,
+            live * sizeof(Particle));
+
+    const u64 layers_bytes = std::min<u64>(
+        flow_layers.len * sizeof(v2f), sym_data.max_groups * sym_data.flow_layer_bytes);
+    if (layers_bytes > 0)
+        wgpuQueueWriteBuffer(ctx.queue, sym_data.flow_layers_buf.buffer, 0, (u8*)flow_layers.data,
+            layers_bytes);
+    const v3u32 tex_size = sym_data.flow_layers_tex.size;
+    const u32 tex_layers = (u32)(layers_bytes / sym_data.flow_layer_bytes);
+    if (sym_data.flow_texture && tex_layers > 0)
+    {
+        // rgba16float texels, direction in xy
+        const u32 texels = tex_layers * tex_size.x * tex_size.y;
+        std::vector<u32> halfs(texels * 2, 0u);
+        for (u32 i = 0; i < texels; ++i)
+            halfs[i * 2] = glm::packHalf2x16(flow_layers.data[i]);
+        const WGPUImageCopyTexture dst{
+            .texture = sym_data.flow_layers_tex.texture,
+            .mipLevel = 0,
+            .origin = {0, 0, 0},
+            .aspect = WGPUTextureAspect_All,
+        };
+        const WGPUTextureDataLayout layout{
+            .offset = 0,
+            .bytesPerRow = tex_size.x * 2 * (u32)sizeof(u32),
+            .rowsPerImage = tex_size.y,
+        };
+        const WGPUExtent3D extent{tex_size.x, tex_size.y, tex_layers};
+        wgpuQueueWriteTexture(
+            ctx.queue, &dst, halfs.data(), halfs.size() * sizeof(u32), &layout, &extent);
+    }
+
+    // alive flag is group + 1, flags past the live set are rewritten by append before anything
+    // reads them
+    std::vector<u32> alive(live, 1u);
+    for (u32 i = 0; i < live && i < groups.len; ++i)
+        alive[i] = groups.data[i] + 1;
+    if (live > 0)
+        wgpuQueueWriteBuffer(ctx.queue, life.alive_buf.buffer, 0, (u8*)alive.data(),
+            live * sizeof(u32));
+    const LiveControl control{.live = live, .capacity = sym_data.max_particles};
+    wgpuQueueWriteBuffer(ctx.queue, life.control_buf.buffer, 0, (u8*)&control, sizeof(control));
+    IndirectArgs indirect;
+    indirect.dispatch[0] = (live + 63) / 64;
+    wgpuQueueWriteBuffer(ctx.queue, life.indirect_buf.buffer, 0, (u8*)&indirect, sizeof(indirect));
+
+    life.pending_spawn = 0;
+    life.last_live = live;
+    life.queued_total = live;
+    resort_data.last_disorder = 0;
+
+    const StatsGpu stats{};
+    wgpuQueueWriteBuffer(ctx.queue, stats_data.stats_buf.buffer, 0, (u8*)&stats, sizeof(stats));
+    stats_data.last = {};
 }
 
 void vex::flow::ParticleSym::init(
@@ -562,6 +1152,60 @@ void vex::flow::ParticleSym::init(
 {
     vex::InlineBufferAllocator<4096> temp_alloc_resource;
     auto tmp_alloc = temp_alloc_resource.makeAllocatorHandle();
+
+    format = args.format;
+    format_consts[0].value = format == ParticleFormat::k_packed ? 1.0 : 0.0;
+    sym_data.flow_texture = args.flow_texture;
+    move_consts[0].value = format_consts[0].value;
+    move_consts[1].value = args.flow_texture ? 1.0 : 0.0;
+    const u32 particle_stride = particleStride(format);
+    // every per particle and per table cell buffer is a single binding, capacity and table
+    // resolution are cut down to what the device can bind and dispatch
+    {
+        const u64 max_binding = std::min<u64>(args.max_binding_size, 0xffff'fffcu);
+        // compact_tmp_buf carries alive flags after the particles
+        const u64 widest = std::max<u64>(particle_stride + sizeof(u32), sizeof(v2f));
+        const u32 max_capacity = (u32)std::min<u64>(max_binding / widest, k_max_dispatch_items);
+        if (args.max_particles > max_capacity)
+        {
+            SPDLOG_WARN("particle capacity {} exceeds device limits, clamped to {}",
+                args.max_particles, max_capacity);
+            args.max_particles = max_capacity;
+        }
+        auto tableCells = [&](u32 subdiv) -> u64
+        { return (u64)args.bounds.x * args.bounds.y * subdiv * subdiv; };
+        u32 subdiv = k_max_table_subdiv;
+        while (subdiv > 1 && ((tableCells(subdiv) + 1) * sizeof(u32) > max_binding ||
+                                 tableCells(subdiv) + 1 > k_max_dispatch_items))
+            subdiv--;
+        if (subdiv < k_max_table_subdiv)
+            SPDLOG_WARN("spatial table limited to {} cells per map cell side", subdiv);
+        hash_data.max_table_subdiv = subdiv;
+    }
+    auto useFormat = [&](std::initializer_list<wgfx::ComputePipeline*> pipelines)
+    {
+        for (wgfx::ComputePipeline* data : pipelines)
+        {
+            data->descriptor.constantCount = 1;
+            data->descriptor.constants = format_consts;
+        }
+    };
+    useFormat({&hash_data.zero_pipeline_data, &hash_data.count_pipeline_data,
+        &hash_data.scatter_pipeline_data, &hash_data.order_pipeline_data, &hash_data.density_data,
+        &sym_data.move_pipeline_data, &sym_data.solve_pipeline_data, &life_data.append_data,
+        &life_data.compact_count_data, &life_data.compact_scan_data,
+        &life_data.compact_scatter_data, &life_data.compact_copy_data, &vis_data.cull_reset_data,
+        &vis_data.cull_data, &resort_data.gather_data, &resort_data.copy_data,
+        &stats_data.particles_data});
+    morton_consts[0].value = format_consts[0].value;
+    for (wgfx::ComputePipeline* data : {&hash_data.morton_zero_data, &hash_data.morton_count_data,
+             &hash_data.morton_scatter_data})
+    {
+        data->descriptor.constantCount = 2;
+        data->descriptor.constants = morton_consts;
+    }
+    sym_data.move_pipeline_data.descriptor.constantCount = 2;
+    sym_data.move_pipeline_data.descriptor.constants = move_consts;
     // init hashing compute
     {
         defer_ { temp_alloc_resource.reset(); };
@@ -571,6 +1215,9 @@ void vex::flow::ParticleSym::init(
         if (!checkAlwaysRel(src, "shader not found"))
             return;
         WGPUShaderModule shad = shaderFromSrc(ctx.device, src->text.c_str());
+        checkLethal(args.density_buf != nullptr, "passed nullptr instead of density buffer");
+        checkLethal(args.prims && args.prims->isValid(), "compute primitives not initialized");
+        hash_data.density_buf = args.density_buf;
 
         hash_data.uniform_buf = GpuBuffer::create(
             ctx.device, {
@@ -578,52 +1225,97 @@ void vex::flow::ParticleSym::init(
                             .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
                             .size = sizeof(SimulateUBO),
                         });
+        sym_data.max_particles = args.max_particles;
         hash_data.particle_data_buf = GpuBuffer::create(
             ctx.device, {
                             .label = "particle buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc |
+                                     WGPUBufferUsage_Storage,
+                            .size = args.max_particles * particle_stride,
+                        });
+        hash_data.max_table_cells = args.bounds.x * args.bounds.y * hash_data.max_table_subdiv *
+                                    hash_data.max_table_subdiv;
+        hash_data.cell_count = GpuBuffer::create(
+            ctx.device, {
+                            .label = "cell count buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                            .size = (u32)(hash_data.max_table_cells * sizeof(u32)),
+                        });
+        hash_data.cell_start = GpuBuffer::create(
+            ctx.device, {
+                            .label = "cell start buf",
                             .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
-                            .size = (u32)(args.max_particles * sizeof(Particle)),
+                            .size = (u32)((hash_data.max_table_cells + 1) * sizeof(u32)),
                         });
-        auto table_size = args.bounds.x * args.bounds.y * spatial_table_depth * 8 * 4;
-        hash_data.spatial_table = GpuBuffer::create(
+        hash_data.sorted_indices = GpuBuffer::create(
             ctx.device, {
-                            .label = "table buf",
+                            .label = "sorted particles buf",
                             .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
-                            .size = (u32)(table_size), // any way to fetch struct size from shader?
+                            .size = (u32)(args.max_particles * sizeof(u32)),
                         });
-        hash_data.counters = GpuBuffer::create(
+        hash_data.slots = GpuBuffer::create(
             ctx.device, {
-                            .label = "counter buf",
+                            .label = "particle slots buf",
                             .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
-                            .size = (u32)(table_size),
+                            .size = (u32)(args.max_particles * sizeof(v2u32)),
                         });
-        auto dbg = GpuBuffer::create(
+        hash_data.sorted_pos = GpuBuffer::create(
             ctx.device, {
-                            .label = "counter buf",
+                            .label = "sorted positions buf",
                             .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
-                            .size = (u32)(args.max_particles * 4),
+                            .size = (u32)(args.max_particles * sizeof(v2f)),
+                        });
+
+        life_data.control_buf = GpuBuffer::create(
+            ctx.device, {
+                            .label = "particle control buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc |
+                                     WGPUBufferUsage_Storage,
+                            .size = sizeof(LiveControl),
+                        });
+        const LiveControl control{.capacity = args.max_particles};
+        wgpuQueueWriteBuffer(
+            ctx.queue, life_data.control_buf.buffer, 0, (u8*)&control, sizeof(control));
+        life_data.alive_buf = GpuBuffer::create(
+            ctx.device, {
+                            .label = "particle alive buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc |
+                                     WGPUBufferUsage_Storage,
+                            .size = (u32)(args.max_particles * sizeof(u32)),
                         });
 
-        //constexpr auto k1 = offsetof(SimulateUBO, flags);
-        //constexpr auto k2 = offsetof(SimulateUBO, spatial_table_size);
-        // counting pipeline
         auto [layout, binding] =
             BGLCombinedBuilder{.al = tmp_alloc} //
                 .addUniform(sizeof(SimulateUBO), hash_data.uniform_buf, 0, WGPUShaderStage_Compute)
                 .addStorageBuffer(256, hash_data.particle_data_buf, WGPUShaderStage_Compute, true)
-                .addStorageBuffer(256, hash_data.counters, WGPUShaderStage_Compute, false)
-                .addStorageBuffer(256, hash_data.spatial_table, WGPUShaderStage_Compute, false)
-                .addStorageBuffer(256, dbg, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, hash_data.cell_start, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(256, hash_data.sorted_indices, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, hash_data.slots, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, hash_data.sorted_pos, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(
+                    sizeof(LiveControl), life_data.control_buf, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, *hash_data.density_buf, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, hash_data.cell_count, WGPUShaderStage_Compute, false)
                 .createLayoutAndGroup(ctx.device);
 
         hash_data.bgl_layout = layout;
-        hash_data.count_pipeline = hash_data.count_pipeline_data.createPipeline(ctx, shad, layout);
         hash_data.bind_group = binding;
-
         hash_data.zero_pipeline = hash_data.zero_pipeline_data.createPipeline(ctx, shad, layout);
-        // hash_data.hash_pipeline = hash_data.hash_pipeline_data.createPipeline(ctx, shad, layout);
-        // hash_data.calc_offsets_pipeline = hash_data.calc_offsets_pipeline_data.createPipeline(
-        //     ctx, shad, layout);
+        hash_data.count_pipeline = hash_data.count_pipeline_data.createPipeline(ctx, shad, layout);
+        hash_data.scatter_pipeline =
+            hash_data.scatter_pipeline_data.createPipeline(ctx, shad, layout);
+        hash_data.order_pipeline = hash_data.order_pipeline_data.createPipeline(ctx, shad, layout);
+        hash_data.morton_zero_pipeline =
+            hash_data.morton_zero_data.createPipeline(ctx, shad, layout);
+        hash_data.morton_count_pipeline =
+            hash_data.morton_count_data.createPipeline(ctx, shad, layout);
+        hash_data.morton_scatter_pipeline =
+            hash_data.morton_scatter_data.createPipeline(ctx, shad, layout);
+        hash_data.density_pipeline = hash_data.density_data.createPipeline(ctx, shad, layout);
+        hash_data.cell_scan.init(ctx, *args.prims, hash_data.cell_count, hash_data.cell_start,
+            hash_data.max_table_cells);
+        hash_data.morton_scan.init(ctx, *args.prims, hash_data.cell_count, hash_data.cell_start,
+            hash_data.max_table_cells);
     }
     // init simulation compute
     {
@@ -636,23 +1328,52 @@ void vex::flow::ParticleSym::init(
             return;
         WGPUShaderModule shad = shaderFromSrc(ctx.device, src->text.c_str());
 
-        checkLethal(args.flow_v2f_buf != nullptr, "passed nullptr instead of input buffer");
-
-        auto dbg = GpuBuffer::create(
+        checkLethal(args.walls != nullptr, "passed nullptr instead of wall field");
+        sym_data.flow_layer_bytes = (u64)args.bounds.x * args.bounds.y * sizeof(v2f);
+        const u64 max_binding = std::min<u64>(args.max_binding_size, 0xffff'fffcu);
+        sym_data.max_groups = (u32)std::clamp<u64>(
+            max_binding / std::max<u64>(sym_data.flow_layer_bytes, 1), 1, SimulateUBO::k_max_groups);
+        if (sym_data.max_groups < SimulateUBO::k_max_groups)
+            SPDLOG_WARN("flow fields of {} agent groups fit device limits", sym_data.max_groups);
+        sym_data.flow_layers_buf = GpuBuffer::create(
             ctx.device, {
-                            .label = "counter buf",
-                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
-                            .size = (u32)(args.max_particles * 4),
+                            .label = "flow layers buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_CopySrc |
+                                     WGPUBufferUsage_Storage,
+                            .size = (u32)(sym_data.flow_layer_bytes * sym_data.max_groups),
                         });
+        const v2u32 tex_size = args.flow_texture ? args.bounds : v2u32{1, 1};
+        sym_data.flow_layers_tex = createFlowTexture(ctx.device, "flow layers tex", tex_size,
+            args.flow_texture ? sym_data.max_groups : 1,
+            WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst, true);
+        sym_data.wall_subdiv = args.walls->subdiv;
+        sym_data.walls_buf = GpuBuffer::create(ctx.device,
+            {
+                .label = "wall field buf",
+                .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                .size = (u32)(args.walls->samples.size() * sizeof(WallField::Sample)),
+            },
+            (u8*)args.walls->samples.data(),
+            (u32)(args.walls->samples.size() * sizeof(WallField::Sample)));
 
         auto [layout, binding] =
             BGLCombinedBuilder{.al = tmp_alloc} //
                 .addUniform(sizeof(SimulateUBO), hash_data.uniform_buf, 0, WGPUShaderStage_Compute)
                 .addStorageBuffer(256, hash_data.particle_data_buf, WGPUShaderStage_Compute, false)
-                .addStorageBuffer(256, *(args.flow_v2f_buf), WGPUShaderStage_Compute, true)
-                .addStorageBuffer(256, *(args.cells_buf), WGPUShaderStage_Compute, true)
-                .addStorageBuffer(256, hash_data.spatial_table, WGPUShaderStage_Compute, true)
-                .addStorageBuffer(256, dbg, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, sym_data.flow_layers_buf, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(256, sym_data.walls_buf, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(256, hash_data.cell_start, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(256, hash_data.sorted_pos, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(256, *(args.clearance_buf), WGPUShaderStage_Compute, true)
+                .addStorageBuffer(256, life_data.alive_buf, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(16, life_data.control_buf, WGPUShaderStage_Compute, false)
+                .addTexView(sym_data.flow_layers_tex.view,
+                    {
+                        .sampleType = WGPUTextureSampleType_Float,
+                        .viewDimension = WGPUTextureViewDimension_2DArray,
+                    },
+                    WGPUShaderStage_Compute)
+                .addSampler(sym_data.flow_layers_tex.sampler, WGPUShaderStage_Compute)
                 .createLayoutAndGroup(ctx.device);
 
         sym_data.bgl_layout = layout;
@@ -660,7 +1381,195 @@ void vex::flow::ParticleSym::init(
         sym_data.bind_group = binding;
 
         sym_data.solve_pipeline = sym_data.solve_pipeline_data.createPipeline(ctx, shad, layout);
-        sym_data.solve_pass2_pipeline = sym_data.solve_pass2_data.createPipeline(ctx, shad, layout);
+    }
+    // init lifetime compute
+    {
+        defer_ { temp_alloc_resource.reset(); };
+        auto& life = life_data;
+        life.shader = args.shader_life;
+        auto* src = text_shad_lib.shad_src.find(life.shader);
+        if (!checkAlwaysRel(src, "shader not found"))
+            return;
+        WGPUShaderModule shad = shaderFromSrc(ctx.device, src->text.c_str());
+
+        life.max_spawn_batch = args.max_spawn_batch;
+        life.spawn_buf = GpuBuffer::create(
+            ctx.device, {
+                            .label = "particle spawn buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                            .size = (u32)(args.max_spawn_batch * sizeof(Particle)),
+                        });
+        life.spawn_groups_buf = GpuBuffer::create(
+            ctx.device, {
+                            .label = "particle spawn groups buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                            .size = (u32)(args.max_spawn_batch * sizeof(u32)),
+                        });
+        life.compact_tmp_buf = GpuBuffer::create(
+            ctx.device, {
+                            .label = "particle compact buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                            .size = args.max_particles * (particle_stride + (u32)sizeof(u32)),
+                        });
+        life.offsets_buf = GpuBuffer::create(
+            ctx.device, {
+                            .label = "particle offsets buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                            .size = (u32)((args.max_particles + 1) * sizeof(u32)),
+                        });
+        life.readback.init(ctx.device, sizeof(LiveControl), 2, "particle count readback");
+        life.indirect_buf = GpuBuffer::create(
+            ctx.device, {
+                            .label = "particle indirect buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage |
+                                     WGPUBufferUsage_Indirect,
+                            .size = sizeof(IndirectArgs),
+                        });
+        const IndirectArgs initial_args{};
+        wgpuQueueWriteBuffer(
+            ctx.queue, life.indirect_buf.buffer, 0, (u8*)&initial_args, sizeof(initial_args));
+
+        auto [layout, binding] =
+            BGLCombinedBuilder{.al = tmp_alloc} //
+                .addStorageBuffer(16, life.control_buf, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, hash_data.particle_data_buf, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, life.alive_buf, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, life.spawn_buf, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(256, life.compact_tmp_buf, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, life.offsets_buf, WGPUShaderStage_Compute, false)
+                .addUniform(sizeof(SimulateUBO), hash_data.uniform_buf, 0, WGPUShaderStage_Compute)
+                .addStorageBuffer(256, life.spawn_groups_buf, WGPUShaderStage_Compute, true)
+                .createLayoutAndGroup(ctx.device);
+        life.bgl_layout = layout;
+        life.bind_group = binding;
+        life.append_pipeline = life.append_data.createPipeline(ctx, shad, layout);
+        life.compact_count_pipeline = life.compact_count_data.createPipeline(ctx, shad, layout);
+        life.compact_scan_pipeline = life.compact_scan_data.createPipeline(ctx, shad, layout);
+        life.compact_scatter_pipeline = life.compact_scatter_data.createPipeline(ctx, shad, layout);
+        life.compact_copy_pipeline = life.compact_copy_data.createPipeline(ctx, shad, layout);
+    }
+    // init live count commits, the only writers of the particle dispatch args
+    {
+        defer_ { temp_alloc_resource.reset(); };
+        auto& life = life_data;
+        life.commit_shader = args.shader_commit;
+        auto* src = text_shad_lib.shad_src.find(life.commit_shader);
+        if (!checkAlwaysRel(src, "shader not found"))
+            return;
+        WGPUShaderModule shad = shaderFromSrc(ctx.device, src->text.c_str());
+
+        auto [layout, binding] =
+            BGLCombinedBuilder{.al = tmp_alloc} //
+                .addStorageBuffer(16, life.control_buf, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, life.offsets_buf, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(sizeof(IndirectArgs), life.indirect_buf, WGPUShaderStage_Compute,
+                    false)
+                .createLayoutAndGroup(ctx.device);
+        life.commit_bgl_layout = layout;
+        life.commit_bind_group = binding;
+        life.append_commit_pipeline = life.append_commit_data.createPipeline(ctx, shad, layout);
+        life.compact_commit_pipeline = life.compact_commit_data.createPipeline(ctx, shad, layout);
+    }
+    // init memory resort
+    {
+        defer_ { temp_alloc_resource.reset(); };
+        auto& resort = resort_data;
+        resort.shader = args.shader_resort;
+        auto* src = text_shad_lib.shad_src.find(resort.shader);
+        if (!checkAlwaysRel(src, "shader not found"))
+            return;
+        WGPUShaderModule shad = shaderFromSrc(ctx.device, src->text.c_str());
+
+        auto [layout, binding] =
+            BGLCombinedBuilder{.al = tmp_alloc} //
+                .addStorageBuffer(256, hash_data.particle_data_buf, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, life_data.compact_tmp_buf, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(256, hash_data.sorted_indices, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(16, life_data.control_buf, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(256, life_data.alive_buf, WGPUShaderStage_Compute, false)
+                .createLayoutAndGroup(ctx.device);
+        resort.bgl_layout = layout;
+        resort.bind_group = binding;
+        resort.gather_pipeline = resort.gather_data.createPipeline(ctx, shad, layout);
+        resort.copy_pipeline = resort.copy_data.createPipeline(ctx, shad, layout);
+    }
+    // init culling
+    {
+        defer_ { temp_alloc_resource.reset(); };
+        vis_data.cull_shader = args.shader_cull;
+        auto* src = text_shad_lib.shad_src.find(vis_data.cull_shader);
+        if (!checkAlwaysRel(src, "shader not found"))
+            return;
+        WGPUShaderModule shad = shaderFromSrc(ctx.device, src->text.c_str());
+
+        vis_data.cull_uniform_buf = GpuBuffer::create(
+            ctx.device, {
+                            .label = "particle cull uni buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform,
+                            .size = sizeof(CullUBO),
+                        });
+        vis_data.visible_buf = GpuBuffer::create(
+            ctx.device, {
+                            .label = "visible particles buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                            .size = (u32)(args.max_particles * sizeof(u32)),
+                        });
+        vis_data.draw_args_buf = GpuBuffer::create(
+            ctx.device, {
+                            .label = "particle draw args buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage |
+                                     WGPUBufferUsage_Indirect,
+                            .size = sizeof(DrawArgs),
+                        });
+        const DrawArgs initial_draw{};
+        wgpuQueueWriteBuffer(
+            ctx.queue, vis_data.draw_args_buf.buffer, 0, (u8*)&initial_draw, sizeof(initial_draw));
+        auto [layout, binding] =
+            BGLCombinedBuilder{.al = tmp_alloc} //
+                .addUniform(sizeof(CullUBO), vis_data.cull_uniform_buf, 0, WGPUShaderStage_Compute)
+                .addStorageBuffer(256, hash_data.particle_data_buf, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(16, life_data.control_buf, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(256, vis_data.visible_buf, WGPUShaderStage_Compute, false)
+                .addStorageBuffer(sizeof(DrawArgs), vis_data.draw_args_buf, WGPUShaderStage_Compute,
+                    false)
+                .createLayoutAndGroup(ctx.device);
+        vis_data.cull_bgl_layout = layout;
+        vis_data.cull_bind_group = binding;
+        vis_data.cull_reset_pipeline = vis_data.cull_reset_data.createPipeline(ctx, shad, layout);
+        vis_data.cull_pipeline = vis_data.cull_data.createPipeline(ctx, shad, layout);
+    }
+    // init crowd stats
+    {
+        defer_ { temp_alloc_resource.reset(); };
+        auto& stats = stats_data;
+        stats.shader = args.shader_stats;
+        auto* src = text_shad_lib.shad_src.find(stats.shader);
+        if (!checkAlwaysRel(src, "shader not found"))
+            return;
+        WGPUShaderModule shad = shaderFromSrc(ctx.device, src->text.c_str());
+
+        stats.stats_buf = GpuBuffer::create(
+            ctx.device, {
+                            .label = "particle stats buf",
+                            .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage |
+                                     WGPUBufferUsage_CopySrc,
+                            .size = sizeof(StatsGpu),
+                        });
+        stats.readback.init(ctx.device, sizeof(StatsGpu), 2, "particle stats readback");
+        auto [layout, binding] =
+            BGLCombinedBuilder{.al = tmp_alloc} //
+                .addUniform(sizeof(SimulateUBO), hash_data.uniform_buf, 0, WGPUShaderStage_Compute)
+                .addStorageBuffer(256, hash_data.particle_data_buf, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(256, life_data.alive_buf, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(16, life_data.control_buf, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(16, *hash_data.density_buf, WGPUShaderStage_Compute, true)
+                .addStorageBuffer(sizeof(StatsGpu), stats.stats_buf, WGPUShaderStage_Compute, false)
+                .createLayoutAndGroup(ctx.device);
+        stats.bgl_layout = layout;
+        stats.bind_group = binding;
+        stats.begin_pipeline = stats.begin_data.createPipeline(ctx, shad, layout);
+        stats.particles_pipeline = stats.particles_data.createPipeline(ctx, shad, layout);
+        stats.cells_pipeline = stats.cells_data.createPipeline(ctx, shad, layout);
     }
     // init visual
     {
@@ -697,6 +1606,8 @@ void vex::flow::ParticleSym::init(
                                          WGPUShaderStage_Fragment | WGPUShaderStage_Vertex)
                                      .addTexView(vis_data.tex_view.view)
                                      .addSampler(vis_data.tex_view.sampler)
+                                     .addStorageBuffer(256, vis_data.visible_buf,
+                                         WGPUShaderStage_Vertex, true)
                                      .createLayoutAndGroup(ctx.device);
 
         vis_data.bgl_layout = layout;
@@ -720,7 +1631,10 @@ void vex::flow::ParticleSym::init(
         vis_data.pipeline_data.depth_stencil_state.depthWriteEnabled = false;
         vis_data.pipeline_data.depth_stencil_state.depthCompare = WGPUCompareFunction_Always;
 
+        vis_data.pipeline_data.primitive_state.topology = WGPUPrimitiveTopology_TriangleStrip;
         vis_data.pipeline_data.setShader(shad);
+        vis_data.pipeline_data.vert_state.constantCount = 1;
+        vis_data.pipeline_data.vert_state.constants = format_consts;
         vis_data.pipeline_data.vert_state.bufferCount = 0;
         vis_data.pipeline_data.vert_state.buffers = nullptr;
         vis_data.pipeline = vis_data.pipeline_data.createPipeline(ctx, layout);
@@ -730,13 +1644,44 @@ void vex::flow::ParticleSym::init(
 
 void vex::flow::ParticleSym::compute(wgfx::CompContext& ctx, CompArgs args)
 {
+    auto& life = life_data;
     defer_
     {
+        if (args.profiler && life.queued_total > 0)
+            args.profiler->endScope(ctx.comp_pass, k_prof_scope_particles);
         wgpuComputePassEncoderEnd(ctx.comp_pass);
         WGPU_REL(ComputePassEncoder, ctx.comp_pass);
+        // one count and one stats copy in flight, they only feed UI
+        if (life.queued_total > 0 && !life.readback_ticket.isValid())
+        {
+            life.readback_ticket = life.readback.request(
+                ctx.encoder, life.control_buf.buffer, 0, sizeof(LiveControl));
+            life.readback_frame = resort_data.frame;
+        }
+        if (life.queued_total > 0 && !stats_data.readback_ticket.isValid())
+        {
+            stats_data.readback_ticket = stats_data.readback.request(
+                ctx.encoder, stats_data.stats_buf.buffer, 0, sizeof(StatsGpu));
+        }
     };
-    if (sym_data.num_particles < 1)
+    if (life.queued_total == 0)
         return;
+    if (args.profiler)
+        args.profiler->beginScope(ctx.comp_pass, k_prof_scope_particles);
+
+    // append batch queued by appendParticles
+    if (life.pending_spawn > 0)
+    {
+        wgpuQueueWriteBuffer(ctx.queue, life.control_buf.buffer,
+            offsetof(LiveControl, spawn_count), (u8*)&life.pending_spawn, sizeof(u32));
+        wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, life.bind_group, 0, nullptr);
+        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, life.append_pipeline);
+        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, life.pending_spawn / 64 + 1, 1, 1);
+        wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, life.commit_bind_group, 0, nullptr);
+        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, life.append_commit_pipeline);
+        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, 1, 1, 1);
+        life.pending_spawn = 0;
+    }
 
     checkLethal(args.settings, "nullptr settings container");
 
@@ -747,78 +1692,176 @@ void vex::flow::ParticleSym::compute(wgfx::CompContext& ctx, CompArgs args)
     auto drag = args.settings->valueOr(opt_part_drag.key_name, 0.05f);
     auto speed_max = args.settings->valueOr(opt_part_speed_max.key_name, 4.00f);
 
-    u32 spatial_subdiv = u32(glm::round(1.0f / rad));
+    u32 spatial_subdiv =
+        glm::clamp(u32(glm::round(1.0f / rad)), 1u, hash_data.max_table_subdiv);
+    // every substep runs the same passes with the same uniforms, all in this command buffer
+    const u32 max_substeps = (u32)args.settings->valueOr(
+        opt_part_max_substeps.key_name, opt_part_max_substeps.default_val);
+    // fastest particle of a few frames ago, move() cruises at twice the base speed
+    const f32 planned_speed =
+        SimClock::plannedSpeed(stats_data.last.max_speed * args.cell_size.x, speed * 2.0f);
+    const u32 substeps = SimClock::substeps(
+        args.dt, planned_speed, rad * args.cell_size.x, args.cell_size.x, max_substeps);
     SimulateUBO vbo{
         .bounds = args.bounds,
         .grid_min = args.grid_min,
         .grid_size = args.grid_size,
         .cell_size = args.cell_size,
-        .num_particles = sym_data.num_particles,
+        .num_particles = life.last_live, // informative, shaders use GPU live count
         .speed_base = speed,
         .radius = rad * args.cell_size.x, // #fixme one constant
         .separation = separation,
         .inertia = inertia,
         .drag = drag,
         .speed_max = speed_max,
-        .delta_time = args.dt,
+        .delta_time = args.dt / f32(substeps),
     };
 
     vbo.flags = 0;
     vbo.spatial_table_size = v2u32{args.bounds.x * spatial_subdiv,
         args.bounds.y * spatial_subdiv}; // #fixme - use radius to calc density
+    vbo.table_cells = vbo.spatial_table_size.x * vbo.spatial_table_size.y;
+    vbo.num_groups = std::max(group_data.count, 1u);
+    std::copy_n(group_data.goals, SimulateUBO::k_max_groups, vbo.group_goals);
+    vbo.wall_subdiv = sym_data.wall_subdiv;
+    sym_data.grid_min = args.grid_min;
+    sym_data.grid_size = args.grid_size;
 
     updateUniform(ctx, hash_data.uniform_buf, vbo);
 
-    const auto work_size = sym_data.num_particles;
+    // particle passes are sized by args written on GPU after append and compaction
+    auto dispatchParticles = [&](WGPUComputePipeline pipeline)
+    {
+        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, pipeline);
+        wgpuComputePassEncoderDispatchWorkgroupsIndirect(
+            ctx.comp_pass, life.indirect_buf.buffer, k_dispatch_args_offset);
+    };
 
     const auto cells_in_table = vbo.spatial_table_size.x * vbo.spatial_table_size.y;
-    // prepare
-    if (experimental)
+    // Morton resort, right after append and before anything caches particle indices
     {
+        auto& resort = resort_data;
+        resort.frame++;
+        const i32 interval = args.settings->valueOr(opt_part_resort_interval.key_name, 0);
+        const f32 max_disorder = args.settings->valueOr(opt_part_resort_disorder.key_name, 0.35f);
+        const u32 since_last = (u32)(resort.frame - resort.last_frame);
+        const bool due = (interval > 0 && since_last >= (u32)interval) ||
+                         (max_disorder > 0 && resort.last_disorder > max_disorder);
+        const u32 side = std::bit_ceil(std::max({args.bounds.x, args.bounds.y, 1u}));
+        const u32 morton_keys = side * side;
+        if (due && morton_keys <= hash_data.max_table_cells)
         {
-            wgpuComputePassEncoderSetPipeline(ctx.comp_pass, hash_data.zero_pipeline);
+            resort.last_frame = resort.frame;
+            resort.last_disorder = 0;
             wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, hash_data.bind_group, 0, nullptr);
-            wgpuComputePassEncoderDispatchWorkgroups(
-                ctx.comp_pass, (cells_in_table / 64) + 1, 1, 1);
-
-            wgpuComputePassEncoderSetPipeline(ctx.comp_pass, hash_data.count_pipeline);
+            hash_data.morton_zero_data.dispatch(
+                ctx.comp_pass, hash_data.morton_zero_pipeline, morton_keys);
+            dispatchParticles(hash_data.morton_count_pipeline);
+            hash_data.morton_scan.record(ctx, morton_keys);
             wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, hash_data.bind_group, 0, nullptr);
-            wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, (work_size / 64) + 1, 1, 1);
+            dispatchParticles(hash_data.morton_scatter_pipeline);
+
+            wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, resort.bind_group, 0, nullptr);
+            dispatchParticles(resort.gather_pipeline);
+            dispatchParticles(resort.copy_pipeline);
         }
-        const u32 num_cubes = vbo.spatial_table_size.y / 4 + 1;
-        const u32 solver_groups = (num_cubes * num_cubes) / (64);
+    }
+    for (u32 step = 0; step < args.steps * substeps; ++step)
+    {
+        // prepare
+        if (experimental)
+        {
+            // counting sort: histogram, exclusive scan into offsets, scatter
+            {
+                wgpuComputePassEncoderSetBindGroup(
+                    ctx.comp_pass, 0, hash_data.bind_group, 0, nullptr);
+                hash_data.zero_pipeline_data.dispatch(
+                    ctx.comp_pass, hash_data.zero_pipeline, cells_in_table);
+
+                dispatchParticles(hash_data.count_pipeline);
+
+                // multi-block scan, sets its own bind group
+                hash_data.cell_scan.record(ctx, cells_in_table);
+                wgpuComputePassEncoderSetBindGroup(
+                    ctx.comp_pass, 0, hash_data.bind_group, 0, nullptr);
 
-        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, sym_data.solve_pipeline);
-        wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, sym_data.bind_group, 0, nullptr);
-        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, solver_groups, 1, 1);
+                dispatchParticles(hash_data.scatter_pipeline);
 
-        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, sym_data.solve_pass2_pipeline);
-        wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, sym_data.bind_group, 0, nullptr);
-        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, solver_groups, 1, 1);
+                hash_data.order_pipeline_data.dispatch(
+                    ctx.comp_pass, hash_data.order_pipeline, cells_in_table);
+                // crowd density for the distance solver of next frame, once per frame
+                if (step == 0)
+                {
+                    hash_data.density_data.dispatch(
+                        ctx.comp_pass, hash_data.density_pipeline, args.bounds.x * args.bounds.y);
+                }
+            }
+            // gather-only, one invocation per particle, no write conflicts so a single pass
+            wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, sym_data.bind_group, 0, nullptr);
+            dispatchParticles(sym_data.solve_pipeline);
+        }
+        else
+        {
+            // solve particle-to-particle collisions
+            wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, sym_data.bind_group, 0, nullptr);
+            dispatchParticles(sym_data.solve_pipeline);
+        }
+        //  solve particle-to-wall & movement, timed on first substep (a scope can't repeat)
+        {
+            const bool timed = args.profiler && step == 0;
+            if (timed)
+                args.profiler->beginScope(ctx.comp_pass, k_prof_scope_move);
+            wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, sym_data.bind_group, 0, nullptr);
+            dispatchParticles(sym_data.move_pipeline);
+            if (timed)
+                args.profiler->endScope(ctx.comp_pass, k_prof_scope_move);
+        }
     }
-    else
+    // crowd stats, before compaction drops particles that arrived this frame
     {
-        u32 num_groups = (work_size / 64) + 1;
-        const auto num_groups_clamped = num_groups > 0 ? num_groups : 1;
-        // solve particle-to-particle collisions
-        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, sym_data.solve_pipeline);
-        wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, sym_data.bind_group, 0, nullptr);
-        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, num_groups, 1, 1);
+        auto& stats = stats_data;
+        wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, stats.bind_group, 0, nullptr);
+        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, stats.begin_pipeline);
+        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, 1, 1, 1);
+        dispatchParticles(stats.particles_pipeline);
+        // density is from the last step that ran, see flowfield_ps_stats.wgsl
+        stats.cells_data.dispatch(
+            ctx.comp_pass, stats.cells_pipeline, args.bounds.x * args.bounds.y);
     }
-    //  solve particle-to-wall & movement
+    // drop arrived particles, every pass early-outs on GPU when nothing arrived this frame.
+    // Scan is split in blocks of the particle dispatch so only the pass over block sums is
+    // serial. Commit rewrites the dispatch args used by cull and next frame
     {
-        u32 num_groups = (work_size / 64) + 1;
-        const auto num_groups_clamped = num_groups > 0 ? num_groups : 1;
-        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, sym_data.move_pipeline);
-        wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, sym_data.bind_group, 0, nullptr);
-        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, num_groups_clamped, 1, 1);
+        wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, life.bind_group, 0, nullptr);
+        dispatchParticles(life.compact_count_pipeline);
+        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, life.compact_scan_pipeline);
+        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, 1, 1, 1);
+        dispatchParticles(life.compact_scatter_pipeline);
+        dispatchParticles(life.compact_copy_pipeline);
+        wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, life.commit_bind_group, 0, nullptr);
+        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, life.compact_commit_pipeline);
+        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, 1, 1, 1);
+    }
+    // instance list for draw
+    {
+        const CullUBO cull_ubo{
+            .camera_vp = args.camera_vp,
+            .margin = args.cell_size,
+            .grid_min = args.grid_min,
+            .grid_size = args.grid_size,
+        };
+        updateUniform(ctx, vis_data.cull_uniform_buf, cull_ubo);
+        wgpuComputePassEncoderSetBindGroup(ctx.comp_pass, 0, vis_data.cull_bind_group, 0, nullptr);
+        wgpuComputePassEncoderSetPipeline(ctx.comp_pass, vis_data.cull_reset_pipeline);
+        wgpuComputePassEncoderDispatchWorkgroups(ctx.comp_pass, 1, 1, 1);
+        dispatchParticles(vis_data.cull_pipeline);
     }
 }
 
 void vex::flow::ParticleSym::draw(
     const wgfx::GpuContext& ctx, const DrawContext& draw_ctx, DrawArgs args)
 {
-    if (sym_data.num_particles < 1)
+    if (life_data.queued_total == 0)
         return;
     const float cell_h = (draw_ctx.grid_half_size / args.bounds.y);
     const float cell_w = cell_h;
@@ -829,6 +1872,7 @@ void vex::flow::ParticleSym::draw(
         .color1 = Color::green(),
         .color2 = Color::red(),
         .size = {cell_w * rad, cell_w * rad, 1, 1},
+        .grid = {sym_data.grid_min, sym_data.grid_size},
     };
     updateUniform(ctx, vis_data.uniform_buf, vbo);
     {
@@ -837,7 +1881,7 @@ void vex::flow::ParticleSym::draw(
         wgpuRenderPassEncoderSetPipeline(rpass_enc, vis_data.pipeline);
         wgpuRenderPassEncoderSetBindGroup(rpass_enc, 0, vis_data.bind_group, 0, 0);
 
-        wgpuRenderPassEncoderDraw(rpass_enc, sym_data.num_particles * 6, 1, 0, 0);
+        wgpuRenderPassEncoderDrawIndirect(rpass_enc, vis_data.draw_args_buf.buffer, 0);
         wgpuRenderPassEncoderPopDebugGroup(rpass_enc);
     }
 }
@@ -849,21 +1893,117 @@ bool vex::flow::ParticleSym::reloadShaders(
         WGPUShaderModule shader = reloadShader(shader_lib, context, hash_data.shader);
         if (shader)
         {
+            WGPU_REL(ComputePipeline, hash_data.zero_pipeline);
+            hash_data.zero_pipeline = hash_data.zero_pipeline_data.createPipeline(
+                context, shader, hash_data.bgl_layout);
+            check_(hash_data.zero_pipeline);
+
             WGPU_REL(ComputePipeline, hash_data.count_pipeline);
             hash_data.count_pipeline = hash_data.count_pipeline_data.createPipeline(
                 context, shader, hash_data.bgl_layout);
             check_(hash_data.count_pipeline);
-        }
 
-        // WGPU_REL(ComputePipeline, hash_data.hash_pipeline);
-        // hash_data.hash_pipeline = hash_data.hash_pipeline_data.createPipeline(
-        //     context, shader, hash_data.bgl_layout);
-        // check_(hash_data.hash_pipeline);
+            WGPU_REL(ComputePipeline, hash_data.scatter_pipeline);
+            hash_data.scatter_pipeline = hash_data.scatter_pipeline_data.createPipeline(
+                context, shader, hash_data.bgl_layout);
+            check_(hash_data.scatter_pipeline);
+
+            WGPU_REL(ComputePipeline, hash_data.order_pipeline);
+            hash_data.order_pipeline = hash_data.order_pipeline_data.createPipeline(
+                context, shader, hash_data.bgl_layout);
+            check_(hash_data.order_pipeline);
 
-        // WGPU_REL(ComputePipeline, hash_data.calc_offsets_pipeline);
-        // hash_data.calc_offsets_pipeline = hash_data.calc_offsets_pipeline_data.createPipeline(
-        //     context, shader, hash_data.bgl_layout);
-        // check_(hash_data.calc_offsets_pipeline);
+            auto recreate = [&](WGPUComputePipeline& pipeline, wgfx::ComputePipeline& data)
+            {
+                WGPU_REL(ComputePipeline, pipeline);
+                pipeline = data.createPipeline(context, shader, hash_data.bgl_layout);
+                check_(pipeline);
+            };
+            recreate(hash_data.morton_zero_pipeline, hash_data.morton_zero_data);
+            recreate(hash_data.morton_count_pipeline, hash_data.morton_count_data);
+            recreate(hash_data.morton_scatter_pipeline, hash_data.morton_scatter_data);
+            recreate(hash_data.density_pipeline, hash_data.density_data);
+        }
+    }
+    {
+        auto& resort = resort_data;
+        WGPUShaderModule shader = reloadShader(shader_lib, context, resort.shader);
+        if (shader)
+        {
+            WGPU_REL(ComputePipeline, resort.gather_pipeline);
+            resort.gather_pipeline =
+                resort.gather_data.createPipeline(context, shader, resort.bgl_layout);
+            check_(resort.gather_pipeline);
+
+            WGPU_REL(ComputePipeline, resort.copy_pipeline);
+            resort.copy_pipeline =
+                resort.copy_data.createPipeline(context, shader, resort.bgl_layout);
+            check_(resort.copy_pipeline);
+        }
+    }
+    {
+        auto& life = life_data;
+        WGPUShaderModule shader = reloadShader(shader_lib, context, life.shader);
+        if (shader)
+        {
+            auto recreate = [&](WGPUComputePipeline& pipeline, wgfx::ComputePipeline& data)
+            {
+                WGPU_REL(ComputePipeline, pipeline);
+                pipeline = data.createPipeline(context, shader, life.bgl_layout);
+                check_(pipeline);
+            };
+            recreate(life.append_pipeline, life.append_data);
+            recreate(life.compact_count_pipeline, life.compact_count_data);
+            recreate(life.compact_scan_pipeline, life.compact_scan_data);
+            recreate(life.compact_scatter_pipeline, life.compact_scatter_data);
+            recreate(life.compact_copy_pipeline, life.compact_copy_data);
+        }
+    }
+    {
+        auto& life = life_data;
+        WGPUShaderModule shader = reloadShader(shader_lib, context, life.commit_shader);
+        if (shader)
+        {
+            auto recreate = [&](WGPUComputePipeline& pipeline, wgfx::ComputePipeline& data)
+            {
+                WGPU_REL(ComputePipeline, pipeline);
+                pipeline = data.createPipeline(context, shader, life.commit_bgl_layout);
+                check_(pipeline);
+            };
+            recreate(life.append_commit_pipeline, life.append_commit_data);
+            recreate(life.compact_commit_pipeline, life.compact_commit_data);
+        }
+    }
+    {
+        WGPUShaderModule shader = reloadShader(shader_lib, context, vis_data.cull_shader);
+        if (shader)
+        {
+            WGPU_REL(ComputePipeline, vis_data.cull_reset_pipeline);
+            vis_data.cull_reset_pipeline = vis_data.cull_reset_data.createPipeline(
+                context, shader, vis_data.cull_bgl_layout);
+            check_(vis_data.cull_reset_pipeline);
+
+            WGPU_REL(ComputePipeline, vis_data.cull_pipeline);
+            vis_data.cull_pipeline =
+                vis_data.cull_data.createPipeline(context, shader, vis_data.cull_bgl_layout);
+            check_(vis_data.cull_pipeline);
+        }
+    }
+    {
+        auto& stats = stats_data;
+        WGPUShaderModule shader = reloadShader(shader_lib, context, stats.shader);
+        if (shader)
+        {
+            auto recreate = [&](WGPUComputePipeline& pipeline, wgfx::ComputePipeline& data)
+            {
+                WGPU_REL(ComputePipeline, pipeline);
+                pipeline = data.createPipeline(context, shader, stats.bgl_layout);
+                check_(pipeline);
+            };
+            recreate(stats.begin_pipeline, stats.begin_data);
+            recreate(stats.particles_pipeline, stats.particles_data);
+            recreate(stats.cells_pipeline, stats.cells_data);
+        }
     }
     {
         WGPUShaderModule shader = reloadShader(shader_lib, context, sym_data.shader);
@@ -878,11 +2018,6 @@ bool vex::flow::ParticleSym::reloadShaders(
             sym_data.solve_pipeline = sym_data.solve_pipeline_data.createPipeline(
                 context, shader, sym_data.bgl_layout);
             check_(sym_data.solve_pipeline);
-
-            WGPU_REL(ComputePipeline, sym_data.solve_pass2_pipeline);
-            sym_data.solve_pass2_pipeline = sym_data.solve_pass2_data.createPipeline(
-                context, shader, sym_data.bgl_layout);
-            check_(sym_data.solve_pass2_pipeline);
         }
     }
     {
@@ -918,6 +2053,42 @@ bool vex::flow::ParticleSym::reloadShaders(
     return true;
 }
 
+void vex::flow::ParticleSym::setWorkgroupSizes(const wgfx::WorkgroupTuning& tuning)
+{
+    // order and density cost follows particles per cell, an empty table can't time them, so
+    // they keep the default size. Zero touches every cell regardless of load
+    hash_data.zero_pipeline_data.workgroup_size =
+        tuning.sizeOr(hash_data.zero_pipeline_data.label);
+    // same kernel over Morton keys
+    hash_data.morton_zero_data.workgroup_size = hash_data.zero_pipeline_data.workgroup_size;
+}
+
+void vex::flow::ParticleSym::tuneWorkgroupSizes(const wgfx::GpuContext& ctx,
+    const TextShaderLib& text_shad_lib, v2u32 bounds, wgfx::WorkgroupTuning& tuning)
+{
+    auto* src = text_shad_lib.shad_src.find(hash_data.shader);
+    if (!checkAlwaysRel(src, "shader not found"))
+        return;
+    WGPUShaderModule shad = shaderFromSrc(ctx.device, src->text.c_str());
+    defer_ { WGPU_REL(ShaderModule, shad); };
+
+    SimulateUBO vbo{};
+    vbo.bounds = bounds;
+    vbo.spatial_table_size = bounds * hash_data.max_table_subdiv;
+    vbo.table_cells = vbo.spatial_table_size.x * vbo.spatial_table_size.y;
+    check_(vbo.table_cells <= hash_data.max_table_cells);
+    updateUniform(ctx, hash_data.uniform_buf, vbo);
+    tuning.tune(ctx, {
+                         .data = &hash_data.zero_pipeline_data,
+                         .shader = shad,
+                         .layout = hash_data.bgl_layout,
+                         .bind_group = hash_data.bind_group,
+                         .items = vbo.table_cells,
+                         .sync_buf = &life_data.control_buf,
+                     });
+    setWorkgroupSizes(tuning);
+}
+
 void vex::flow::ParticleSym::release()
 { //
     SPDLOG_ERROR("#fixme - add release");
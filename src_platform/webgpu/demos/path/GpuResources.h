@@ -4,8 +4,17 @@
 #include <VFramework/VEXBase.h>
 #include <application/Platfrom.h>
 #include <gfx/GfxUtils.h>
+#include <webgpu/render/ComputePrimitives.h>
+#include <webgpu/render/GpuProfiler.h>
 #include <webgpu/render/LayoutManagement.h>
+#include <webgpu/render/ReadbackRing.h>
 #include <webgpu/render/WgpuTypes.h>
+#include <webgpu/render/WorkgroupTuning.h>
+
+#include "ParticleSymCpu.h"
+
+#include <bit>
+#include <cstddef>
 
 namespace vex::flow
 {
@@ -89,6 +98,65 @@ namespace vex::flow
         .flags = SettingsContainer::Flags::k_visible_in_ui,
     };
 
+    static inline const auto opt_part_packed = SettingsContainer::EntryDesc<bool>{
+        .key_name = "pf.PtSym_PackedParticles",
+        .info = "Store particles in 8 bytes instead of 16 (quantized position, half precision "
+                "velocity). Applied on restart.",
+        .default_val = false,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
+
+    static inline const auto opt_part_flow_texture = SettingsContainer::EntryDesc<bool>{
+        .key_name = "pf.PtSym_FlowTexture",
+        .info = "Steer particles by bilinear samples of the flow field (filtered texture) instead "
+                "of the direction of their cell. Applied on restart.",
+        .default_val = false,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
+
+    static inline const auto opt_part_resort_interval = SettingsContainer::EntryDesc<i32>{
+        .key_name = "pf.PtSym_ResortInterval",
+        .info = "Reorder particle memory by position every N frames. 0 disables.",
+        .default_val = 0,
+        .min = 0,
+        .max = 600,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
+    static inline const auto opt_part_resort_disorder = SettingsContainer::EntryDesc<float>{
+        .key_name = "pf.PtSym_ResortDisorder",
+        .info = "Reorder particle memory by position once this fraction of particles is far from "
+                "its memory neighbour. 0 disables.",
+        .default_val = 0.35f,
+        .min = 0.00f,
+        .max = 1.00f,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
+
+    static inline const auto opt_part_capacity = SettingsContainer::EntryDesc<i32>{
+        .key_name = "pf.PtSym_Capacity",
+        .info = "Max number of simulated particles, clamped to device limits. Applied on restart.",
+        .default_val = 200'000,
+        .min = 1'000,
+        .max = 4'000'000,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
+    static inline const auto opt_part_sim_rate = SettingsContainer::EntryDesc<i32>{
+        .key_name = "pf.PtSym_SimRate",
+        .info = "Fixed simulation steps per second, independent of frame rate.",
+        .default_val = 120,
+        .min = 30,
+        .max = 480,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
+    static inline const auto opt_part_max_substeps = SettingsContainer::EntryDesc<i32>{
+        .key_name = "pf.PtSym_MaxSubsteps",
+        .info = "Max substeps of one simulation step, fast particles need more to not pass walls.",
+        .default_val = 8,
+        .min = 1,
+        .max = 32,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
+
     struct DrawContext
     {
         SettingsContainer* settings = nullptr;
@@ -184,12 +252,71 @@ namespace vex::flow
         v2f quad_size = {1, 1};
         v2u32 buffer_dimensions;
     };
+    // Rows of a grid buffer changed since last upload, one bit per row. Uploads walk it as
+    // contiguous spans so a steady state costs nothing and local edits cost a few rows.
+    struct DirtyRows
+    {
+        vex::Buffer<u64> bits;
+        u32 num_rows = 0;
+
+        // resets tracking to 'rows' rows, all of them dirty
+        void resize(u32 rows)
+        {
+            num_rows = rows;
+            bits.len = 0;
+            bits.addZeroed((rows + 63) / 64);
+            markRange(0, rows);
+        }
+        FORCE_INLINE void mark(u32 row) { bits[row / 64] |= 1ull << (row % 64); }
+        void markRange(u32 first, u32 end)
+        {
+            for (u32 row = first; row < end && row < num_rows; ++row)
+                mark(row);
+        }
+        void markAll() { markRange(0, num_rows); }
+        bool any() const
+        {
+            for (u64 word : bits)
+                if (word)
+                    return true;
+            return false;
+        }
+        void clear()
+        {
+            for (u64& word : bits)
+                word = 0;
+        }
+        // fn(first_row, row_count) for every maximal run of dirty rows
+        template <typename Fn>
+        void forEachSpan(Fn&& fn) const
+        {
+            u32 row = 0;
+            while (row < num_rows)
+            {
+                const u64 word = bits[row / 64] >> (row % 64);
+                if (word == 0)
+                { // skip to next word
+                    row = (row / 64 + 1) * 64;
+                    continue;
+                }
+                row += (u32)std::countr_zero(word);
+                u32 end = row;
+                while (end < num_rows && (bits[end / 64] & (1ull << (end % 64))))
+                    ++end;
+                fn(row, end - row);
+                row = end;
+            }
+        }
+    };
+
     struct HeatmapDynamicData
     {
         ROSpan<u32> buffer;
         v2u32 bounds;
         v4f color1;
         v4f color2;
+        // when set only dirty rows of 'buffer' are uploaded and tracking is cleared
+        DirtyRows* dirty = nullptr;
     };
     struct ColorQuad
     {
@@ -259,53 +386,265 @@ namespace vex::flow
             // && vtx_buf.isValid() && idx_buf.isValid() ;
         }
     };
+    // flow field texture sampled with filtering, xy of every texel is a direction. Linear clamp
+    // sampler, 'as_array' views it as 2D array (one layer per agent group)
+    static constexpr WGPUTextureFormat k_flow_tex_format = WGPUTextureFormat_RGBA16Float;
+    wgfx::TextureView createFlowTexture(WGPUDevice device, const char* label, v2u32 size,
+        u32 layers, WGPUTextureUsageFlags usage, bool as_array = false);
+
     struct ComputeArgs
     {
         v2u32 map_size{0, 0};
         u32 flags = 0;
         u32 flags2 = 0;
+        u32 smooth_radius = 0;
+        wgfx::GpuProfiler* profiler = nullptr;
     };
     struct ComputeFields
     {
+        static constexpr u32 k_conv_tile = 16;        // side of flow direction tile, conv_tile
+        static constexpr u32 k_tex_tile = 8;          // workgroup side of cs_to_texture
+        static constexpr i32 k_max_smooth_radius = 8; // halo size of smoothing tile
+        static constexpr u32 k_flag_smooth = 2;
+        static constexpr u32 k_prof_scope_smooth = 0;
         struct UBO
         {
             v2u32 size;
             u32 flags = 0;
-            u32 dummy = 0;
+            u32 smooth_radius = 0;
         };
         const char* cf_shader_file = "content/shaders/wgsl/flow/flowfield_conv.wgsl";
+        const char* tex_shader_file = "content/shaders/wgsl/flow/flowfield_conv_tex.wgsl";
 
         wgfx::GpuBuffer uniform_buf;
         wgfx::GpuBuffer output_buf;
-        wgfx::GpuBuffer staging_buf;
+        wgfx::GpuBuffer smooth_tmp_buf; // output of horizontal smoothing
         WGPUBindGroup bind_group;
 
+        // CPU copy of output_buf for CPU side agents, refreshed only while requested
+        wgfx::ReadbackRing readback;
+        wgfx::ReadbackRing::Ticket readback_ticket;
+        vex::Buffer<v2f> cpu_flow;
+        bool readback_requested = false;
+
         wgfx::ComputePipeline pipeline_data;
         WGPUBindGroupLayout bgl_layout;
         WGPUComputePipeline pipeline;
 
+        // both smoothing directions share entry point, axis is picked by override constant
+        static inline const WGPUConstantEntry k_smooth_h_consts[] = {
+            {.key = "smooth_vertical", .value = 0.0},
+        };
+        static inline const WGPUConstantEntry k_smooth_v_consts[] = {
+            {.key = "smooth_vertical", .value = 1.0},
+        };
+        wgfx::ComputePipeline smooth_h_data{
+            .label = "flow smooth h",
+            .descriptor =
+                {
+                    .entryPoint = "cs_postprocess_main",
+                    .constantCount = 1,
+                    .constants = k_smooth_h_consts,
+                },
+        };
+        wgfx::ComputePipeline smooth_v_data{
+            .label = "flow smooth v",
+            .descriptor =
+                {
+                    .entryPoint = "cs_postprocess_main",
+                    .constantCount = 1,
+                    .constants = k_smooth_v_consts,
+                },
+        };
+        WGPUComputePipeline smooth_h_pipeline = nullptr;
+        WGPUComputePipeline smooth_v_pipeline = nullptr;
+
+        // optional copy of output_buf in k_flow_tex_format, refreshed by every compute
+        wgfx::TextureView flow_tex{};
+        WGPUBindGroup tex_bind_group = nullptr;
+        WGPUBindGroupLayout tex_bgl_layout = nullptr;
+        wgfx::ComputePipeline to_tex_data{
+            .label = "flow to texture",
+            .descriptor = {.entryPoint = "cs_to_texture"},
+        };
+        WGPUComputePipeline to_tex_pipeline = nullptr;
+
+        // 'texture_output' also keeps flow_tex, for particles sampling the field bilinearly
         void init(const wgfx::GpuContext& ctx, const TextShaderLib& text_shad_lib,
-            const char* in_shader_file, wgfx::GpuBuffer& map_data_buf, v2u32 size);
+            const char* in_shader_file, wgfx::GpuBuffer& map_data_buf, v2u32 size,
+            bool texture_output = false);
 
         void compute(wgfx::CompContext& ctx, const ComputeArgs& args);
 
         bool reloadShaders(vex::TextShaderLib& shader_lib, const wgfx::GpuContext& context);
 
+        // asks for a fresh CPU copy of flow field, copy is recorded by next compute()
+        void requestReadback() { readback_requested = true; }
+        // call after compute command buffer was submitted, picks up finished copies
+        void pollReadback();
+        // latest CPU copy, may be a few frames old and empty before first readback finishes
+        ROSpan<v2f> flowOnCpu() const { return cpu_flow.constSpan(); }
+
         void release()
         {
             WGPU_REL(BindGroup, bind_group);
             WGPU_REL(BindGroupLayout, bgl_layout);
             WGPU_REL(ComputePipeline, pipeline);
+            WGPU_REL(ComputePipeline, smooth_h_pipeline);
+            WGPU_REL(ComputePipeline, smooth_v_pipeline);
+            WGPU_REL(BindGroup, tex_bind_group);
+            WGPU_REL(BindGroupLayout, tex_bgl_layout);
+            WGPU_REL(ComputePipeline, to_tex_pipeline);
+            flow_tex.release();
             // vtx_buf.release();
             uniform_buf.release();
             output_buf.release();
-            staging_buf.release();
+            smooth_tmp_buf.release();
+            readback.release();
         }
         bool isValid() const
         {
             return uniform_buf.isValid() && output_buf.isValid() && bind_group && pipeline;
         }
     };
+    // Distance field solved on device (flowfield_dist.wgsl) written straight into ProcessedData
+    // layout, so BFS result doesn't need to be uploaded every frame. Solver state persists, after
+    // restart field keeps converging by 'iterations' relaxation steps per compute call and a
+    // converged field only costs empty indirect dispatches.
+    struct GpuDistanceSolver
+    {
+        static constexpr u32 k_tile_size = 8;
+        static constexpr u32 k_frontier_row = 256; // keep in sync with flowfield_dist_args
+        struct UBO
+        {
+            v2u32 size;
+            v2u32 tiles;
+            v2u32 goal;
+            u32 flags = 0;
+            f32 density_weight = 0;
+            f32 density_comfort = 0;
+            u32 max_extra_cost = 0;
+            v2u32 padding{};
+        };
+        struct Control
+        {
+            u32 iteration = 0;
+            u32 frontier_len = 0;
+            u32 last_frontier_len = 0;
+            u32 dummy = 0;
+        };
+        const char* shader_file = "content/shaders/wgsl/flow/flowfield_dist.wgsl";
+        // cs_write_args, writes indirect_buf from its own bind group
+        const char* args_shader_file = "content/shaders/wgsl/flow/flowfield_dist_args.wgsl";
+
+        wgfx::GpuBuffer uniform_buf;
+        wgfx::GpuBuffer open_buf;
+        wgfx::GpuBuffer dist_buf;
+        wgfx::GpuBuffer stamp_buf;
+        wgfx::GpuBuffer frontier_buf;
+        wgfx::GpuBuffer control_buf;
+        wgfx::GpuBuffer indirect_buf;
+        // v4f per cell, written by ParticleSym (see InitArgs::density_buf), read as crowd cost
+        wgfx::GpuBuffer density_buf;
+        WGPUBindGroup bind_group = nullptr;
+        WGPUBindGroupLayout bgl_layout = nullptr;
+        // never set while cs_relax dispatches from indirect_buf
+        WGPUBindGroup args_bind_group = nullptr;
+        WGPUBindGroupLayout args_bgl_layout = nullptr;
+
+        wgfx::ComputePipeline init_pipeline_data{
+            .label = "dist init",
+            .descriptor = {.entryPoint = "cs_init"},
+            .workgroup_size = wgfx::WorkgroupTuning::k_default_size,
+        };
+        wgfx::ComputePipeline frontier_pipeline_data{
+            .label = "dist frontier",
+            .descriptor = {.entryPoint = "cs_build_frontier"},
+            .workgroup_size = wgfx::WorkgroupTuning::k_default_size,
+        };
+        wgfx::ComputePipeline args_pipeline_data{
+            .label = "dist args",
+            .descriptor = {.entryPoint = "cs_write_args"},
+        };
+        wgfx::ComputePipeline relax_pipeline_data{
+            .label = "dist relax",
+            .descriptor = {.entryPoint = "cs_relax"},
+        };
+        wgfx::ComputePipeline finalize_pipeline_data{
+            .label = "dist finalize",
+            .descriptor = {.entryPoint = "cs_finalize"},
+            .workgroup_size = wgfx::WorkgroupTuning::k_default_size,
+        };
+        wgfx::ComputePipeline density_pipeline_data{
+            .label = "dist density",
+            .descriptor = {.entryPoint = "cs_apply_density"},
+            .workgroup_size = wgfx::WorkgroupTuning::k_default_size,
+        };
+        WGPUComputePipeline init_pipeline = nullptr;
+        WGPUComputePipeline frontier_pipeline = nullptr;
+        WGPUComputePipeline args_pipeline = nullptr;
+        WGPUComputePipeline relax_pipeline = nullptr;
+        WGPUComputePipeline finalize_pipeline = nullptr;
+        WGPUComputePipeline density_pipeline = nullptr;
+
+        v2u32 size{0, 0};
+        v2u32 tiles{0, 0};
+        bool crowd_applied = false; // costs hold crowd terms, cleared once weight drops to 0
+
+        // 'out_cells_buf' receives distances in ProcessedData layout
+        void init(const wgfx::GpuContext& ctx, const TextShaderLib& text_shad_lib,
+            const char* in_shader_file, wgfx::GpuBuffer& out_cells_buf, v2u32 size);
+        // uploads walkable mask, non zero == open. Needs restart afterwards
+        void setMap(const wgfx::GpuContext& ctx, ROSpan<u8> source);
+
+        struct SolveArgs
+        {
+            v2u32 goal{0, 0};
+            bool allow_diagonal = true;
+            bool restart = false;
+            u32 iterations = 32;
+            CrowdCost crowd{}; // zero weight ignores density_buf
+        };
+        // records into ctx.comp_pass, pass is left open
+        void compute(wgfx::CompContext& ctx, const SolveArgs& args);
+        // number of tiles relaxed by last recorded iteration, 0 => converged. Stalls, bench only
+        u32 readLastFrontierBlocking(const wgfx::GpuContext& ctx);
+
+        bool reloadShaders(vex::TextShaderLib& shader_lib, const wgfx::GpuContext& context);
+
+        // sizes of per cell and per tile passes, call before init or reloadShaders
+        void setWorkgroupSizes(const wgfx::WorkgroupTuning& tuning);
+        // times them on this solver, needs init and setMap. Stalls, clobbers solver state
+        void tuneWorkgroupSizes(const wgfx::GpuContext& ctx, const TextShaderLib& text_shad_lib,
+            wgfx::WorkgroupTuning& tuning);
+
+        void release()
+        {
+            WGPU_REL(BindGroup, bind_group);
+            WGPU_REL(BindGroupLayout, bgl_layout);
+            WGPU_REL(BindGroup, args_bind_group);
+            WGPU_REL(BindGroupLayout, args_bgl_layout);
+            WGPU_REL(ComputePipeline, init_pipeline);
+            WGPU_REL(ComputePipeline, frontier_pipeline);
+            WGPU_REL(ComputePipeline, args_pipeline);
+            WGPU_REL(ComputePipeline, relax_pipeline);
+            WGPU_REL(ComputePipeline, finalize_pipeline);
+            WGPU_REL(ComputePipeline, density_pipeline);
+            uniform_buf.release();
+            open_buf.release();
+            dist_buf.release();
+            stamp_buf.release();
+            frontier_buf.release();
+            control_buf.release();
+            indirect_buf.release();
+            density_buf.release();
+        }
+        bool isValid() const
+        {
+            return bind_group && args_bind_group && init_pipeline && args_pipeline &&
+                   relax_pipeline && finalize_pipeline && density_pipeline;
+        }
+    };
     struct OverlayData
     {
         v2u32 bounds;
@@ -339,62 +678,50 @@ namespace vex::flow
     // #todo : select solve pipeline based on part cnt
     struct ParticleSym
     {
-        static constexpr u32 spatial_table_depth = 4;
+        // spatial cells per map cell along one axis is 1 / radius, smallest radius sets the cap
+        static constexpr u32 k_max_table_subdiv = 8;
+        // one invocation per particle or table cell, wg size 64, default dispatch limit
+        static constexpr u32 k_max_dispatch_items = 65'535 * 64;
         static constexpr bool experimental = true;         // enable spatial experimental stuff
         static constexpr float default_rel_radius = 0.25f; // relative to cell size
                                                            // static constexpr
-        struct Particle
-        {
-            v2f pos;
-            v2f vel;
-        };
+        static constexpr u32 k_prof_scope_particles = 1;
+        static constexpr u32 k_prof_scope_move = 2;
+        using Particle = flow::Particle;
+        using PackedParticle = flow::PackedParticle;
+        using SimulateUBO = flow::SimulateUBO;
         struct VisualUBO
         {
             mtx4 camera_vp;
             v4f color1;
             v4f color2;
             v4f size;
+            v4f grid; // grid_min, grid_size - unpacks positions of packed particles
             u32 flags;
             u32 padding[4];
         };
-        struct SimulateUBO
-        {
-            v2u32 spatial_table_size;
-            v2u32 bounds{};
-            v2f grid_min{};
-            v2f grid_size{};
-            v2f cell_size{};
-            u32 num_particles = 0;
-            u32 table_depth = spatial_table_depth;
-
-            f32 speed_base = 1.25f;
-            f32 radius = 0.25;
-
-            f32 separation = 0.2f;
-            f32 inertia = 1.2f;
-
-            f32 drag = 0.05f;
-            f32 speed_max = 8.0f;
-
-            f32 delta_time = 0.01f;
-            u32 flags = 0;
-            u32 padding[4];
-        };
         struct
         {
             const char* shader = nullptr;
             wgfx::GpuBuffer uniform_buf;
             wgfx::GpuBuffer particle_data_buf;
-            wgfx::GpuBuffer spatial_table;
-            wgfx::GpuBuffer counters;
+            wgfx::GpuBuffer cell_count;     // u32 per spatial cell, histogram of cs_count
+            wgfx::GpuBuffer cell_start;     // u32 per spatial cell + 1, scan of cell_count
+            wgfx::GpuBuffer sorted_indices; // u32 per particle, grouped by spatial cell
+            wgfx::GpuBuffer slots;          // v2u32 per particle, (cell, rank in cell)
+            wgfx::GpuBuffer sorted_pos;     // v2f per particle, positions in sorted order
+            u32 max_table_cells = 0;
+            u32 max_table_subdiv = k_max_table_subdiv; // lowered when table wouldn't fit binding
             WGPUBindGroup bind_group;
             WGPUBindGroupLayout bgl_layout;
 
             wgfx::ComputePipeline zero_pipeline_data{
+                .label = "hash zero",
                 .descriptor =
                     {
                         .entryPoint = "cs_zero",
                     },
+                .workgroup_size = wgfx::WorkgroupTuning::k_default_size,
             };
             WGPUComputePipeline zero_pipeline;
             wgfx::ComputePipeline count_pipeline_data{
@@ -404,6 +731,45 @@ namespace vex::flow
                     },
             };
             WGPUComputePipeline count_pipeline;
+            // cell_count -> cell_start, Morton keys get their own plan for their own count
+            wgfx::compute::ScanPlan cell_scan;
+            wgfx::compute::ScanPlan morton_scan;
+            wgfx::ComputePipeline scatter_pipeline_data{
+                .descriptor =
+                    {
+                        .entryPoint = "cs_scatter",
+                    },
+            };
+            WGPUComputePipeline scatter_pipeline;
+            wgfx::ComputePipeline order_pipeline_data{
+                .label = "hash order",
+                .descriptor =
+                    {
+                        .entryPoint = "cs_order",
+                    },
+                .workgroup_size = wgfx::WorkgroupTuning::k_default_size,
+            };
+            WGPUComputePipeline order_pipeline;
+
+            // same passes keyed by Morton code of map cell, feed the resort
+            wgfx::ComputePipeline morton_zero_data{
+                .label = "hash morton zero",
+                .descriptor = {.entryPoint = "cs_zero"},
+                .workgroup_size = wgfx::WorkgroupTuning::k_default_size,
+            };
+            wgfx::ComputePipeline morton_count_data{.descriptor = {.entryPoint = "cs_count"}};
+            wgfx::ComputePipeline morton_scatter_data{.descriptor = {.entryPoint = "cs_scatter"}};
+            WGPUComputePipeline morton_zero_pipeline;
+            WGPUComputePipeline morton_count_pipeline;
+            WGPUComputePipeline morton_scatter_pipeline;
+            // crowd density splat into map cells, reads the table built by the passes above
+            wgfx::ComputePipeline density_data{
+                .label = "hash density",
+                .descriptor = {.entryPoint = "cs_density"},
+                .workgroup_size = wgfx::WorkgroupTuning::k_default_size,
+            };
+            WGPUComputePipeline density_pipeline;
+            wgfx::GpuBuffer* density_buf = nullptr;
 
             u32 num_particles = 0;
         } hash_data;
@@ -419,20 +785,189 @@ namespace vex::flow
                         .entryPoint = experimental ? "cs_solve" : "cs_solve_few",
                     },
             };
-            wgfx::ComputePipeline solve_pass2_data{
-                .descriptor =
-                    {
-                        .entryPoint = "cs_solve_second_pass",
-                    },
-            };
             WGPUBindGroupLayout bgl_layout;
             WGPUComputePipeline solve_pipeline;
-            WGPUComputePipeline solve_pass2_pipeline;
             WGPUComputePipeline move_pipeline;
 
-            u32 num_particles = 0;
+            u32 max_particles = 0;
+            wgfx::GpuBuffer flow_layers_buf; // v2f per cell, one layer per agent group
+            u64 flow_layer_bytes = 0;
+            // copy of flow layers that move pass samples bilinearly, 1x1 unless flow_texture
+            bool flow_texture = false;
+            wgfx::TextureView flow_layers_tex{};
+            u32 max_groups = SimulateUBO::k_max_groups; // layers that fit a binding
+            wgfx::GpuBuffer walls_buf; // WallField::Sample per sample
+            u32 wall_subdiv = WallField::k_max_subdiv;
+            // rect packed positions are relative to, last one passed to compute
+            v2f grid_min{};
+            v2f grid_size{1, 1};
         } sym_data;
 
+        // agent groups, every group follows its own flow layer and despawns at its own goal.
+        // Group of a particle lives in its alive flag (group + 1), so changing goals or flow
+        // fields never touches particles
+        struct
+        {
+            SimulateUBO::GroupGoal goals[SimulateUBO::k_max_groups];
+            u32 count = 0;
+        } group_data;
+
+        // storage format of particle_data_buf and compact_tmp_buf, fixed at init. Every shader
+        // touching them gets it as 'packed_particles' override constant
+        ParticleFormat format = ParticleFormat::k_f32;
+        WGPUConstantEntry format_consts[1] = {{.key = "packed_particles", .value = 0.0}};
+        WGPUConstantEntry move_consts[2] = {
+            {.key = "packed_particles", .value = 0.0},
+            {.key = "flow_texture", .value = 0.0},
+        };
+        WGPUConstantEntry morton_consts[2] = {
+            {.key = "packed_particles", .value = 0.0},
+            {.key = "sort_key_morton", .value = 1.0},
+        };
+
+        // live set bookkeeping, see flowfield_ps_life.wgsl. Live count is only known on GPU,
+        // every particle dispatch and the draw are indirect with args written next to it. CPU
+        // gets a few frames old copy for UI only
+        struct LiveControl
+        {
+            u32 live = 0;
+            u32 spawn_count = 0;
+            u32 capacity = 0;
+            u32 arrived = 0;
+            u32 disorder = 0; // written by spatial hash, see resort_data
+            u32 padding[3]{};
+        };
+        // Dispatch and draw args live in separate buffers, each writable only in a bind group
+        // that isn't set while something dispatches from it
+        struct IndirectArgs
+        {
+            u32 dispatch[3] = {0, 1, 1}; // one invocation per live particle, wg size 64
+            u32 padding = 0;
+        };
+        struct DrawArgs
+        {
+            u32 draw[4] = {4, 0, 0, 0}; // strip quad, visible count written by cs_cull
+        };
+        static constexpr u64 k_dispatch_args_offset = offsetof(IndirectArgs, dispatch);
+        struct
+        {
+            const char* shader = nullptr;
+            wgfx::GpuBuffer control_buf;
+            wgfx::GpuBuffer alive_buf;
+            wgfx::GpuBuffer spawn_buf;
+            wgfx::GpuBuffer spawn_groups_buf; // u32 group per particle of spawn_buf
+            wgfx::GpuBuffer compact_tmp_buf;  // particles, then u32 alive flag per particle
+            wgfx::GpuBuffer offsets_buf;
+            wgfx::GpuBuffer indirect_buf; // IndirectArgs, only commit_bind_group writes it
+            WGPUBindGroup bind_group;
+            WGPUBindGroupLayout bgl_layout;
+            // control, offsets and indirect_buf for the commits, see flowfield_ps_commit.wgsl
+            const char* commit_shader = nullptr;
+            WGPUBindGroup commit_bind_group;
+            WGPUBindGroupLayout commit_bgl_layout;
+
+            wgfx::ComputePipeline append_data{.descriptor = {.entryPoint = "cs_append"}};
+            wgfx::ComputePipeline append_commit_data{
+                .descriptor = {.entryPoint = "cs_append_commit"}};
+            wgfx::ComputePipeline compact_count_data{
+                .descriptor = {.entryPoint = "cs_compact_count"}};
+            wgfx::ComputePipeline compact_scan_data{
+                .descriptor = {.entryPoint = "cs_compact_scan"}};
+            wgfx::ComputePipeline compact_scatter_data{
+                .descriptor = {.entryPoint = "cs_compact_scatter"}};
+            wgfx::ComputePipeline compact_copy_data{
+                .descriptor = {.entryPoint = "cs_compact_copy"}};
+            wgfx::ComputePipeline compact_commit_data{
+                .descriptor = {.entryPoint = "cs_compact_commit"}};
+            WGPUComputePipeline append_pipeline;
+            WGPUComputePipeline append_commit_pipeline;
+            WGPUComputePipeline compact_count_pipeline;
+            WGPUComputePipeline compact_scan_pipeline;
+            WGPUComputePipeline compact_scatter_pipeline;
+            WGPUComputePipeline compact_copy_pipeline;
+            WGPUComputePipeline compact_commit_pipeline;
+
+            u32 max_spawn_batch = 0;
+            u32 pending_spawn = 0; // uploaded to spawn_buf this frame, appended by next compute
+
+            wgfx::ReadbackRing readback;
+            wgfx::ReadbackRing::Ticket readback_ticket;
+            u64 readback_frame = 0;
+            u32 last_live = 0;
+            u64 queued_total = 0; // particles ever queued, nothing to simulate until first spawn
+        } life_data;
+
+        // Particles drift apart in memory while moving, every so often they are put back into
+        // Morton order of their map cell (see flowfield_ps_resort.wgsl). Triggered every N frames
+        // or when too many buffer neighbours are far apart in the table (disorder)
+        struct
+        {
+            const char* shader = nullptr;
+            WGPUBindGroup bind_group;
+            WGPUBindGroupLayout bgl_layout;
+            wgfx::ComputePipeline gather_data{.descriptor = {.entryPoint = "cs_resort_gather"}};
+            wgfx::ComputePipeline copy_data{.descriptor = {.entryPoint = "cs_resort_copy"}};
+            WGPUComputePipeline gather_pipeline;
+            WGPUComputePipeline copy_pipeline;
+
+            u64 frame = 0;
+            u64 last_frame = 0; // frame the last resort ran in
+            f32 last_disorder = 0; // from a readback requested after last resort
+        } resort_data;
+
+        struct CrowdStats
+        {
+            u32 arrived = 0; // since init or restore
+            u32 moving = 0;  // live particles that haven't arrived
+            f32 mean_speed = 0; // cells per second
+            f32 max_speed = 0;  // fastest live particle, cells per second
+            u32 max_density = 0; // particles in the most crowded map cell, as of last step
+            u32 stuck = 0;       // moving slower than a tenth of base speed
+        };
+        // crowd metrics reduced on GPU every frame, see flowfield_ps_stats.wgsl. Only the
+        // reduced struct is read back
+        struct StatsGpu
+        {
+            u32 arrived_total = 0;
+            u32 moving = 0;
+            u32 speed_sum_lo = 0; // k_stats_speed_scale units, 64-bit sum over two words
+            u32 speed_sum_hi = 0;
+            u32 max_density = 0;
+            u32 stuck = 0;
+            u32 max_speed = 0; // k_stats_speed_scale units
+            u32 padding = 0;
+        };
+        static constexpr f64 k_stats_speed_scale = 256.0;
+        struct
+        {
+            const char* shader = nullptr;
+            wgfx::GpuBuffer stats_buf; // StatsGpu
+            WGPUBindGroup bind_group;
+            WGPUBindGroupLayout bgl_layout;
+            wgfx::ComputePipeline begin_data{.descriptor = {.entryPoint = "cs_stats_begin"}};
+            wgfx::ComputePipeline particles_data{
+                .descriptor = {.entryPoint = "cs_stats_particles"}};
+            wgfx::ComputePipeline cells_data{
+                .descriptor = {.entryPoint = "cs_stats_cells"},
+                .workgroup_size = wgfx::WorkgroupTuning::k_default_size,
+            };
+            WGPUComputePipeline begin_pipeline;
+            WGPUComputePipeline particles_pipeline;
+            WGPUComputePipeline cells_pipeline;
+
+            wgfx::ReadbackRing readback;
+            wgfx::ReadbackRing::Ticket readback_ticket;
+            CrowdStats last;
+        } stats_data;
+
+        struct CullUBO
+        {
+            mtx4 camera_vp;
+            v2f margin;
+            v2f grid_min;
+            v2f grid_size;
+            v2f padding;
+        };
         struct
         {
             const char* shader = nullptr;
@@ -443,6 +978,18 @@ namespace vex::flow
             wgfx::SimplePipeline<wgfx::EmptyVertex> pipeline_data;
             WGPUBindGroupLayout bgl_layout;
             WGPURenderPipeline pipeline;
+
+            // instances are particles inside camera rect, compacted by cs_cull
+            const char* cull_shader = nullptr;
+            wgfx::GpuBuffer cull_uniform_buf;
+            wgfx::GpuBuffer visible_buf; // u32 particle index per instance
+            wgfx::GpuBuffer draw_args_buf; // DrawArgs
+            WGPUBindGroup cull_bind_group;
+            WGPUBindGroupLayout cull_bgl_layout;
+            wgfx::ComputePipeline cull_reset_data{.descriptor = {.entryPoint = "cs_cull_reset"}};
+            wgfx::ComputePipeline cull_data{.descriptor = {.entryPoint = "cs_cull"}};
+            WGPUComputePipeline cull_reset_pipeline;
+            WGPUComputePipeline cull_pipeline;
         } vis_data;
 
         struct InitArgs
@@ -450,14 +997,61 @@ namespace vex::flow
             const char* shader_hash = "content/shaders/wgsl/flow/flowfield_hash.wgsl";
             const char* shader_compute = "content/shaders/wgsl/flow/flowfield_ps_sym.wgsl";
             const char* shader_visual = "content/shaders/wgsl/flow/flowfield_ps_quad_vf.wgsl";
+            const char* shader_life = "content/shaders/wgsl/flow/flowfield_ps_life.wgsl";
+            const char* shader_commit = "content/shaders/wgsl/flow/flowfield_ps_commit.wgsl";
+            const char* shader_cull = "content/shaders/wgsl/flow/flowfield_ps_cull.wgsl";
+            const char* shader_resort = "content/shaders/wgsl/flow/flowfield_ps_resort.wgsl";
+            const char* shader_stats = "content/shaders/wgsl/flow/flowfield_ps_stats.wgsl";
             const char* particle_texture = "content/sprites/flow/particle.png";
-            wgfx::GpuBuffer* flow_v2f_buf = nullptr;
-            wgfx::GpuBuffer* cells_buf = nullptr;
-            u32 max_particles = 200'000;
+            const wgfx::compute::Primitives* prims = nullptr; // scans of the spatial hash
+            const WallField* walls = nullptr;
+            wgfx::GpuBuffer* clearance_buf = nullptr; // f32 per cell, distance to wall in cells
+            // v4f per cell, receives crowd density every frame (GpuDistanceSolver::density_buf)
+            wgfx::GpuBuffer* density_buf = nullptr;
+            u32 max_particles = 200'000; // clamped to what fits into max_binding_size
+            u32 max_spawn_batch = 32'768;
+            u64 max_binding_size = 128ull << 20; // device maxStorageBufferBindingSize
             v2u32 bounds{};
+            ParticleFormat format = ParticleFormat::k_f32;
+            // move pass samples flow layers from a filterable texture instead of the buffer,
+            // flow must then come with a texture in updateGroupFlow
+            bool flow_texture = false;
         };
 
-        void spawnForSymulation(const wgfx::GpuContext& ctx, ROSpan<Particle> parts);
+        // queues parts to be appended after the live set on next compute, returns how many fit
+        // into the spawn batch of this frame, 0 for a group that doesn't exist. GPU silently
+        // drops whatever doesn't fit into capacity. Spawned particles are always full
+        // precision, cs_append converts them to storage format
+        u32 appendParticles(const wgfx::GpuContext& ctx, ROSpan<Particle> parts, u32 group = 0);
+
+        // returns id of a new group heading to 'goal', ~0u when all groups are taken. Its flow
+        // layer is zero until updateGroupFlow
+        u32 createGroup(v2u32 goal);
+        void retargetGroup(u32 group, v2u32 goal);
+        // forgets all groups, particles of groups past the new count follow the last group
+        void resetGroups() { group_data.count = 0; }
+        u32 numGroups() const { return group_data.count; }
+        v2u32 groupGoal(u32 group) const { return group_data.goals[group].cell; }
+        // copies flow field ('bounds' v2f) into layer of group, records into encoder outside of
+        // a pass. Layers of other groups are kept, they are the field cache of idle groups.
+        // 'flow_tex' (ComputeFields::flow_tex) is required with InitArgs::flow_texture
+        void updateGroupFlow(WGPUCommandEncoder encoder, u32 group, const wgfx::GpuBuffer& flow,
+            const wgfx::TextureView* flow_tex = nullptr);
+        // exact count from GPU, a few frames old
+        u32 liveParticles() const { return life_data.last_live; }
+        // a few frames old like liveParticles, zeros until the first readback arrives
+        const CrowdStats& crowdStats() const { return stats_data.last; }
+        u32 capacity() const { return sym_data.max_particles; }
+        // call after submitting command buffer passed to compute
+        void pollReadback();
+        // live set in full precision with group of every particle, plus flow layers of all
+        // groups, as of last submitted compute. Stalls, session snapshots only
+        bool readParticlesBlocking(const wgfx::GpuContext& ctx, std::vector<Particle>& out,
+            std::vector<u32>& groups, std::vector<v2f>& flow_layers);
+        // replaces live set with 'parts' (up to capacity), next compute continues from them.
+        // 'groups' and 'flow_layers' may be empty, particles then go to group 0
+        void restoreParticles(const wgfx::GpuContext& ctx, ROSpan<Particle> parts,
+            ROSpan<u32> groups, ROSpan<v2f> flow_layers);
 
         void init(const wgfx::GpuContext& ctx, const TextShaderLib& text_shad_lib, InitArgs args);
 
@@ -468,8 +1062,11 @@ namespace vex::flow
             v2f grid_min{};
             v2f grid_size{};
             v2f cell_size{};
+            mtx4 camera_vp{}; // for culling particles outside the view before draw
+            wgfx::GpuProfiler* profiler = nullptr;
             float time = 0;
-            float dt = 0;
+            float dt = 0;   // length of one fixed step
+            u32 steps = 1;  // fixed steps to simulate, each split into substeps by speed
         };
         void compute(wgfx::CompContext& ctx, CompArgs args);
         struct DrawArgs
@@ -481,6 +1078,14 @@ namespace vex::flow
 
         bool reloadShaders(vex::TextShaderLib& shader_lib, const wgfx::GpuContext& context);
 
+        // size of the table zero pass, order and density stay at the default since their cost
+        // depends on particle load. Call before init or reloadShaders
+        void setWorkgroupSizes(const wgfx::WorkgroupTuning& tuning);
+        // times zero on a 'bounds' map at finest table resolution. Needs init, run it before
+        // any particle is spawned: clobbers spatial table. Stalls
+        void tuneWorkgroupSizes(const wgfx::GpuContext& ctx, const TextShaderLib& text_shad_lib,
+            v2u32 bounds, wgfx::WorkgroupTuning& tuning);
+
         void release();
         bool isValid() const;
     };
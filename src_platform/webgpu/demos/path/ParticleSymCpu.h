@@ -0,0 +1,423 @@
+#pragma once
+#include <VCore/Utils/CoreTemplates.h>
+#include <VCore/Utils/VMath.h>
+#include <VCore/Utils/VUtilsBase.h>
+#include <utils/Parallel.h>
+
+#include "WallField.h"
+
+#include <glm/packing.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace vex::flow
+{
+    // GPU particle storage, picked by 'packed_particles' override constant of particle shaders
+    enum class ParticleFormat : u8
+    {
+        k_f32,    // 16 bytes, full precision
+        k_packed, // 8 bytes, position unorm16 relative to grid rect, velocity f16
+    };
+
+    // shared between GPU symulation (flowfield_ps_sym.wgsl) and the CPU one below, layout must
+    // match 'particles' buffer of the shaders
+    template <ParticleFormat F = ParticleFormat::k_f32>
+    struct ParticleT
+    {
+        v2f pos;
+        v2f vel;
+    };
+    template <>
+    struct ParticleT<ParticleFormat::k_packed>
+    {
+        u32 pos; // unorm16x2, 0..1 maps to grid_min..grid_min + grid_size
+        u32 vel; // f16x2
+
+        static ParticleT pack(const ParticleT<>& p, v2f grid_min, v2f grid_size)
+        {
+            return {
+                .pos = glm::packUnorm2x16((p.pos - grid_min) / grid_size),
+                .vel = glm::packHalf2x16(p.vel),
+            };
+        }
+        ParticleT<> unpack(v2f grid_min, v2f grid_size) const
+        {
+            return {
+                .pos = grid_min + glm::unpackUnorm2x16(pos) * grid_size,
+                .vel = glm::unpackHalf2x16(vel),
+            };
+        }
+    };
+    using Particle = ParticleT<>;
+    using PackedParticle = ParticleT<ParticleFormat::k_packed>;
+    static_assert(sizeof(Particle) == 16 && sizeof(PackedParticle) == 8);
+
+    constexpr u32 particleStride(ParticleFormat format)
+    {
+        return format == ParticleFormat::k_packed ? (u32)sizeof(PackedParticle)
+                                                  : (u32)sizeof(Particle);
+    }
+
+    struct SimulateUBO
+    {
+        static constexpr u32 k_max_groups = 16; // keep in sync with flowfield_ps_sym.wgsl
+        struct GroupGoal
+        {
+            v2u32 cell{~0u, ~0u}; // particles of the group entering this cell despawn
+            v2u32 padding{};
+        };
+
+        v2u32 spatial_table_size;
+        v2u32 bounds{};
+        v2f grid_min{};
+        v2f grid_size{};
+        v2f cell_size{};
+        u32 num_particles = 0;
+        u32 table_cells = 0; // spatial_table_size.x * spatial_table_size.y
+
+        f32 speed_base = 1.25f;
+        f32 radius = 0.25;
+
+        f32 separation = 0.2f;
+        f32 inertia = 1.2f;
+
+        f32 drag = 0.05f;
+        f32 speed_max = 8.0f;
+
+        f32 delta_time = 0.01f;
+        u32 flags = 0;
+        u32 num_groups = 1;
+        u32 wall_subdiv = WallField::k_max_subdiv; // WallField samples per cell side
+        v2u32 padding{}; // group_goals start 16 byte aligned
+        // GPU only, headless simulation has a single group and no despawning
+        GroupGoal group_goals[k_max_groups]{};
+    };
+    static_assert(offsetof(SimulateUBO, group_goals) % 16 == 0);
+
+    // Fixed timestep accumulator, simulation advances in whole steps of 'step' seconds so crowd
+    // behaviour doesn't depend on render frame rate. Time beyond max_steps per frame is dropped,
+    // slow frames slow the simulation down instead of snowballing into even slower ones.
+    struct SimClock
+    {
+        static constexpr f32 k_max_vel = 4.0f; // per axis, velocity clamp of cs_main and move()
+        // measured speeds arrive a few frames late, particles may speed up in between
+        static constexpr f32 k_speed_headroom = 1.5f;
+
+        f32 step = 1.0f / 120.0f;
+        u32 max_steps = 4;
+        f32 accumulator = 0;
+
+        // returns number of fixed steps to run this frame
+        u32 advance(f32 frame_dt)
+        {
+            accumulator += std::max(frame_dt, 0.0f);
+            const u32 steps = std::min((u32)(accumulator / step), max_steps);
+            accumulator = steps < max_steps ? accumulator - f32(steps) * step : 0.0f;
+            return steps;
+        }
+
+        // Speed to plan substeps for: the fastest particle measured, at least cruise speed, with
+        // headroom for the readback lag. Never above what the velocity clamp allows
+        static f32 plannedSpeed(f32 measured_max, f32 cruise)
+        {
+            return std::min(
+                std::max(measured_max, cruise) * k_speed_headroom, glm::length(v2f(k_max_vel)));
+        }
+
+        // Substeps of one fixed step so a particle at 'max_speed' moves less than its radius and
+        // less than half a cell per substep, wall lookup can't skip past the middle of a wall cell
+        static u32 substeps(f32 step_dt, f32 max_speed, f32 radius, f32 cell_size, u32 max_substeps)
+        {
+            const f32 max_move = max_speed * step_dt * 0.5f; // see move()
+            const f32 limit = std::min(radius, cell_size * 0.5f);
+            if (limit <= 0)
+                return max_substeps;
+            return std::clamp((u32)std::ceil(max_move / limit), 1u, std::max(max_substeps, 1u));
+        }
+    };
+
+    // Crowd feedback of the distance solver: particles above 'comfort' per cell that don't
+    // move add 'weight' steps each to the cost of entering the cell, up to 'max_extra'. Density
+    // is x: particle count, w: their average speed relative to speed_max, see cs_density.
+    // Same math as crowdCost of flowfield_dist.wgsl, zero weight gives the plain BFS metric
+    struct CrowdCost
+    {
+        f32 weight = 0;
+        f32 comfort = 2.0f;
+        u32 max_extra = 15; // keeps long paths inside 15 bit distances
+
+        u32 cost(v4f density) const
+        {
+            const f32 crowd = std::max(density.x - comfort, 0.0f) * (1.0f - density.w);
+            return 1 + std::min((u32)(crowd * weight), max_extra);
+        }
+    };
+
+    // Headless version of ParticleSym, used for tests, benchmarks and runs without a GPU.
+    // Same parameters and same per-particle math as the compute shaders: separation is
+    // gathered (every particle only writes itself, so result does not depend on thread count
+    // or scheduling) over the whole separation range, as in cs_solve.
+    // State is SoA so inner loops stay branchless and autovectorize.
+    struct ParticleSymCpu
+    {
+        static constexpr u32 k_min_chunk = 1024;
+        static constexpr f32 k_separation_range = 3.5f; // in radii, same as cs_solve
+        static constexpr f32 k_separation_push = 0.15f; // in radii per neighbour, same as cs_solve
+
+        struct MapView
+        {
+            const WallField* walls = nullptr;
+            ROSpan<v2f> flow;      // direction per cell
+            ROSpan<f32> clearance; // optional, distance to closest wall in cells
+        };
+
+        std::vector<f32> pos_x;
+        std::vector<f32> pos_y;
+        std::vector<f32> vel_x;
+        std::vector<f32> vel_y;
+
+        u32 size() const { return (u32)pos_x.size(); }
+
+        void spawn(ROSpan<Particle> parts)
+        {
+            const u32 num = parts.len;
+            pos_x.resize(num);
+            pos_y.resize(num);
+            vel_x.resize(num);
+            vel_y.resize(num);
+            for (u32 i = 0; i < num; ++i)
+            {
+                pos_x[i] = parts.data[i].pos.x;
+                pos_y[i] = parts.data[i].pos.y;
+                vel_x[i] = parts.data[i].vel.x;
+                vel_y[i] = parts.data[i].vel.y;
+            }
+        }
+
+        Particle particle(u32 i) const { return {{pos_x[i], pos_y[i]}, {vel_x[i], vel_y[i]}}; }
+
+        // wall clock time spent in each pass, summed over steps
+        struct PassTimings
+        {
+            f64 hash_ms = 0;
+            f64 separate_ms = 0;
+            f64 move_ms = 0;
+            u32 steps = 0;
+        };
+
+        void step(const SimulateUBO& ubo, const MapView& map, PassTimings* timings = nullptr)
+        {
+            if (size() == 0)
+                return;
+            if (!timings)
+            {
+                hash(ubo);
+                separate(ubo);
+                move(ubo, map);
+                return;
+            }
+            using clock = std::chrono::steady_clock;
+            auto ms = [](clock::time_point from, clock::time_point to)
+            { return std::chrono::duration<f64, std::milli>(to - from).count(); };
+            const auto t0 = clock::now();
+            hash(ubo);
+            const auto t1 = clock::now();
+            separate(ubo);
+            const auto t2 = clock::now();
+            move(ubo, map);
+            const auto t3 = clock::now();
+            timings->hash_ms += ms(t0, t1);
+            timings->separate_ms += ms(t1, t2);
+            timings->move_ms += ms(t2, t3);
+            timings->steps++;
+        }
+
+        // per map cell particle count, average velocity and its speed relative to speed_max,
+        // from the table of last hash(). Same layout as cs_density
+        void density(const SimulateUBO& ubo, std::vector<v4f>& out) const
+        {
+            const u32 subdiv = std::max(table_size.x / std::max(ubo.bounds.x, 1u), 1u);
+            out.assign((size_t)ubo.bounds.x * ubo.bounds.y, v4f(0));
+            for (u32 i = 0; i < (u32)cell_of.size(); ++i)
+            {
+                const u32 cx = std::min(cell_of[i] % table_size.x / subdiv, ubo.bounds.x - 1);
+                const u32 cy = std::min(cell_of[i] / table_size.x / subdiv, ubo.bounds.y - 1);
+                out[cy * ubo.bounds.x + cx] += v4f(1, vel_x[i], vel_y[i], 0);
+            }
+            for (v4f& d : out)
+            {
+                if (d.x == 0)
+                    continue;
+                const v2f avg = v2f(d.y, d.z) / d.x;
+                const f32 speed = glm::length(avg) / std::max(ubo.speed_max, 1e-4f);
+                d = v4f(d.x, avg, glm::clamp(speed, 0.0f, 1.0f));
+            }
+        }
+
+        // counting sort of particles into spatial cells, stable so neighbour order and
+        // therefore float summation order is the same on every run
+        void hash(const SimulateUBO& ubo)
+        {
+            const u32 num = size();
+            const v2u32 table = {std::max(ubo.spatial_table_size.x, 1u),
+                std::max(ubo.spatial_table_size.y, 1u)};
+            table_size = table;
+            table_cell_sz = ubo.grid_size.y / f32(table.y);
+            table_orig = ubo.grid_min + v2f(0, ubo.grid_size.y);
+
+            cell_of.resize(num);
+            cell_start.assign(table.x * table.y + 1, 0);
+            parallelFor(num, k_min_chunk, [&](u32 begin, u32 end) {
+                for (u32 i = begin; i < end; ++i)
+                    cell_of[i] = tableCell(pos_x[i], pos_y[i]);
+            });
+            for (u32 i = 0; i < num; ++i)
+                cell_start[cell_of[i] + 1]++;
+            for (u32 c = 1; c < (u32)cell_start.size(); ++c)
+                cell_start[c] += cell_start[c - 1];
+
+            cursor.assign(cell_start.begin(), cell_start.end() - 1);
+            sorted_x.resize(num);
+            sorted_y.resize(num);
+            for (u32 i = 0; i < num; ++i)
+            {
+                const u32 dst = cursor[cell_of[i]]++;
+                sorted_x[dst] = pos_x[i];
+                sorted_y[dst] = pos_y[i];
+            }
+        }
+
+        void separate(const SimulateUBO& ubo)
+        {
+            const f32 r = ubo.radius;
+            const f32 range = k_separation_range * r;
+            const f32 range_sq = range * range;
+            const f32 push = r * k_separation_push;
+            const i32 reach = table_cell_sz > 0 ? (i32)std::ceil(range / table_cell_sz) : 1;
+
+            parallelFor(size(), k_min_chunk / 4, [&](u32 begin, u32 end) {
+                for (u32 i = begin; i < end; ++i)
+                {
+                    const f32 px = pos_x[i];
+                    const f32 py = pos_y[i];
+                    const i32 cx = (i32)(cell_of[i] % table_size.x);
+                    const i32 cy = (i32)(cell_of[i] / table_size.x);
+                    const i32 x0 = std::max(cx - reach, 0);
+                    const i32 x1 = std::min(cx + reach, (i32)table_size.x - 1);
+                    const i32 y0 = std::max(cy - reach, 0);
+                    const i32 y1 = std::min(cy + reach, (i32)table_size.y - 1);
+                    f32 acc_x = 0;
+                    f32 acc_y = 0;
+                    for (i32 y = y0; y <= y1; ++y)
+                    {
+                        // cells of one row are adjacent in sorted order, one contiguous span
+                        const u32 row = (u32)y * table_size.x;
+                        const u32 first = cell_start[row + x0];
+                        const u32 last = cell_start[row + x1 + 1];
+                        for (u32 j = first; j < last; ++j)
+                        {
+                            const f32 dx = sorted_x[j] - px;
+                            const f32 dy = sorted_y[j] - py;
+                            const f32 d_sq = dx * dx + dy * dy;
+                            // self and exact overlaps have no direction and are skipped
+                            const bool hit = d_sq < range_sq && d_sq > 0;
+                            const f32 inv_len = hit ? 1.0f / std::sqrt(d_sq) : 0.0f;
+                            acc_x -= dx * inv_len;
+                            acc_y -= dy * inv_len;
+                        }
+                    }
+                    vel_x[i] += acc_x * push;
+                    vel_y[i] += acc_y * push;
+                }
+            });
+        }
+
+        // flow following, drag, inertia and wall collision - mirrors cs_main
+        void move(const SimulateUBO& ubo, const MapView& map)
+        {
+            const f32 dt = ubo.delta_time > 0.032f ? 0.032f : ubo.delta_time;
+            const f32 follow = dt * ((2.0f - ubo.inertia) * 2.0f + 0.5f);
+            const f32 damp = 1.0f - ubo.drag * dt;
+            const f32 target_scale = ubo.speed_base * 2.0f;
+            const f32 max_vel = SimClock::k_max_vel;
+
+            parallelFor(size(), k_min_chunk, [&](u32 begin, u32 end) {
+                for (u32 i = begin; i < end; ++i)
+                {
+                    const v2i32 cell = mapCell(ubo, pos_x[i], pos_y[i]);
+                    const u32 cell_idx = cell.y * ubo.bounds.x + cell.x;
+                    const v2f flow = cell_idx < map.flow.len ? map.flow.data[cell_idx] : v2f{};
+                    const v2f target = flow * target_scale;
+
+                    v2f vel = v2f{vel_x[i], vel_y[i]} * damp;
+                    if (vel.x == 0 && vel.y == 0)
+                        vel = target;
+                    vel = vel + (target - vel) * follow;
+                    vel = glm::clamp(vel, v2f(-max_vel), v2f(max_vel));
+                    vel_x[i] = vel.x;
+                    vel_y[i] = vel.y;
+
+                    const v2f pos = {pos_x[i], pos_y[i]};
+                    v2f delta = vel * dt * 0.5f;
+                    const bool near_wall = cell_idx >= map.clearance.len ||
+                                           (map.clearance.data[cell_idx] - 1.5f) * ubo.cell_size.x <=
+                                               ubo.radius + glm::length(vel * dt);
+                    if (near_wall && map.walls)
+                        delta = wallCollide(ubo, *map.walls, pos, delta);
+                    pos_x[i] = pos.x + delta.x;
+                    pos_y[i] = pos.y + delta.y;
+                }
+            });
+        }
+
+    private:
+        std::vector<u32> cell_of;
+        std::vector<u32> cell_start;
+        std::vector<u32> cursor;
+        std::vector<f32> sorted_x;
+        std::vector<f32> sorted_y;
+        v2u32 table_size{1, 1};
+        v2f table_orig{};
+        f32 table_cell_sz = 1;
+
+        u32 tableCell(f32 x, f32 y) const
+        {
+            const f32 fx = (x - table_orig.x) / table_cell_sz;
+            const f32 fy = std::abs(y - table_orig.y) / table_cell_sz;
+            const u32 cx = std::min((u32)std::max(fx, 0.0f), table_size.x - 1);
+            const u32 cy = std::min((u32)std::max(fy, 0.0f), table_size.y - 1);
+            return cy * table_size.x + cx;
+        }
+
+        // rows grow downwards from the top edge of the grid, out of range positions are clamped
+        // to the border cell (shader reads past the edge there)
+        static v2i32 mapCell(const SimulateUBO& ubo, f32 x, f32 y)
+        {
+            const f32 fx = (x - ubo.grid_min.x) / ubo.cell_size.x;
+            const f32 fy = (y - ubo.grid_min.y) / ubo.cell_size.y + 1.0f;
+            const i32 cx = std::clamp((i32)std::max(fx, 0.0f), 0, (i32)ubo.bounds.x - 1);
+            const i32 cy =
+                std::clamp((i32)ubo.bounds.y - (i32)std::max(fy, 0.0f), 0, (i32)ubo.bounds.y - 1);
+            return {cx, cy};
+        }
+
+        // pushes moved position out to particle radius along the distance gradient
+        static v2f wallCollide(const SimulateUBO& ubo, const WallField& walls, v2f center, v2f delta)
+        {
+            const v2f moved = center + delta;
+            const v2f in_cells = {(moved.x - ubo.grid_min.x) / ubo.cell_size.x,
+                (ubo.grid_min.y + ubo.grid_size.y - moved.y) / ubo.cell_size.y};
+            const WallField::Hit hit = walls.sample(in_cells);
+            const f32 dist = hit.dist * ubo.cell_size.x;
+            const f32 grad_len_sq = hit.grad.x * hit.grad.x + hit.grad.y * hit.grad.y;
+            if (dist >= ubo.radius || grad_len_sq == 0)
+                return delta;
+            const v2f normal = v2f(hit.grad.x, -hit.grad.y) / std::sqrt(grad_len_sq);
+            return delta + normal * (ubo.radius - dist);
+        }
+    };
+} // namespace vex::flow
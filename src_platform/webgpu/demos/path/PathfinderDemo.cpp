@@ -2,9 +2,11 @@
 
 #include <imgui.h>
 #include <imgui_internal.h>
+#include <ini.h>
 #include <spdlog/stopwatch.h>
 #include <utils/CLI.h>
 #include <utils/ImGuiUtils.h>
+#include <utils/Parallel.h>
 
 #include <glm/gtx/hash.hpp>
 #include <glm/gtx/matrix_decompose.hpp>
@@ -17,6 +19,58 @@ using namespace std::literals::string_view_literals;
 using namespace std::literals::chrono_literals;
 constexpr const char* console_name = "Console##pathfind";
 
+namespace
+{
+    // pcg output permutation, stateless so any (seed, cell, slot) can be drawn on any thread
+    FORCE_INLINE u32 spawnHash(u32 v)
+    {
+        const u32 state = v * 747796405u + 2891336453u;
+        const u32 word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+    FORCE_INLINE f32 hashTo01(u32 h) { return f32(h >> 8) * (1.0f / f32(1u << 24)); }
+
+    // options read only by init, kept in cfg.ini so a changed value is there on next start
+    constexpr const char* k_restart_section = "pathfinder";
+
+    void loadRestartOptions(SettingsContainer& options)
+    {
+        mINI::INIFile file("cfg.ini");
+        mINI::INIStructure ini;
+        if (!file.read(ini) || !ini.has(k_restart_section))
+            return;
+        auto& section = ini[k_restart_section];
+        auto load = [&]<typename T>(const SettingsContainer::EntryDesc<T>& desc)
+        {
+            SettingsContainer::Entry* ent = options.settings.find(desc.key_name);
+            if (!section.has(desc.key_name) || !ent)
+                return;
+            const i32 value = (i32)std::strtol(section.get(desc.key_name).c_str(), nullptr, 10);
+            ent->setValue((T)value); // clamped to min, max of the entry
+        };
+        load(opt_part_capacity);
+        load(opt_part_packed);
+        load(opt_part_flow_texture);
+    }
+    void storeRestartOptions(SettingsContainer& options)
+    {
+        mINI::INIFile file("cfg.ini");
+        mINI::INIStructure ini;
+        file.read(ini); // keep sections written by others
+        auto& section = ini[k_restart_section];
+        auto store = [&]<typename T>(const SettingsContainer::EntryDesc<T>& desc)
+        {
+            const T value = options.valueOr(desc.key_name, desc.default_val);
+            section[desc.key_name] = std::to_string((i32)value);
+        };
+        store(opt_part_capacity);
+        store(opt_part_packed);
+        store(opt_part_flow_texture);
+        if (!file.generate(ini))
+            SPDLOG_WARN("failed to store {} options in cfg.ini", k_restart_section);
+    }
+} // namespace
+
 void Flow::Map1b::fromImage(Flow::Map1b& out, const char* img)
 {
     spdlog::stopwatch sw;
@@ -33,18 +87,26 @@ void Flow::Map1b::fromImage(Flow::Map1b& out, const char* img)
 
     vex::Buffer<u8>& source = out.source;
     source.reserve(texture.width * texture.height);
-    vex::Buffer<u8>& matrix = out.matrix;
-    matrix.addZeroed(texture.width * texture.height);
     out.size = {cols, rows};
 
-    out.debug_layer.addZeroed(texture.width * texture.height);
-
     for (u32 i = 0; i < rows * cols; i++)
     {
         u32 c = *(data_as_u32 + i);
         bool blocked = (c & 0x000000ff) > 200;
         source.add(blocked ? 0 : 1);
     }
+    out.rebuildNeighborMatrix();
+}
+
+void Flow::Map1b::rebuildNeighborMatrix()
+{
+    const u32 rows = size.y;
+    const u32 cols = size.x;
+    matrix.len = 0;
+    matrix.addZeroed(rows * cols);
+    debug_layer.len = 0;
+    debug_layer.addZeroed(rows * cols);
+    debug_dirty.resize(rows);
 
     constexpr v2i32 neighbors[8] = {
         {0, -1},  // top (CW sart)
@@ -62,8 +124,8 @@ void Flow::Map1b::fromImage(Flow::Map1b& out, const char* img)
         for (u32 x = 0; x < cols; x++)
         {
             v2i32 cur_xy = {x, y};
-            u8* cur_out = matrix.data() + rows * y + x;
-            u8 self_mask = *(source.data() + rows * cur_xy.y + cur_xy.x);
+            u8* cur_out = matrix.data() + cols * y + x;
+            u8 self_mask = *(source.data() + cols * cur_xy.y + cur_xy.x);
             if (self_mask)
             {
                 for (u8 i = 0; i < 8; ++i)
@@ -74,7 +136,7 @@ void Flow::Map1b::fromImage(Flow::Map1b& out, const char* img)
                     {
                         if (xy.x < 0 || xy.x >= cols || xy.y < 0 || xy.y >= rows)
                             return 0;
-                        return *(source.data() + rows * xy.y + xy.x) ? 0xff : 0;
+                        return *(source.data() + cols * xy.y + xy.x) ? 0xff : 0;
                     }();
                     *cur_out |= mask;
                 }
@@ -83,11 +145,134 @@ void Flow::Map1b::fromImage(Flow::Map1b& out, const char* img)
             {
                 *cur_out = 0;
             }
-            out.debug_layer.at(rows * y + x) = *cur_out;
+            debug_layer.at(cols * y + x) = *cur_out;
         }
     }
 }
 
+void Flow::Map1b::restrictToClearance(
+    const Map1b& src, const ClearanceMap& clearance, f32 radius, Map1b& out)
+{
+    check_(src.size == clearance.size);
+    out.size = src.size;
+    out.source.len = 0;
+    out.source.reserve(src.source.size());
+    for (u32 i = 0; i < (u32)src.source.size(); ++i)
+        out.source.add(src.source[i] && clearance.fits(i, radius) ? 1 : 0);
+    out.rebuildNeighborMatrix();
+}
+
+void Flow::buildClearance(const Map1b& grid, ClearanceMap& out)
+{
+    spdlog::stopwatch sw;
+    defer_ { SPDLOG_INFO("clearance map built, elapsed: {} seconds", sw); };
+
+    const u32 cols = grid.size.x;
+    const u32 rows = grid.size.y;
+    vex::Buffer<u8> walls;
+    walls.reserve(cols * rows);
+    for (u8 c : grid.source)
+        walls.add(c ? 0 : 1);
+
+    out.size = grid.size;
+    distanceTransformSq(walls.constSpan(), grid.size, out.dist);
+
+    // outside of the map is a wall too, closest one is straight across the border
+    parallelFor(rows, 64,
+        [&](u32 row_begin, u32 row_end)
+        {
+            for (u32 y = row_begin; y < row_end; ++y)
+            {
+                f32* row = out.dist.data() + y * cols;
+                const f32 border_y = (f32)std::min(y + 1, rows - y);
+                for (u32 x = 0; x < cols; ++x)
+                {
+                    const f32 border = std::min(border_y, (f32)std::min(x + 1, cols - x));
+                    row[x] = std::min(std::sqrt(row[x]), border);
+                }
+            }
+        });
+}
+
+void Flow::distanceTransformSq(ROSpan<u8> is_feature, v2u32 size, vex::Buffer<f32>& out_sq_dist)
+{
+    const u32 cols = size.x;
+    const u32 rows = size.y;
+    check_(is_feature.len == cols * rows);
+    // any real distance is smaller, keeps parabola math finite
+    const f32 far_val = (f32)(cols + rows);
+
+    out_sq_dist.len = 0;
+    out_sq_dist.addUninitialized(cols * rows);
+    f32* g = out_sq_dist.data();
+
+    // phase 1: per column distance to the closest feature, swept row by row so inner loop
+    // runs over contiguous x. Threads take vertical slabs of columns.
+    parallelFor(cols, 256,
+        [&](u32 x_begin, u32 x_end)
+        {
+            const u8* feature = is_feature.data;
+            for (u32 x = x_begin; x < x_end; ++x)
+                g[x] = feature[x] ? 0.0f : far_val;
+            for (u32 y = 1; y < rows; ++y)
+            {
+                const f32* prev = g + (y - 1) * cols;
+                f32* cur = g + y * cols;
+                const u8* f_row = feature + y * cols;
+                for (u32 x = x_begin; x < x_end; ++x)
+                    cur[x] = f_row[x] ? 0.0f : prev[x] + 1.0f;
+            }
+            for (i32 y = (i32)rows - 2; y >= 0; --y)
+            {
+                const f32* next = g + (y + 1) * cols;
+                f32* cur = g + y * cols;
+                for (u32 x = x_begin; x < x_end; ++x)
+                    cur[x] = std::min(cur[x], next[x] + 1.0f);
+            }
+        });
+
+    // phase 2: lower envelope of parabolas (x - i)^2 + g(i)^2 along every row
+    parallelFor(rows, 16,
+        [&](u32 row_begin, u32 row_end)
+        {
+            std::vector<f32> f(cols);
+            std::vector<i32> v(cols);
+            std::vector<f32> z(cols + 1);
+            constexpr f32 inf = std::numeric_limits<f32>::infinity();
+            for (u32 y = row_begin; y < row_end; ++y)
+            {
+                f32* row = g + y * cols;
+                for (u32 x = 0; x < cols; ++x)
+                    f[x] = row[x] * row[x];
+
+                i32 k = 0;
+                v[0] = 0;
+                z[0] = -inf;
+                z[1] = inf;
+                for (i32 q = 1; q < (i32)cols; ++q)
+                {
+                    auto intersect = [&](i32 p)
+                    { return ((f[q] + q * q) - (f[p] + p * p)) / (2.0f * (q - p)); };
+                    f32 s = intersect(v[k]);
+                    while (s <= z[k])
+                        s = intersect(v[--k]);
+                    ++k;
+                    v[k] = q;
+                    z[k] = s;
+                    z[k + 1] = inf;
+                }
+                k = 0;
+                for (i32 q = 0; q < (i32)cols; ++q)
+                {
+                    while (z[k + 1] < q)
+                        ++k;
+                    const f32 dx = (f32)(q - v[k]);
+                    row[q] = dx * dx + f[v[k]];
+                }
+            }
+        });
+}
+
 inline bool shouldPause(Application& owner)
 {
     auto& options = owner.getSettings();
@@ -103,6 +288,8 @@ vex::flow::FlowfieldPF::~FlowfieldPF()
 {
     for (auto& it : defer_till_dtor)
         it();
+    gpu_prof.release();
+    compute_prims.release();
     viewports.release();
 }
 void FlowfieldPF::init(Application& owner, InitArgs args)
@@ -126,38 +313,6 @@ void FlowfieldPF::init(Application& owner, InitArgs args)
         viewports.add(ctx, options);
         viewports.imgui_views.back().gui_enabled = false;
     }
-    // init webgpu stuff
-    {
-        Flow::Map1b::fromImage(init_data, "content/sprites/flow/grid_map32.png");
-        // Flow::Map1b::fromImage(init_data, "content/sprites/flow/grid_map128.png");
-        processed_map.data.reserve(init_data.size.x * init_data.size.y);
-        for (u8 c : init_data.source)
-            processed_map.data.add(c ? 0 : ~ProcessedData::dist_mask);
-
-        heatmap.init(ctx, wgpu_backend->text_shad_lib, processed_map.data.constSpan(),
-            "content/shaders/wgsl/cell_heatmap.wgsl");
-        debug_overlay.init(ctx, wgpu_backend->text_shad_lib, processed_map.data.constSpan(),
-            "content/shaders/wgsl/cell_debugmap.wgsl");
-
-        ui.should_config_docking = false;
-        ui.console_wnd.name = console_name;
-
-        view_grid.init(ctx, wgpu_backend->text_shad_lib);
-        temp_geom.init(ctx, wgpu_backend->text_shad_lib);
-        background.init(ctx, wgpu_backend->text_shad_lib);
-
-        compute_pass.init(ctx, wgpu_backend->text_shad_lib,
-            "content/shaders/wgsl/flow/flowfield_conv.wgsl", heatmap.storage_buf, init_data.size);
-        flow_overlay.init(ctx, wgpu_backend->text_shad_lib, compute_pass.output_buf,
-            "content/shaders/wgsl/flow/flowfield_overlay.wgsl");
-
-        part_sys.init(ctx, wgpu_backend->text_shad_lib,
-            ParticleSym::InitArgs{
-                .flow_v2f_buf = &compute_pass.output_buf,
-                .cells_buf = &heatmap.storage_buf,
-                .bounds = init_data.size,
-            });
-    }
     // init console variables
     {
         auto& options = owner.getSettings();
@@ -166,7 +321,12 @@ void FlowfieldPF::init(Application& owner, InitArgs args)
         opt_show_dbg_overlay.addTo(options);
         opt_allow_diagonal.addTo(options);
         opt_show_numbers.addTo(options);
-        // opt_smooth_flow.addTo(options);
+        opt_radius_aware_paths.addTo(options);
+        opt_gpu_distances.addTo(options);
+        opt_crowd_cost.addTo(options);
+        opt_crowd_comfort.addTo(options);
+        opt_smooth_flow.addTo(options);
+        opt_smooth_radius.addTo(options);
         opt_wallbias_numbers.addTo(options);
         opt_show_ff_overlay.addTo(options);
 
@@ -179,18 +339,33 @@ void FlowfieldPF::init(Application& owner, InitArgs args)
         opt_part_radius.addTo(options);
         opt_part_drag.addTo(options);
         opt_part_sep.addTo(options);
+        opt_part_packed.addTo(options);
+        opt_part_flow_texture.addTo(options);
+        opt_part_capacity.addTo(options);
+        opt_part_resort_interval.addTo(options);
+        opt_part_resort_disorder.addTo(options);
+        opt_part_sim_rate.addTo(options);
+        opt_part_max_substeps.addTo(options);
+        // before init reads them
+        loadRestartOptions(options);
 
         defer_till_dtor.emplace_back(
             [&owner]
             {
                 auto& options = owner.getSettings();
+                storeRestartOptions(options);
                 opt_grid_thickness.removeFrom(options);
                 opt_grid_color.removeFrom(options);
                 opt_show_dbg_overlay.removeFrom(options);
                 opt_allow_diagonal.removeFrom(options);
                 opt_show_numbers.removeFrom(options);
+                opt_radius_aware_paths.removeFrom(options);
+                opt_gpu_distances.removeFrom(options);
+                opt_crowd_cost.removeFrom(options);
+                opt_crowd_comfort.removeFrom(options);
 
-                // opt_smooth_flow.removeFrom(options);
+                opt_smooth_flow.removeFrom(options);
+                opt_smooth_radius.removeFrom(options);
                 opt_wallbias_numbers.removeFrom(options);
                 opt_show_ff_overlay.removeFrom(options);
 
@@ -203,8 +378,82 @@ void FlowfieldPF::init(Application& owner, InitArgs args)
                 opt_part_radius.removeFrom(options);
                 opt_part_drag.removeFrom(options);
                 opt_part_sep.removeFrom(options);
+                opt_part_packed.removeFrom(options);
+                opt_part_flow_texture.removeFrom(options);
+                opt_part_capacity.removeFrom(options);
+                opt_part_resort_interval.removeFrom(options);
+                opt_part_resort_disorder.removeFrom(options);
+                opt_part_sim_rate.removeFrom(options);
+                opt_part_max_substeps.removeFrom(options);
             });
     }
+    // init webgpu stuff
+    {
+        Flow::Map1b::fromImage(init_data, "content/sprites/flow/grid_map32.png");
+        // Flow::Map1b::fromImage(init_data, "content/sprites/flow/grid_map128.png");
+        Flow::buildClearance(init_data, clearance);
+        clearance_buf = GpuBuffer::create(ctx.device,
+            {
+                .label = "clearance buf",
+                .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Storage,
+                .size = (u32)clearance.dist.byteSize(),
+            },
+            (u8*)clearance.dist.data(), (u32)clearance.dist.byteSize());
+        wall_field.build(init_data.source.constSpan(), init_data.size);
+        processed_map.data.reserve(init_data.size.x * init_data.size.y);
+        for (u8 c : init_data.source)
+            processed_map.data.add(c ? 0 : ~ProcessedData::dist_mask);
+        processed_map.size = init_data.size;
+        processed_map.dirty.resize(init_data.size.y);
+
+        heatmap.init(ctx, wgpu_backend->text_shad_lib, processed_map.data.constSpan(),
+            "content/shaders/wgsl/cell_heatmap.wgsl");
+        debug_overlay.init(ctx, wgpu_backend->text_shad_lib, processed_map.data.constSpan(),
+            "content/shaders/wgsl/cell_debugmap.wgsl");
+
+        ui.should_config_docking = false;
+        ui.console_wnd.name = console_name;
+
+        view_grid.init(ctx, wgpu_backend->text_shad_lib);
+        temp_geom.init(ctx, wgpu_backend->text_shad_lib);
+        background.init(ctx, wgpu_backend->text_shad_lib);
+
+        gpu_prof.init(ctx, globals);
+        compute_prims.init(ctx, wgpu_backend->text_shad_lib);
+        const bool sizes_known =
+            workgroup_tuning.load("cfg.ini", WorkgroupTuning::adapterKey(globals.adapter));
+        dist_solver.setWorkgroupSizes(workgroup_tuning);
+        part_sys.setWorkgroupSizes(workgroup_tuning);
+        dist_solver.init(ctx, wgpu_backend->text_shad_lib,
+            "content/shaders/wgsl/flow/flowfield_dist.wgsl", heatmap.storage_buf, init_data.size);
+        const bool flow_texture =
+            owner.getSettings().valueOr(opt_part_flow_texture.key_name, false);
+        compute_pass.init(ctx, wgpu_backend->text_shad_lib,
+            "content/shaders/wgsl/flow/flowfield_conv.wgsl", heatmap.storage_buf, init_data.size,
+            flow_texture);
+        flow_overlay.init(ctx, wgpu_backend->text_shad_lib, compute_pass.output_buf,
+            "content/shaders/wgsl/flow/flowfield_overlay.wgsl");
+
+        part_sys.init(ctx, wgpu_backend->text_shad_lib,
+            ParticleSym::InitArgs{
+                .prims = &compute_prims,
+                .walls = &wall_field,
+                .clearance_buf = &clearance_buf,
+                .density_buf = &dist_solver.density_buf,
+                .max_particles =
+                    (u32)owner.getSettings().valueOr(opt_part_capacity.key_name, 200'000),
+                .max_binding_size = globals.limits.limits.maxStorageBufferBindingSize,
+                .bounds = init_data.size,
+                .format = owner.getSettings().valueOr(opt_part_packed.key_name, false)
+                              ? ParticleFormat::k_packed
+                              : ParticleFormat::k_f32,
+                .flow_texture = flow_texture,
+            });
+        // first run on this adapter, particle passes are timed before anything is spawned
+        if (!sizes_known)
+            tuneWorkgroupSizes();
+        active_group = part_sys.createGroup(goal_cell);
+    }
     // add input hooks
     owner.input.addTrigger("DEBUG"_trig,
         Trigger{
@@ -247,12 +496,11 @@ void FlowfieldPF::trySpawningParticlesAtLocation(const wgfx::GpuContext& ctx, Sp
     const v2f orig = map_area.top_left;
     using Part = ParticleSym::Particle;
     const i32 max_per_cell = 1.5f / ParticleSym::default_rel_radius;
-    const i32 num_to_spawn = (client.max_len * max_per_cell); // 160'000; //
-
-    SPDLOG_INFO("spawning {} particles", num_to_spawn);
 
+    // BFS is capped by max_len, so cost follows the number of spawned particles, not map size
     Flow::gridSyncBFSWithClient<decltype(client), false>({args.cell}, init_data, client);
     const u32 client_len = (u32)client.near.size();
+    SPDLOG_INFO("spawning {} particles", client_len * max_per_cell);
     vex::Buffer<v2f> cells = {frame_alloc, (i32)client_len};
 
     auto cell_cnt_xy = init_data.size;
@@ -262,34 +510,744 @@ void FlowfieldPF::trySpawningParticlesAtLocation(const wgfx::GpuContext& ctx, Sp
         cells.add(orig + v2f(cell_xy.x * sz, -cell_xy.y * sz - sz));
     }
 
-    vex::Buffer<Part> particles = {frame_alloc, num_to_spawn};
-    vex::Buffer<i32> rejection = {frame_alloc, (i32)client_len};
-    rejection.addUninitialized(client_len);
-    for (auto& it : rejection)
-        it = max_per_cell;
-    particles.addUninitialized(num_to_spawn);
-
+    // stratified jitter: every reached cell gets the same quota, spread over k*k strata with a
+    // per cell rotation so partially used strata grids don't bias towards one corner. Jitter
+    // comes from a stateless hash so cells are filled in parallel and the inner loop vectorizes.
+    const u32 quota = (u32)max_per_cell;
+    const u32 strata = (u32)glm::ceil(glm::sqrt((f32)quota));
+    const u32 num_strata = strata * strata;
     const float padding = ParticleSym::default_rel_radius * sz * 0.5f;
-    for (auto i = 0; i < num_to_spawn; ++i)
+    const float stratum_sz = (sz - 2.0f * padding) / strata;
+    const u32 seed = spawnHash(++spawn_counter);
+
+    vex::Buffer<Part> particles = {frame_alloc, (i32)(client_len * quota)};
+    particles.addUninitialized(client_len * quota);
+    vex::parallelFor(client_len, 256,
+        [&](u32 begin, u32 end)
+        {
+            for (u32 c = begin; c < end; ++c)
+            {
+                Part* out = particles.data() + c * quota;
+                const v2f base = cells[c] + v2f{padding, padding};
+                const u32 cell_seed = spawnHash(seed ^ spawnHash(c));
+                const u32 rotation = cell_seed % num_strata;
+                for (u32 s = 0; s < quota; ++s)
+                {
+                    const u32 stratum = (s + rotation) % num_strata;
+                    const u32 h = spawnHash(cell_seed + s);
+                    const f32 jx = hashTo01(h);
+                    const f32 jy = hashTo01(spawnHash(h));
+                    out[s].pos = base + v2f{(f32(stratum % strata) + jx) * stratum_sz,
+                                            (f32(stratum / strata) + jy) * stratum_sz};
+                    out[s].vel = v2f_zero;
+                }
+            }
+        });
+
+    const u32 appended = part_sys.appendParticles(ctx, particles.constSpan(), args.group);
+    if (appended < (u32)particles.size())
+        SPDLOG_WARN("per frame spawn batch of {} is full, dropped {}",
+            part_sys.life_data.max_spawn_batch, particles.size() - appended);
+}
+
+FlowfieldPF::DistanceInputs FlowfieldPF::distanceInputs(
+    Application& owner, const Flow::Map1b& nav_map) const
+{
+    return {
+        .map = &nav_map,
+        .map_radius = &nav_map == &radius_class_map ? radius_class_radius : -1.0f,
+        .goal = goal_cell,
+        .allow_diagonal = owner.getSettings().valueOr(opt_allow_diagonal.key_name, true),
+    };
+}
+
+const Flow::Map1b& FlowfieldPF::navigationMap(Application& owner)
+{
+    auto& settings = owner.getSettings();
+    if (!settings.valueOr(opt_radius_aware_paths.key_name, false))
+        return init_data;
+
+    const f32 radius =
+        settings.valueOr(opt_part_radius.key_name, ParticleSym::default_rel_radius);
+    if (radius != radius_class_radius)
     {
-        i32 repeat_cnt = 4;
-    repeat:
-        auto entry_idx = rng::Rand::randMod(client_len);
-        v2f rand_cell = cells[entry_idx];
-        rejection[entry_idx]--;
-        if (rejection[entry_idx] < 0 && repeat_cnt > 0)
+        Flow::Map1b::restrictToClearance(init_data, clearance, radius, radius_class_map);
+        radius_class_radius = radius;
+    }
+    return radius_class_map;
+}
+
+void FlowfieldPF::benchDistanceSolvers(Application& owner)
+{
+    constexpr u32 sizes[] = {1024, 4096};
+    constexpr u32 batch_iterations = 64;
+    constexpr u32 max_batches = 4096;
+    auto& globals = wgpu_backend->getGlobalResources();
+    const GpuContext ctx = globals.asContext();
+    const bool allow_diagonal = owner.getSettings().valueOr(opt_allow_diagonal.key_name, true);
+
+    dist_bench_results.len = 0;
+    for (u32 size : sizes)
+    {
+        // synthetic map: ~20% of 4x4 blocks are walls, picked by integer hash so runs repeat
+        Flow::Map1b map;
+        map.size = {size, size};
+        map.source.reserve(size * size);
+        for (u32 y = 0; y < size; ++y)
         {
-            repeat_cnt--;
-            goto repeat;
+            for (u32 x = 0; x < size; ++x)
+            {
+                u32 h = ((x / 4) * 73856093u) ^ ((y / 4) * 19349663u);
+                h = (h ^ (h >> 13)) * 0x5bd1e995u;
+                map.source.add((h >> 7) % 100 < 20 ? 0 : 1);
+            }
         }
-        volatile float rnd_x = padding + rng::Rand::randFloat01() * (sz - padding);
-        volatile float rnd_y = padding + rng::Rand::randFloat01() * (sz - padding);
-        particles[i].pos = rand_cell + v2f{rnd_x, rnd_y};
-        particles[i].vel = v2f_zero;
+        const v2u32 goal = {size / 2, size / 2};
+        map.source[goal.y * size + goal.x] = 1;
+        map.rebuildNeighborMatrix();
+
+        DistBenchResult result{.size = size};
+        ProcessedData cpu_out;
+        {
+            spdlog::stopwatch sw;
+            if (allow_diagonal)
+                Flow::gridSyncBFS<true>({goal}, map, cpu_out);
+            else
+                Flow::gridSyncBFS<false>({goal}, map, cpu_out);
+            result.cpu_ms = sw.elapsed() / 1ms;
+        }
+
+        auto out_buf = GpuBuffer::create(ctx.device,
+            {
+                .label = "bench dist out",
+                .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc,
+                .size = size * size * (u32)sizeof(u32),
+            });
+        GpuDistanceSolver solver;
+        solver.init(ctx, wgpu_backend->text_shad_lib, dist_solver.shader_file, out_buf, map.size);
+        defer_
+        {
+            solver.release();
+            out_buf.release();
+        };
+        solver.setMap(ctx, map.source.constSpan());
+        {
+            spdlog::stopwatch sw;
+            for (u32 frontier = 1; frontier > 0 && result.gpu_batches < max_batches;)
+            {
+                CompContext comp_ctx{
+                    .device = ctx.device,
+                    .encoder = wgpuDeviceCreateCommandEncoder(ctx.device, nullptr),
+                    .queue = ctx.queue,
+                };
+                comp_ctx.comp_pass = wgpuCommandEncoderBeginComputePass(comp_ctx.encoder, nullptr);
+                solver.compute(comp_ctx, GpuDistanceSolver::SolveArgs{
+                                             .goal = goal,
+                                             .allow_diagonal = allow_diagonal,
+                                             .restart = result.gpu_batches == 0,
+                                             .iterations = batch_iterations,
+                                         });
+                wgpuComputePassEncoderEnd(comp_ctx.comp_pass);
+                WGPU_REL(ComputePassEncoder, comp_ctx.comp_pass);
+                auto cmd_buf = wgpuCommandEncoderFinish(comp_ctx.encoder, nullptr);
+                wgpuQueueSubmit(ctx.queue, 1, &cmd_buf);
+                WGPU_REL(CommandBuffer, cmd_buf);
+                comp_ctx.release();
+                // readback waits for the batch, so time includes GPU execution
+                frontier = solver.readLastFrontierBlocking(ctx);
+                result.gpu_batches++;
+            }
+            result.gpu_ms = sw.elapsed() / 1ms;
+        }
+
+        vex::Buffer<u32> gpu_out;
+        gpu_out.addUninitialized(size * size);
+        if (readBufferBlocking(ctx, out_buf.buffer, 0, gpu_out.byteSize(), gpu_out.data()))
+        {
+            for (u32 i = 0; i < size * size; ++i)
+                result.mismatches += gpu_out[i] != cpu_out.data[i];
+        }
+        SPDLOG_INFO("distance bench {}^2: cpu bfs {:.2f} ms, gpu {:.2f} ms ({} batches), {} "
+                    "cells differ",
+            size, result.cpu_ms, result.gpu_ms, result.gpu_batches, result.mismatches);
+        dist_bench_results.add(result);
     }
+}
+
+void FlowfieldPF::tuneWorkgroupSizes()
+{
+    constexpr u32 size = 1024;
+    auto& globals = wgpu_backend->getGlobalResources();
+    const GpuContext ctx = globals.asContext();
+    auto& lib = wgpu_backend->text_shad_lib;
 
-    num_particles = num_to_spawn;
-    part_sys.spawnForSymulation(ctx, particles.constSpan());
+    // scratch solver on an open map big enough to fill the GPU, live one keeps its state
+    {
+        vex::Buffer<u8> source;
+        source.reserve(size * size);
+        for (u32 i = 0; i < size * size; ++i)
+            source.add(1);
+        auto out_buf = GpuBuffer::create(ctx.device,
+            {
+                .label = "tune dist out",
+                .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc,
+                .size = size * size * (u32)sizeof(u32),
+            });
+        GpuDistanceSolver solver;
+        solver.init(ctx, lib, dist_solver.shader_file, out_buf, {size, size});
+        defer_
+        {
+            solver.release();
+            out_buf.release();
+        };
+        solver.setMap(ctx, source.constSpan());
+        solver.tuneWorkgroupSizes(ctx, lib, workgroup_tuning);
+    }
+    part_sys.tuneWorkgroupSizes(ctx, lib, processed_map.size, workgroup_tuning);
+
+    dist_solver.setWorkgroupSizes(workgroup_tuning);
+    part_sys.setWorkgroupSizes(workgroup_tuning);
+    dist_solver.reloadShaders(lib, ctx);
+    part_sys.reloadShaders(lib, ctx);
+    if (!workgroup_tuning.save("cfg.ini"))
+        SPDLOG_WARN("failed to store workgroup sizes in cfg.ini");
+}
+
+void FlowfieldPF::benchComputePrimitives()
+{
+    constexpr u32 counts[] = {1u << 20, 1u << 22};
+    constexpr u32 repeats = 8;
+    auto& globals = wgpu_backend->getGlobalResources();
+    const GpuContext ctx = globals.asContext();
+    if (!checkAlwaysRel(compute_prims.isValid(), "compute primitives not initialized"))
+        return;
+
+    prim_bench_results.len = 0;
+    for (u32 count : counts)
+    {
+        std::vector<u32> keys(count);
+        std::vector<u32> flags(count);
+        u32 seed = 3;
+        for (u32 i = 0; i < count; ++i)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            keys[i] = seed ^ (seed >> 15);
+            flags[i] = keys[i] & 1;
+        }
+        auto words = [&](const char* label, u32 num_words, const u32* data = nullptr)
+        {
+            const GpuBuffer::Desc desc{
+                .label = label,
+                .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc |
+                         WGPUBufferUsage_CopyDst,
+                .size = num_words * (u32)sizeof(u32),
+            };
+            return data ? GpuBuffer::create(ctx.device, desc, (u8*)data, desc.size)
+                        : GpuBuffer::create(ctx.device, desc);
+        };
+        GpuBuffer keys_buf = words("bench prim keys", count, keys.data());
+        GpuBuffer flags_buf = words("bench prim flags", count, flags.data());
+        GpuBuffer sort_buf = words("bench prim sorted", count);
+        GpuBuffer scan_buf = words("bench prim scan", count + 1);
+        GpuBuffer reduce_buf = words("bench prim reduce", 4);
+        GpuBuffer compact_buf = words("bench prim compact", count);
+        compute::ScanPlan scan;
+        compute::ReducePlan reduce;
+        compute::CompactPlan compact;
+        compute::RadixSortPlan sort;
+        scan.init(ctx, compute_prims, flags_buf, scan_buf, count);
+        reduce.init(ctx, compute_prims, keys_buf, reduce_buf, count);
+        compact.init(ctx, compute_prims, keys_buf, flags_buf, compact_buf, count);
+        sort.init(ctx, compute_prims, sort_buf, nullptr, count);
+        defer_
+        {
+            scan.release();
+            reduce.release();
+            compact.release();
+            sort.release();
+            for (GpuBuffer* buf :
+                {&keys_buf, &flags_buf, &sort_buf, &scan_buf, &reduce_buf, &compact_buf})
+                buf->release();
+        };
+
+        // one submit per repeat, final readback waits for all of them so GPU time is included
+        auto timeGpu = [&](auto&& record)
+        {
+            spdlog::stopwatch sw;
+            for (u32 r = 0; r < repeats; ++r)
+            {
+                CompContext comp_ctx{
+                    .device = ctx.device,
+                    .encoder = wgpuDeviceCreateCommandEncoder(ctx.device, nullptr),
+                    .queue = ctx.queue,
+                };
+                comp_ctx.comp_pass = wgpuCommandEncoderBeginComputePass(comp_ctx.encoder, nullptr);
+                record(comp_ctx);
+                wgpuComputePassEncoderEnd(comp_ctx.comp_pass);
+                WGPU_REL(ComputePassEncoder, comp_ctx.comp_pass);
+                auto cmd_buf = wgpuCommandEncoderFinish(comp_ctx.encoder, nullptr);
+                wgpuQueueSubmit(ctx.queue, 1, &cmd_buf);
+                WGPU_REL(CommandBuffer, cmd_buf);
+                comp_ctx.release();
+            }
+            u32 probe = 0;
+            readBufferBlocking(ctx, reduce_buf.buffer, 0, sizeof(probe), &probe);
+            return sw.elapsed() / 1ms / repeats;
+        };
+        PrimBenchResult result{.count = count};
+        result.scan_ms = timeGpu([&](CompContext& c) { scan.record(c, count); });
+        result.reduce_ms =
+            timeGpu([&](CompContext& c) { reduce.record(c, count, compute::ReduceOp::k_min); });
+        result.compact_ms = timeGpu([&](CompContext& c) { compact.record(c, count); });
+        result.sort_ms = timeGpu(
+            [&](CompContext& c)
+            {
+                // every repeat sorts the original keys, the write lands before this submit
+                wgpuQueueWriteBuffer(ctx.queue, sort_buf.buffer, 0, keys.data(), count * 4);
+                sort.record(c, count);
+            });
+
+        auto compare = [&](const GpuBuffer& buf, ROSpan<u32> expected)
+        {
+            std::vector<u32> gpu_out(expected.len);
+            if (!readBufferBlocking(ctx, buf.buffer, 0, expected.len * 4, gpu_out.data()))
+                return expected.len;
+            u32 mismatches = 0;
+            for (u32 i = 0; i < expected.len; ++i)
+                mismatches += gpu_out[i] != expected.data[i];
+            return mismatches;
+        };
+        std::vector<u32> expected(count + 1);
+        compute::ref::exclusiveScan({flags.data(), count}, expected.data());
+        result.mismatches += compare(scan_buf, {expected.data(), count + 1});
+        expected[0] = compute::ref::reduce({keys.data(), count}, compute::ReduceOp::k_min);
+        result.mismatches += compare(reduce_buf, {expected.data(), 1});
+        const u32 kept =
+            compute::ref::compact({keys.data(), count}, {flags.data(), count}, expected.data());
+        result.mismatches += compare(compact_buf, {expected.data(), kept});
+        std::vector<u32> sorted = keys;
+        compute::ref::radixSort(sorted);
+        result.mismatches += compare(sort_buf, {sorted.data(), count});
+
+        SPDLOG_INFO("compute primitives {}k: scan {:.2f} ms, reduce {:.2f} ms, compact {:.2f} ms, "
+                    "radix sort {:.2f} ms, {} words differ",
+            count >> 10, result.scan_ms, result.reduce_ms, result.compact_ms, result.sort_ms,
+            result.mismatches);
+        prim_bench_results.add(result);
+    }
+}
+
+void FlowfieldPF::benchFlowSampling()
+{
+    constexpr u32 sizes[] = {512, 2048};
+    constexpr u32 walkers = 1u << 20;
+    constexpr u32 steps = 32;
+    constexpr u32 repeats = 8;
+    constexpr const char* shader_file = "content/shaders/wgsl/flow/flowfield_sample_bench.wgsl";
+    auto& globals = wgpu_backend->getGlobalResources();
+    const GpuContext ctx = globals.asContext();
+    auto* src = wgpu_backend->text_shad_lib.shad_src.find(shader_file);
+    if (!checkAlwaysRel(src, "shader not found"))
+        return;
+    WGPUShaderModule shad = shaderFromSrc(ctx.device, src->text.c_str());
+    defer_ { WGPU_REL(ShaderModule, shad); };
+
+    flow_bench_results.len = 0;
+    for (u32 size : sizes)
+    {
+        // synthetic field: unit directions circling the map center
+        std::vector<v2f> flow(size * size);
+        std::vector<u32> halfs(size * size * 2, 0u);
+        for (u32 y = 0; y < size; ++y)
+        {
+            for (u32 x = 0; x < size; ++x)
+            {
+                const v2f rel = v2f{x, y} + 0.5f - v2f{size, size} * 0.5f;
+                const u32 i = y * size + x;
+                flow[i] = glm::normalize(v2f{-rel.y, rel.x});
+                halfs[i * 2] = glm::packHalf2x16(flow[i]);
+            }
+        }
+        const struct
+        {
+            v2u32 size;
+            u32 steps;
+            u32 padding = 0;
+        } ubo{.size = {size, size}, .steps = steps};
+        auto uniform_buf = GpuBuffer::create(ctx.device,
+            {
+                .label = "bench flow uni buf",
+                .usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst,
+                .size = sizeof(ubo),
+            },
+            (u8*)&ubo, sizeof(ubo));
+        auto flow_buf = GpuBuffer::create(ctx.device,
+            {
+                .label = "bench flow buf",
+                .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst,
+                .size = size * size * (u32)sizeof(v2f),
+            },
+            (u8*)flow.data(), size * size * (u32)sizeof(v2f));
+        auto walked_buf = GpuBuffer::create(ctx.device,
+            {
+                .label = "bench flow walked",
+                .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc,
+                .size = walkers * (u32)sizeof(v2f),
+            });
+        TextureView flow_tex = createFlowTexture(ctx.device, "bench flow tex", {size, size}, 1,
+            WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst);
+        {
+            const WGPUImageCopyTexture dst{
+                .texture = flow_tex.texture,
+                .mipLevel = 0,
+                .origin = {0, 0, 0},
+                .aspect = WGPUTextureAspect_All,
+            };
+            const WGPUTextureDataLayout layout{
+                .offset = 0,
+                .bytesPerRow = size * 2 * (u32)sizeof(u32),
+                .rowsPerImage = size,
+            };
+            const WGPUExtent3D extent{size, size, 1};
+            wgpuQueueWriteTexture(
+                ctx.queue, &dst, halfs.data(), halfs.size() * sizeof(u32), &layout, &extent);
+        }
+        vex::InlineBufferAllocator<2048> temp_alloc_resource;
+        auto [layout, bind_group] =
+            BGLCombinedBuilder{.al = temp_alloc_resource.makeAllocatorHandle()} //
+                .addUniform(sizeof(ubo), uniform_buf, 0, WGPUShaderStage_Compute)
+                .addStorageBuffer(256, flow_buf, WGPUShaderStage_Compute, true)
+                .addTexView(flow_tex.view, BGLCombinedBuilder::def_tex_layout,
+                    WGPUShaderStage_Compute)
+                .addSampler(flow_tex.sampler, WGPUShaderStage_Compute)
+                .addStorageBuffer(256, walked_buf, WGPUShaderStage_Compute, false)
+                .createLayoutAndGroup(ctx.device);
+        // layout reference is held by the bind group, see BGBuilder::createBindGroup
+        defer_
+        {
+            WGPU_REL(BindGroup, bind_group);
+            uniform_buf.release();
+            flow_buf.release();
+            walked_buf.release();
+            flow_tex.release();
+        };
+
+        // one submit per repeat, final readback waits for all of them so GPU time is included
+        auto timeGpu = [&](const char* entry, std::vector<v2f>& walked)
+        {
+            ComputePipeline data{.label = entry, .descriptor = {.entryPoint = entry}};
+            WGPUComputePipeline pipeline = data.createPipeline(ctx, shad, layout);
+            defer_ { WGPU_REL(ComputePipeline, pipeline); };
+            auto record = [&]()
+            {
+                auto encoder = wgpuDeviceCreateCommandEncoder(ctx.device, nullptr);
+                auto pass = wgpuCommandEncoderBeginComputePass(encoder, nullptr);
+                wgpuComputePassEncoderSetPipeline(pass, pipeline);
+                wgpuComputePassEncoderSetBindGroup(pass, 0, bind_group, 0, nullptr);
+                wgpuComputePassEncoderDispatchWorkgroups(pass, walkers / 64, 1, 1);
+                wgpuComputePassEncoderEnd(pass);
+                WGPU_REL(ComputePassEncoder, pass);
+                auto cmd_buf = wgpuCommandEncoderFinish(encoder, nullptr);
+                wgpuQueueSubmit(ctx.queue, 1, &cmd_buf);
+                WGPU_REL(CommandBuffer, cmd_buf);
+                WGPU_REL(CommandEncoder, encoder);
+            };
+            record(); // warm up, first run pays for pipeline compilation
+            walked.resize(walkers);
+            readBufferBlocking(ctx, walked_buf.buffer, 0, walkers * sizeof(v2f), walked.data());
+            spdlog::stopwatch sw;
+            for (u32 r = 0; r < repeats; ++r)
+                record();
+            u32 probe = 0;
+            readBufferBlocking(ctx, walked_buf.buffer, 0, sizeof(probe), &probe);
+            return sw.elapsed() / 1ms / repeats;
+        };
+        FlowSampleBenchResult result{.size = size};
+        std::vector<v2f> nearest, bilinear, texture;
+        result.nearest_ms = timeGpu("cs_buffer_nearest", nearest);
+        result.bilinear_ms = timeGpu("cs_buffer_bilinear", bilinear);
+        result.texture_ms = timeGpu("cs_texture_linear", texture);
+        for (u32 i = 0; i < walkers; ++i)
+        {
+            const v2f diff = glm::abs(texture[i] - bilinear[i]) / f32(steps);
+            result.max_deviation = std::max({result.max_deviation, diff.x, diff.y});
+        }
+        SPDLOG_INFO("flow sampling {}^2, {} walkers x {} steps: buffer nearest {:.2f} ms, buffer "
+                    "bilinear {:.2f} ms, texture {:.2f} ms, texture deviates by {:.4f}",
+            size, walkers, steps, result.nearest_ms, result.bilinear_ms, result.texture_ms,
+            result.max_deviation);
+        flow_bench_results.add(result);
+    }
+}
+
+void FlowfieldPF::benchParticles(Application& owner)
+{
+    constexpr u32 counts[] = {100'000, 200'000, 500'000, 1'000'000, 2'000'000};
+    constexpr u32 frames = 16;
+    auto& globals = wgpu_backend->getGlobalResources();
+    const GpuContext ctx = globals.asContext();
+
+    std::vector<v2u32> free_cells;
+    for (u32 y = 0; y < init_data.size.y; ++y)
+        for (u32 x = 0; x < init_data.size.x; ++x)
+            if (!init_data.isBlocked({x, y}))
+                free_cells.push_back({x, y});
+    if (!checkAlwaysRel(!free_cells.empty(), "no free cell to spawn particles in"))
+        return;
+
+    std::vector<Particle> saved;
+    std::vector<u32> saved_groups;
+    std::vector<v2f> saved_layers;
+    if (!part_sys.readParticlesBlocking(ctx, saved, saved_groups, saved_layers))
+        return;
+    defer_
+    {
+        part_sys.restoreParticles(ctx, {saved.data(), (u32)saved.size()},
+            {saved_groups.data(), (u32)saved_groups.size()},
+            {saved_layers.data(), (u32)saved_layers.size()});
+    };
+
+    const f32 cell_w = camera.height / init_data.size.y;
+    const v2f grid_min = v2f{-camera.height, -camera.height} * 0.5f;
+    auto runFrame = [&]()
+    {
+        CompContext comp_ctx{
+            .device = ctx.device,
+            .encoder = wgpuDeviceCreateCommandEncoder(ctx.device, nullptr),
+            .queue = ctx.queue,
+        };
+        comp_ctx.comp_pass = wgpuCommandEncoderBeginComputePass(comp_ctx.encoder, nullptr);
+        part_sys.compute(comp_ctx, ParticleSym::CompArgs{
+                                       .settings = &owner.getSettings(),
+                                       .bounds = init_data.size,
+                                       .grid_min = grid_min,
+                                       .grid_size = {camera.height, camera.height},
+                                       .cell_size = {cell_w, cell_w},
+                                       .camera_vp = camera.mtx.projection * camera.mtx.view,
+                                       .dt = sim_clock.step,
+                                       .steps = 1,
+                                   });
+        auto cmd_buf = wgpuCommandEncoderFinish(comp_ctx.encoder, nullptr);
+        wgpuQueueSubmit(ctx.queue, 1, &cmd_buf);
+        WGPU_REL(CommandBuffer, cmd_buf);
+        comp_ctx.release();
+        part_sys.pollReadback();
+    };
+    // readback waits for every submitted frame, so time includes GPU execution
+    auto waitGpu = [&]()
+    {
+        u32 probe = 0;
+        readBufferBlocking(ctx, part_sys.life_data.control_buf.buffer, 0, sizeof(probe), &probe);
+    };
+
+    particle_bench_results.len = 0;
+    for (u32 count : counts)
+    {
+        ParticleBenchResult result{
+            .count = count,
+            .packed = part_sys.format == ParticleFormat::k_packed,
+        };
+        if (count > part_sys.capacity())
+        {
+            SPDLOG_WARN("particle bench {}k: over capacity of {}k, raise {}", count / 1000,
+                part_sys.capacity() / 1000, opt_part_capacity.key_name);
+            particle_bench_results.add(result);
+            continue;
+        }
+        u32 seed = 11;
+        auto rnd = [&]()
+        {
+            seed = seed * 1664525u + 1013904223u;
+            return seed >> 8;
+        };
+        std::vector<Particle> parts(count);
+        for (Particle& p : parts)
+        {
+            const v2u32 cell = free_cells[rnd() % free_cells.size()];
+            const v2f in_cell = {f32(rnd()) / f32(1u << 24), f32(rnd()) / f32(1u << 24)};
+            // cell rows grow downwards
+            p = {{grid_min.x + (f32(cell.x) + in_cell.x) * cell_w,
+                     grid_min.y + camera.height - (f32(cell.y) + in_cell.y) * cell_w},
+                {0, 0}};
+        }
+        part_sys.restoreParticles(ctx, {parts.data(), count}, {}, {});
+        runFrame(); // first frame also builds the Morton order and spatial table from scratch
+        waitGpu();
+
+        spdlog::stopwatch sw;
+        for (u32 f = 0; f < frames; ++f)
+            runFrame();
+        waitGpu();
+        result.gpu_ms = sw.elapsed() / 1ms / frames;
+        SPDLOG_INFO("particle bench {}k {}: {:.2f} ms per frame", count / 1000,
+            result.packed ? "packed" : "f32", result.gpu_ms);
+        particle_bench_results.add(result);
+    }
+}
+
+SimSnapshot FlowfieldPF::takeSnapshot(Application& owner, const wgfx::GpuContext& ctx)
+{
+    SimSnapshot snap{
+        .active_group = active_group,
+        .map_version = contentHash(init_data.source.constSpan()),
+        .spawn_counter = spawn_counter,
+        .sim_accumulator = sim_clock.accumulator,
+    };
+    for (u32 g = 0; g < part_sys.numGroups(); ++g)
+        snap.goals.push_back(part_sys.groupGoal(g));
+    if (!part_sys.readParticlesBlocking(ctx, snap.particles, snap.groups, snap.flow_layers))
+        SPDLOG_ERROR("session snapshot: particle readback failed");
+
+    using Kind = SimSnapshot::ValueKind;
+    for (auto& [k, v] : owner.getSettings().settings)
+    {
+        if (!k.starts_with("pf."))
+            continue;
+        SimSnapshot::Setting& out = snap.settings.emplace_back(SimSnapshot::Setting{.key = k});
+        v.value.match(
+            [&](i32& a)
+            {
+                out.kind = Kind::k_i32;
+                out.bits[0] = std::bit_cast<u32>(a);
+            },
+            [&](f32& a)
+            {
+                out.kind = Kind::k_f32;
+                out.bits[0] = std::bit_cast<u32>(a);
+            },
+            [&](bool& a)
+            {
+                out.kind = Kind::k_bool;
+                out.bits[0] = a ? 1 : 0;
+            },
+            [&](v4f& a)
+            {
+                out.kind = Kind::k_v4f;
+                std::memcpy(out.bits, &a, sizeof(out.bits));
+            });
+    }
+    return snap;
+}
+
+bool FlowfieldPF::restoreSnapshot(
+    Application& owner, const wgfx::GpuContext& ctx, const SimSnapshot& snap)
+{
+    const u64 map_version = contentHash(init_data.source.constSpan());
+    if (!checkAlwaysRel(snap.map_version == map_version, "session was recorded on another map"))
+        return false;
+
+    using Kind = SimSnapshot::ValueKind;
+    auto& settings = owner.getSettings();
+    for (const SimSnapshot::Setting& it : snap.settings)
+    {
+        SettingsContainer::Entry* ent = settings.settings.find(it.key);
+        if (!ent)
+            continue;
+        switch (it.kind)
+        {
+        case Kind::k_i32: ent->value.set<i32>(std::bit_cast<i32>(it.bits[0])); break;
+        case Kind::k_f32: ent->value.set<f32>(std::bit_cast<f32>(it.bits[0])); break;
+        case Kind::k_bool: ent->value.set<bool>(it.bits[0] != 0); break;
+        case Kind::k_v4f:
+        {
+            v4f val;
+            std::memcpy(&val, it.bits, sizeof(val));
+            ent->value.set<v4f>(val);
+            break;
+        }
+        }
+    }
+    part_sys.resetGroups();
+    for (v2u32 goal : snap.goals)
+        part_sys.createGroup(goal);
+    if (part_sys.numGroups() == 0)
+        part_sys.createGroup(goal_cell);
+    active_group = std::min(snap.active_group, part_sys.numGroups() - 1);
+    goal_cell = part_sys.groupGoal(active_group);
+    spawn_counter = snap.spawn_counter;
+    sim_clock.accumulator = snap.sim_accumulator;
+    part_sys.restoreParticles(ctx, {snap.particles.data(), (u32)snap.particles.size()},
+        {snap.groups.data(), (u32)snap.groups.size()},
+        {snap.flow_layers.data(), (u32)snap.flow_layers.size()});
+    return true;
+}
+
+f32 FlowfieldPF::updateSession(Application& owner, const wgfx::GpuContext& ctx)
+{
+    auto& rec = session.record;
+    auto stop = [&]()
+    {
+        if (session.mode == SessionMode::k_recording)
+        {
+            if (rec.save(k_session_path))
+                SPDLOG_INFO("session: {} frames, {} events saved to {}", rec.frames(),
+                    rec.events.size(), k_session_path);
+            else
+                SPDLOG_ERROR("session: can't write {}", k_session_path);
+        }
+        else if (session.mode == SessionMode::k_replaying && session.timed_frames > 0)
+        {
+            const f64 n = session.timed_frames;
+            SPDLOG_INFO("session replay: {} frames, per frame: particles {:.3f} ms, move {:.3f} "
+                        "ms, smooth {:.3f} ms",
+                session.frame, session.particles_ms / n, session.move_ms / n,
+                session.smooth_ms / n);
+        }
+        session.mode = SessionMode::k_off;
+    };
+
+    if (session.has_request)
+    {
+        session.has_request = false;
+        stop();
+        if (session.requested == SessionMode::k_recording)
+        {
+            rec.clear();
+            rec.start = takeSnapshot(owner, ctx);
+            session.mode = SessionMode::k_recording;
+        }
+        else if (session.requested == SessionMode::k_replaying)
+        {
+            if (!rec.load(k_session_path))
+                SPDLOG_ERROR("session: can't read {}", k_session_path);
+            else if (restoreSnapshot(owner, ctx, rec.start))
+            {
+                session.mode = SessionMode::k_replaying;
+                session.frame = 0;
+                session.particles_ms = session.move_ms = session.smooth_ms = 0;
+                session.timed_frames = 0;
+            }
+        }
+    }
+
+    const f32 frame_dt = owner.getTime().delta_time_f32;
+    if (session.mode == SessionMode::k_recording)
+        rec.addFrame(frame_dt);
+    if (session.mode != SessionMode::k_replaying)
+        return frame_dt;
+    if (session.frame >= rec.frames())
+    {
+        stop();
+        return frame_dt;
+    }
+    ROSpan<SessionEvent> events = rec.eventsAt(session.frame);
+    for (u32 i = 0; i < events.len; ++i)
+    {
+        const SessionEvent& e = events.data[i];
+        if (e.kind == SessionEvent::Kind::k_goal)
+        {
+            if (e.group >= part_sys.numGroups())
+                part_sys.createGroup(e.cell);
+            else
+                part_sys.retargetGroup(e.group, e.cell);
+            active_group = std::min(e.group, part_sys.numGroups() - 1);
+            goal_cell = part_sys.groupGoal(active_group);
+        }
+        else if (e.kind == SessionEvent::Kind::k_spawn)
+            trySpawningParticlesAtLocation(
+                ctx, {.cell = e.cell, .group = std::min(e.group, part_sys.numGroups() - 1)});
+    }
+    return rec.frame_dt[session.frame];
 }
 
 void FlowfieldPF::update(Application& owner)
@@ -306,14 +1264,26 @@ void FlowfieldPF::update(Application& owner)
         return;
     }
 
-    if (init_data.contains(goal_cell) && !init_data.isBlocked(goal_cell))
+    const Flow::Map1b& nav_map = navigationMap(owner);
+    const bool gpu_distances = owner.getSettings().valueOr(opt_gpu_distances.key_name, true);
+    const bool cpu_reference = !gpu_distances ||
+                               owner.getSettings().valueOr(opt_show_numbers.key_name, false);
+    if (!cpu_reference)
+        bfs_inputs = {}; // heatmap buffer gets GPU data, force full refresh when switching back
+    const DistanceInputs inputs = distanceInputs(owner, nav_map);
+    if (cpu_reference && inputs != bfs_inputs && nav_map.contains(goal_cell) &&
+        !nav_map.isBlocked(goal_cell))
     {
         spdlog::stopwatch sw;
         defer_ { bfs_search_dur_ms = sw.elapsed() / 1ms; };
-        if (owner.getSettings().valueOr(opt_allow_diagonal.key_name, true))
-            Flow::gridSyncBFS<true>({goal_cell}, init_data, processed_map);
+        if (inputs.allow_diagonal)
+            Flow::gridSyncBFS<true>({goal_cell}, nav_map, bfs_scratch);
         else
-            Flow::gridSyncBFS<false>({goal_cell}, init_data, processed_map);
+            Flow::gridSyncBFS<false>({goal_cell}, nav_map, bfs_scratch);
+        if (bfs_inputs.map == nullptr)
+            processed_map.dirty.markAll();
+        processed_map.updateFrom(bfs_scratch);
+        bfs_inputs = inputs;
     }
 
     // #fixme - movable camera
@@ -322,6 +1292,9 @@ void FlowfieldPF::update(Application& owner)
     camera.update();
 
     auto& globals = wgpu_backend->getGlobalResources();
+    const f32 frame_dt = updateSession(owner, globals.asContext());
+    const bool replaying = session.mode == SessionMode::k_replaying;
+    const bool recording = session.mode == SessionMode::k_recording;
 
     const v2i32 pos = owner.input.global.mouse_pos_window;
     viewports.updateMouseLoc(pos);
@@ -339,11 +1312,13 @@ void FlowfieldPF::update(Application& owner)
                 auto gctx = globals.asContext();
                 background.reloadShaders(wgpu_backend->text_shad_lib, gctx);
                 heatmap.reloadShaders(wgpu_backend->text_shad_lib, gctx);
+                dist_solver.reloadShaders(wgpu_backend->text_shad_lib, gctx);
                 debug_overlay.reloadShaders(wgpu_backend->text_shad_lib, gctx);
                 view_grid.reloadShaders(wgpu_backend->text_shad_lib, gctx);
                 flow_overlay.reloadShaders(wgpu_backend->text_shad_lib, gctx);
                 compute_pass.reloadShaders(wgpu_backend->text_shad_lib, gctx);
                 part_sys.reloadShaders(wgpu_backend->text_shad_lib, gctx);
+                compute_prims.reloadShaders(wgpu_backend->text_shad_lib, gctx);
                 return true;
             });
 
@@ -357,20 +1332,31 @@ void FlowfieldPF::update(Application& owner)
         map_area.cell_size = {cell_w, cell_w};
 
         v2u32 m_cell = {mpos.x * r + init_data.size.x / 2, -mpos.y * r + init_data.size.y / 2};
+        hover_cell = m_cell;
+        // CPU side flow sampling under cursor, readback is requested only while hovering
+        if (init_data.contains(m_cell))
+            compute_pass.requestReadback();
         owner.input.ifTriggered("MouseRightHeld"_trig,
             [&](const input::Trigger& self)
             {
-                if (init_data.contains(m_cell) && !init_data.isBlocked(m_cell))
-                    goal_cell = m_cell;
+                if (replaying || !init_data.contains(m_cell) || init_data.isBlocked(m_cell))
+                    return true;
+                if (recording && goal_cell != m_cell)
+                    session.record.addEvent(SessionEvent::Kind::k_goal, active_group, m_cell);
+                goal_cell = m_cell;
+                part_sys.retargetGroup(active_group, m_cell);
                 return true;
             });
         owner.input.ifTriggered("MouseLeftDown"_trig,
             [&](const input::Trigger& self)
             {
-                if (init_data.contains(m_cell) && !init_data.isBlocked(m_cell))
+                if (!replaying && init_data.contains(m_cell) && !init_data.isBlocked(m_cell))
                 {
-                    trySpawningParticlesAtLocation(
-                        globals.asContext(), {.cell = m_cell, .world_pos = mpos});
+                    if (recording)
+                        session.record.addEvent(
+                            SessionEvent::Kind::k_spawn, active_group, m_cell);
+                    trySpawningParticlesAtLocation(globals.asContext(),
+                        {.cell = m_cell, .world_pos = mpos, .group = active_group});
                 }
                 return true;
             });
@@ -400,10 +1386,12 @@ void FlowfieldPF::update(Application& owner)
             // #fixme - restructure whole thing so buffers and layers are separated
             heatmap.draw(wgpu_ctx, draw_args,
                 HeatmapDynamicData{
-                    .buffer = processed_map.data.constSpan(),
+                    // solver on GPU writes the buffer itself
+                    .buffer = gpu_distances ? ROSpan<u32>{} : processed_map.data.constSpan(),
                     .bounds = {(u32)int_sz.x, (u32)int_sz.y},
                     .color1 = {0.340f, 0.740f, 0.707f, 1.f},
                     .color2 = {0.930f, 0.400f, 0.223f, 1.f},
+                    .dirty = &processed_map.dirty,
                 });
         }
         { // compute pass
@@ -424,16 +1412,55 @@ void FlowfieldPF::update(Application& owner)
                 wgpuDeviceTick(ctx.device);
             };
 
-            u32 flags_comp = draw_args.settings->valueOr(opt_wallbias_numbers.key_name, false); //
-            /* | (2 * draw_args.settings->valueOr(opt_smooth_flow.key_name, false));*/
+            if (gpu_distances && nav_map.contains(goal_cell) && !nav_map.isBlocked(goal_cell))
+            {
+                const DistanceInputs inputs = distanceInputs(owner, nav_map);
+                auto& last = dist_solver_inputs;
+                const bool map_changed =
+                    last.map != inputs.map || last.map_radius != inputs.map_radius;
+                if (map_changed)
+                    dist_solver.setMap(wgpu_ctx, nav_map.source.constSpan());
+                const bool restart = last != inputs;
+                last = inputs;
+                // density of last frame's particles, costs change without restarting
+                const CrowdCost crowd{
+                    .weight = draw_args.settings->valueOr(opt_crowd_cost.key_name, 0.0f),
+                    .comfort = draw_args.settings->valueOr(opt_crowd_comfort.key_name, 2.0f),
+                };
+                dist_solver.compute(compute_ctx, GpuDistanceSolver::SolveArgs{
+                                                     .goal = inputs.goal,
+                                                     .allow_diagonal = inputs.allow_diagonal,
+                                                     .restart = restart,
+                                                     .iterations = k_dist_iterations_per_frame,
+                                                     .crowd = crowd,
+                                                 });
+            }
+
+            u32 flags_comp = draw_args.settings->valueOr(opt_wallbias_numbers.key_name, false) |
+                             (draw_args.settings->valueOr(opt_smooth_flow.key_name, true)
+                                     ? ComputeFields::k_flag_smooth
+                                     : 0);
+            const i32 smooth_radius = draw_args.settings->valueOr(
+                opt_smooth_radius.key_name, opt_smooth_radius.default_val);
             compute_pass.compute(compute_ctx, ComputeArgs{
                                                   .map_size = int_sz,
                                                   .flags = flags_comp,
+                                                  .smooth_radius = (u32)smooth_radius,
+                                                  .profiler = &gpu_prof,
                                               });
 
             submit_cmp(compute_ctx);
+            compute_pass.pollReadback();
+
+            const i32 sim_rate = draw_args.settings->valueOr(
+                opt_part_sim_rate.key_name, opt_part_sim_rate.default_val);
+            sim_clock.step = 1.0f / (f32)glm::max(sim_rate, 1);
+            const u32 sim_steps = sim_clock.advance(frame_dt);
 
             compute_ctx.encoder = wgpuDeviceCreateCommandEncoder(wgpu_ctx.device, nullptr);
+            // flow of the active group is refreshed, other groups keep their last field
+            part_sys.updateGroupFlow(compute_ctx.encoder, active_group, compute_pass.output_buf,
+                &compute_pass.flow_tex);
             compute_ctx.comp_pass = wgpuCommandEncoderBeginComputePass(
                 compute_ctx.encoder, nullptr);
             part_sys.compute(compute_ctx, ParticleSym::CompArgs{
@@ -442,10 +1469,30 @@ void FlowfieldPF::update(Application& owner)
                                               .grid_min = map_area.bot_left,
                                               .grid_size = {camera.height, camera.height},
                                               .cell_size = map_area.cell_size,
+                                              .camera_vp =
+                                                  camera.mtx.projection * camera.mtx.view,
+                                              .profiler = &gpu_prof,
                                               .time = (float)time.unscaled_runtime,
-                                              .dt = time.delta_time_f32,
+                                              .dt = sim_clock.step,
+                                              .steps = sim_steps,
                                           });
+            // resolved once for scopes of both command buffers
+            gpu_prof.resolve(compute_ctx.encoder);
             submit_cmp(compute_ctx);
+            gpu_prof.readback();
+            part_sys.pollReadback();
+            if (replaying)
+            {
+                // scope times lag a few frames, sums over the whole replay are still comparable
+                session.frame++;
+                if (gpu_prof.isValid())
+                {
+                    session.particles_ms += gpu_prof.scopeMs(ParticleSym::k_prof_scope_particles);
+                    session.move_ms += gpu_prof.scopeMs(ParticleSym::k_prof_scope_move);
+                    session.smooth_ms += gpu_prof.scopeMs(ComputeFields::k_prof_scope_smooth);
+                    session.timed_frames++;
+                }
+            }
         }
 
         { // overlays
@@ -457,6 +1504,7 @@ void FlowfieldPF::update(Application& owner)
                         .bounds = {(u32)int_sz.x, (u32)int_sz.y},
                         .color1 = {0.340f, 0.740f, 0.707f, 1.f},
                         .color2 = {0.930f, 0.400f, 0.223f, 1.f},
+                        .dirty = &init_data.debug_dirty,
                     });
             }
             if (draw_args.settings->valueOr(opt_show_ff_overlay.key_name, false))
@@ -514,6 +1562,23 @@ void FlowfieldPF::drawUI(Application& owner)
         ImGui::Bullet();
         float bfs_time = (float)bfs_search_dur_ms;
         ImGui::Text(" bfs: %.3f ms", bfs_search_dur_ms);
+        ImGui::Bullet();
+        if (gpu_prof.isValid())
+            ImGui::Text(" smooth: %.3f ms",
+                gpu_prof.scopeMs(ComputeFields::k_prof_scope_smooth));
+        else
+            ImGui::Text(" smooth: n/a");
+        ImGui::Bullet();
+        if (gpu_prof.isValid())
+            ImGui::Text(" particles: %.3f ms",
+                gpu_prof.scopeMs(ParticleSym::k_prof_scope_particles));
+        else
+            ImGui::Text(" particles: n/a");
+        ImGui::Bullet();
+        if (gpu_prof.isValid())
+            ImGui::Text(" move: %.3f ms", gpu_prof.scopeMs(ParticleSym::k_prof_scope_move));
+        else
+            ImGui::Text(" move: n/a");
     }
 
     auto& options = owner.getSettings();
@@ -604,6 +1669,82 @@ void FlowfieldPF::drawUI(Application& owner)
                     should_show_overlay_opt->value.set<bool>(true);
             }
 
+            if (ImGui::Button(ICON_CI_DASHBOARD " bench: distance solvers##pf_bench_dist"))
+                benchDistanceSolvers(owner);
+            ImGui::SameLine();
+            if (ImGui::Button(ICON_CI_DASHBOARD " bench: compute primitives##pf_bench_prims"))
+                benchComputePrimitives();
+            ImGui::SameLine();
+            if (ImGui::Button(ICON_CI_DASHBOARD " bench: flow sampling##pf_bench_flow"))
+                benchFlowSampling();
+            ImGui::SameLine();
+            if (ImGui::Button(ICON_CI_DASHBOARD " bench: particles##pf_bench_particles"))
+                benchParticles(owner);
+            auto requestSession = [&](SessionMode mode)
+            {
+                session.requested = mode;
+                session.has_request = true;
+            };
+            if (session.mode == SessionMode::k_off)
+            {
+                if (ImGui::Button(ICON_CI_RECORD " session: record##pf_session_rec"))
+                    requestSession(SessionMode::k_recording);
+                ImGui::SameLine();
+                if (ImGui::Button(ICON_CI_PLAY " session: replay##pf_session_play"))
+                    requestSession(SessionMode::k_replaying);
+            }
+            else
+            {
+                if (ImGui::Button(ICON_CI_DEBUG_STOP " session: stop##pf_session_stop"))
+                    requestSession(SessionMode::k_off);
+                ImGui::SameLine();
+                if (session.mode == SessionMode::k_recording)
+                    ImGui::Text("recording, frame %u", session.record.frames());
+                else
+                    ImGui::Text("replaying, frame %u/%u", session.frame, session.record.frames());
+            }
+            if (session.mode != SessionMode::k_replaying)
+            {
+                auto selectGroup = [&](u32 group)
+                {
+                    active_group = group;
+                    goal_cell = part_sys.groupGoal(group);
+                    if (session.mode == SessionMode::k_recording)
+                        session.record.addEvent(SessionEvent::Kind::k_goal, group, goal_cell);
+                };
+                if (ImGui::Button(ICON_CI_PLUS " agents: new group##pf_group_add"))
+                {
+                    // starts at the goal of the active group, right click moves it
+                    const u32 group = part_sys.createGroup(goal_cell);
+                    if (group != ~0u)
+                        selectGroup(group);
+                    else
+                        SPDLOG_WARN("all {} agent groups are taken", part_sys.numGroups());
+                }
+                for (u32 g = 0; g < part_sys.numGroups(); ++g)
+                {
+                    item_id.clear();
+                    fmt::format_to(std::back_inserter(item_id), "{}##pf_group_{}", g, g);
+                    ImGui::SameLine();
+                    if (ImGui::RadioButton(item_id.c_str(), active_group == g) &&
+                        active_group != g)
+                        selectGroup(g);
+                }
+            }
+            for (const auto& it : dist_bench_results)
+                ImGui::Text("%u^2: cpu bfs %.2f ms | gpu %.2f ms (%u batches) | diff %u", it.size,
+                    it.cpu_ms, it.gpu_ms, it.gpu_batches, it.mismatches);
+            for (const auto& it : prim_bench_results)
+                ImGui::Text("%uk: scan %.2f | reduce %.2f | compact %.2f | sort %.2f ms | diff %u",
+                    it.count >> 10, it.scan_ms, it.reduce_ms, it.compact_ms, it.sort_ms,
+                    it.mismatches);
+            for (const auto& it : flow_bench_results)
+                ImGui::Text("%u^2: nearest %.2f | bilinear %.2f | texture %.2f ms | dev %.4f",
+                    it.size, it.nearest_ms, it.bilinear_ms, it.texture_ms, it.max_deviation);
+            for (const auto& it : particle_bench_results)
+                ImGui::Text("%uk particles %s: gpu %.2f ms per frame", it.count / 1000,
+                    it.packed ? "packed" : "f32", it.gpu_ms);
+
             ImGui::PushFont(vex::g_view_hub.visuals.fnt_tiny);
             defer_ { ImGui::PopFont(); };
             ImVec2 side_panel_size = {350, 0};
@@ -677,8 +1818,16 @@ void FlowfieldPF::drawUI(Application& owner)
     {
         defer_ { ImGui::EndMainMenuBar(); };
         ImGui::Bullet();
-        ImGui::Text("[particles:%d/%d] ", num_particles, max_particles);
+        ImGui::Text("[particles:%u/%u] ", part_sys.liveParticles(), part_sys.capacity());
+        const auto& crowd = part_sys.crowdStats();
+        ImGui::Text("[arrived:%u speed:%.2f cells/s stuck:%u max density:%u] ", crowd.arrived,
+            crowd.mean_speed, crowd.stuck, crowd.max_density);
         ImGui::Bullet();
+        ROSpan<v2f> flow = compute_pass.flowOnCpu();
+        const u32 hover_idx = hover_cell.y * init_data.size.x + hover_cell.x;
+        if (init_data.contains(hover_cell) && hover_idx < flow.len)
+            ImGui::Text("flow[%u,%u]: (%.2f, %.2f)", hover_cell.x, hover_cell.y,
+                flow.data[hover_idx].x, flow.data[hover_idx].y);
     }
 }
 void FlowfieldPF::postFrame(Application& owner)
@@ -4,9 +4,11 @@
 #include <application/Application.h>
 #include <application/Platfrom.h>
 #include <webgpu/demos/ViewportHandler.h>
+#include <webgpu/render/ComputePrimitives.h>
 #include <webgpu/render/WgpuApp.h>
 
 #include "GpuResources.h"
+#include "SimSession.h"
 
 namespace vex::flow
 {
@@ -48,12 +50,49 @@ namespace vex::flow
         .default_val = true,
         .flags = SettingsContainer::Flags::k_visible_in_ui,
     };
-    //static inline const auto opt_smooth_flow = SettingsContainer::EntryDesc<bool>{
-    //    .key_name = "pf.FlowFieldSmoothing",
-    //    .info = "Will run smoothing pass on flow field vectors",
-    //    .default_val = true,
-    //    .flags = SettingsContainer::Flags::k_visible_in_ui,
-    //};
+    static inline const auto opt_radius_aware_paths = SettingsContainer::EntryDesc<bool>{
+        .key_name = "pf.RadiusAwarePaths",
+        .info = "Search paths only through cells wide enough for particle radius",
+        .default_val = false,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
+    static inline const auto opt_gpu_distances = SettingsContainer::EntryDesc<bool>{
+        .key_name = "pf.GpuDistances",
+        .info = "Solve distance field on GPU, CPU BFS only runs as reference for numbers overlay",
+        .default_val = true,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
+    static inline const auto opt_crowd_cost = SettingsContainer::EntryDesc<float>{
+        .key_name = "pf.CrowdCost",
+        .info = "Extra steps per stuck particle above comfort density, GPU distances route around "
+                "jams. 0 disables.",
+        .default_val = 0.0f,
+        .min = 0.00f,
+        .max = 8.00f,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
+    static inline const auto opt_crowd_comfort = SettingsContainer::EntryDesc<float>{
+        .key_name = "pf.CrowdComfort",
+        .info = "Particles per cell that don't add crowd cost",
+        .default_val = 2.0f,
+        .min = 0.00f,
+        .max = 16.00f,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
+    static inline const auto opt_smooth_flow = SettingsContainer::EntryDesc<bool>{
+        .key_name = "pf.FlowFieldSmoothing",
+        .info = "Will run smoothing pass on flow field vectors",
+        .default_val = true,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
+    static inline const auto opt_smooth_radius = SettingsContainer::EntryDesc<i32>{
+        .key_name = "pf.FlowFieldSmoothingRadius",
+        .info = "Number of cells on each side averaged by smoothing pass, walls stop it.",
+        .default_val = 2,
+        .min = 1,
+        .max = ComputeFields::k_max_smooth_radius,
+        .flags = SettingsContainer::Flags::k_visible_in_ui,
+    };
 
     struct ProcessedData
     {
@@ -61,7 +100,29 @@ namespace vex::flow
         // grid 8b+8b flow vector, 15b distance so far, 1b mask (16th) for blocked
         vex::Buffer<u32> data;
         v2i32 size{0, 0};
+        DirtyRows dirty; // rows not uploaded to GPU yet
         bool contains(v2u32 index) const { return index.x < size.x && index.y < size.y; }
+        // takes 'src' keeping unchanged rows untouched, only rows that differ are marked dirty
+        void updateFrom(const ProcessedData& src)
+        {
+            if (size != src.size || data.size() != src.data.size())
+            {
+                size = src.size;
+                data.len = 0;
+                data.addUninitialized((u32)src.data.size());
+                dirty.resize(size.y);
+            }
+            const u32 row_len = size.x;
+            for (u32 y = 0; y < (u32)size.y; ++y)
+            {
+                u32* dst = data.data() + y * row_len;
+                const u32* from = src.data.data() + y * row_len;
+                if (std::memcmp(dst, from, row_len * sizeof(u32)) == 0)
+                    continue;
+                std::memcpy(dst, from, row_len * sizeof(u32));
+                dirty.mark(y);
+            }
+        }
         FORCE_INLINE u32& operator[](v2u32 index) { return data[index.y * size.x + index.x]; }
         FORCE_INLINE u32& operator[](v2i32 index) { return data[index.y * size.x + index.x]; }
         FORCE_INLINE u32& operator[](i32 offset) { return *(data.first + offset); }
@@ -94,14 +155,22 @@ namespace vex::flow
         };
 
 
+        struct ClearanceMap;
         struct Map1b
         {
             static void fromImage(Flow::Map1b& out, const char* img);
+            // copy of 'src' where cells that cannot fit agent of given radius (in cells) are
+            // blocked, used to run BFS for a radius class
+            static void restrictToClearance(
+                const Map1b& src, const ClearanceMap& clearance, f32 radius, Map1b& out);
+            // rebuilds 'matrix' and 'debug_layer' from 'source'
+            void rebuildNeighborMatrix();
             // neighbors as bitmask, starting at 1 as Top and going clockwise (e.g.
             // top+right => 00000101. zero means blocked, one - valid neighbor
             vex::Buffer<u8> source;
             vex::Buffer<u8> matrix;       // neighbor matrix
             vex::Buffer<u32> debug_layer; // 1st byte is the same as in matrix
+            DirtyRows debug_dirty;        // rows of debug_layer not uploaded to GPU yet
             v2u32 size{0, 0};
 
             bool contains(v2u32 index) const { return index.x < size.x && index.y < size.y; }
@@ -117,6 +186,31 @@ namespace vex::flow
             FORCE_INLINE u8 cellMask(u32 offset) const { return *(matrix.first + offset); }
         };
 
+        // euclidean distance (in cells) from cell center to the center of closest blocked cell,
+        // area outside of the map counts as blocked. Distance to the wall edge is >= dist - 0.5
+        // for walls in the same row/column and >= dist - sqrt(2)/2 in general.
+        struct ClearanceMap
+        {
+            static constexpr f32 half_diag = 0.70710678f;
+            vex::Buffer<f32> dist;
+            v2u32 size{0, 0};
+
+            FORCE_INLINE f32 at(u32 offset) const { return *(dist.first + offset); }
+            FORCE_INLINE f32 at(v2u32 cell) const { return at(cell.y * size.x + cell.x); }
+            // agent of radius (in cells) placed at cell center does not touch any wall
+            FORCE_INLINE bool fits(u32 offset, f32 radius) const
+            {
+                return at(offset) - half_diag >= radius;
+            }
+        };
+        static void buildClearance(const Map1b& grid, ClearanceMap& out);
+
+        // exact squared EDT (Meijster et al.) where cells with non zero 'is_feature' are sources.
+        // Column pass sweeps whole rows at once (vectorizes across x), row pass is the lower
+        // envelope of parabolas, both are split between threads.
+        static void distanceTransformSq(
+            ROSpan<u8> is_feature, v2u32 size, vex::Buffer<f32>& out_sq_dist);
+
         template <bool allow_diagonal = false>
         inline static void gridSyncBFS(Args args, const Map1b& grid, ProcessedData& out)
         {
@@ -132,8 +226,11 @@ namespace vex::flow
                 /*same row      */ -1, // left
                 -(i32)grid.size.x - 1, // top-left
             };
-            // struct
-            vex::StaticRing<i32, 2024, true> frontier;
+            // each cell is queued at most once, so a flat queue of grid size is never outgrown.
+            // Kept on the heap, a ring big enough for large maps would not fit a wasm stack
+            vex::Buffer<i32> frontier;
+            frontier.reserve(grid.size.x * grid.size.y);
+            i32 frontier_head = 0;
             out.size = grid.size;
             out.data.reserve(grid.size.x * grid.size.y);
             out.data.len = 0;
@@ -144,13 +241,13 @@ namespace vex::flow
 
 
             const auto start_cell = args.start.y * grid.size.x + args.start.x;
-            frontier.push(start_cell);
+            frontier.add((i32)start_cell);
             out[start_cell] = 0;
 
             constexpr auto dist_mask = ProcessedData::dist_mask;
-            while (frontier.size() > 0)
+            while (frontier_head < frontier.len)
             {
-                i32 current = (i32)frontier.dequeueUnchecked();
+                i32 current = frontier[frontier_head++];
                 const u8 cell = grid.cellMask(current) & diag_mask;
                 u32 dist_so_far = out[current];
                 for (u8 i = 0; (i < 8) && cell; ++i)
@@ -164,7 +261,7 @@ namespace vex::flow
                         if (visited || (next == start_cell))
                             continue;
                         out[next] |= dist_so_far + 1; // add diagonal cost
-                        frontier.push(next);
+                        frontier.add((i32)next);
                     }
                 }
             }
@@ -219,7 +316,6 @@ namespace vex::flow
 
     struct FlowfieldPF : public IDemoImpl
     { 
-        static constexpr i32 max_particles = 200'000;
         struct InitArgs
         {
         };
@@ -235,8 +331,27 @@ namespace vex::flow
         {
             v2u32 cell;
             v3f world_pos;
+            u32 group = 0;
         };
         void trySpawningParticlesAtLocation(const wgfx::GpuContext& ctx, SpawnArgs args);
+        const Flow::Map1b& navigationMap(Application& owner);
+        struct DistanceInputs;
+        DistanceInputs distanceInputs(Application& owner, const Flow::Map1b& nav_map) const;
+        // times CPU BFS against GpuDistanceSolver on synthetic maps, stalls for a while
+        void benchDistanceSolvers(Application& owner);
+        // times GPU compute primitives against their CPU references, stalls for a while
+        void benchComputePrimitives();
+        // times flow lookups of the move pass, buffer against filtered texture, stalls a while
+        void benchFlowSampling();
+        // times particle compute per frame at 100k..2M particles spread over the map in the
+        // current storage format, restores the live set afterwards. Stalls for a while
+        void benchParticles(Application& owner);
+        // measures workgroup sizes of solver and particle passes, stores them in cfg.ini
+        void tuneWorkgroupSizes();
+        // applies session requests of UI, returns frame time to simulate this frame
+        f32 updateSession(Application& owner, const wgfx::GpuContext& ctx);
+        SimSnapshot takeSnapshot(Application& owner, const wgfx::GpuContext& ctx);
+        bool restoreSnapshot(Application& owner, const wgfx::GpuContext& ctx, const SimSnapshot& snap);
 
         wgfx::ui::ViewportHandler viewports;
         wgfx::ui::BasicDemoUI ui;
@@ -247,7 +362,24 @@ namespace vex::flow
         bool docking_not_configured = true;
 
         Flow::Map1b init_data;
+        Flow::ClearanceMap clearance;
+        WallField wall_field; // particle to wall collisions
         ProcessedData processed_map;
+        ProcessedData bfs_scratch; // BFS output before it is merged into processed_map
+        // everything a distance field depends on, solvers rerun only when it changes
+        struct DistanceInputs
+        {
+            const Flow::Map1b* map = nullptr;
+            f32 map_radius = -1.0f;
+            v2u32 goal{~0u, ~0u};
+            bool allow_diagonal = false;
+            bool operator==(const DistanceInputs&) const = default;
+        };
+        DistanceInputs bfs_inputs;
+        // init_data with cells narrower than particle radius blocked
+        Flow::Map1b radius_class_map;
+        f32 radius_class_radius = -1.0f;
+        wgfx::GpuBuffer clearance_buf;
 
         ColorQuad background;
         TempGeometry temp_geom;
@@ -255,13 +387,80 @@ namespace vex::flow
         CellHeatmapV1 heatmap;
         CellHeatmapV1 debug_overlay;
 
+        GpuDistanceSolver dist_solver;
+        static constexpr u32 k_dist_iterations_per_frame = 32;
+        // solver restarts only when its inputs change, otherwise keeps converging
+        DistanceInputs dist_solver_inputs;
+        struct DistBenchResult
+        {
+            u32 size = 0;
+            f64 cpu_ms = 0;
+            f64 gpu_ms = 0;
+            u32 gpu_batches = 0;
+            u32 mismatches = 0;
+        };
+        vex::Buffer<DistBenchResult> dist_bench_results;
+        wgfx::compute::Primitives compute_prims;
+        struct PrimBenchResult
+        {
+            u32 count = 0;
+            f64 scan_ms = 0;
+            f64 reduce_ms = 0;
+            f64 compact_ms = 0;
+            f64 sort_ms = 0;
+            u32 mismatches = 0;
+        };
+        vex::Buffer<PrimBenchResult> prim_bench_results;
+        struct FlowSampleBenchResult
+        {
+            u32 size = 0;
+            f64 nearest_ms = 0;  // buffer, direction of the cell
+            f64 bilinear_ms = 0; // buffer, 4 cells blended in shader
+            f64 texture_ms = 0;  // rgba16float texture, linear sampler
+            f32 max_deviation = 0; // texture against buffer bilinear, walk average
+        };
+        vex::Buffer<FlowSampleBenchResult> flow_bench_results;
+        struct ParticleBenchResult
+        {
+            u32 count = 0;
+            bool packed = false; // format of the run, flip pf.PtSym_PackedParticles, restart
+            f64 gpu_ms = 0; // per frame, one fixed step, 0 when count is over capacity
+        };
+        vex::Buffer<ParticleBenchResult> particle_bench_results;
+        wgfx::WorkgroupTuning workgroup_tuning;
         ComputeFields compute_pass;
+        wgfx::GpuProfiler gpu_prof;
         FlowFieldsOverlay flow_overlay;
         ParticleSym part_sys; 
+        SimClock sim_clock; // fixed particle timestep, frame time accumulates here
 
         double bfs_search_dur_ms = 0;
-        v2u32 goal_cell = {10, 10};
-        i32 num_particles = 0;
+        v2u32 goal_cell = {10, 10}; // goal of the active group
+        u32 active_group = 0; // agent group steered by input, only its flow field is solved
+        v2u32 hover_cell = {~0u, ~0u};
+        u32 spawn_counter = 0; // seeds spawn jitter
+
+        // record / replay of particle sessions for perf regression runs, see SimSession.h
+        enum class SessionMode : u8
+        {
+            k_off,
+            k_recording,
+            k_replaying,
+        };
+        static constexpr const char* k_session_path = "pf_session.bin";
+        struct
+        {
+            SessionMode mode = SessionMode::k_off;
+            SessionMode requested = SessionMode::k_off; // set by UI, applied on next update
+            bool has_request = false;
+            SessionRecord record;
+            u32 frame = 0; // replay cursor
+            // GPU scope timings summed over replayed frames
+            f64 particles_ms = 0;
+            f64 move_ms = 0;
+            f64 smooth_ms = 0;
+            u32 timed_frames = 0;
+        } session;
 
         struct
         {
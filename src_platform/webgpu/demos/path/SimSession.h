@@ -0,0 +1,222 @@
+#pragma once
+#include "ParticleSymCpu.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace vex::flow
+{
+    // Record and replay of particle sessions, so perf regressions can be reproduced. Snapshot
+    // holds everything simulation depends on, record adds frame times and input events. Replay
+    // feeds them back frame by frame instead of live input and wall clock, same record gives
+    // the same simulation (bitwise on CPU, see replayCpu).
+
+    // FNV-1a, identifies map content and simulation state
+    inline u64 contentHash(ROSpan<u8> bytes, u64 hash = 0xcbf2'9ce4'8422'2325ull)
+    {
+        for (u32 i = 0; i < bytes.len; ++i)
+            hash = (hash ^ bytes.data[i]) * 0x0000'0100'0000'01b3ull;
+        return hash;
+    }
+
+    // equal hashes mean identical particle state
+    inline u64 stateHash(const ParticleSymCpu& sym)
+    {
+        u64 hash = contentHash({});
+        for (const std::vector<f32>* v : {&sym.pos_x, &sym.pos_y, &sym.vel_x, &sym.vel_y})
+            hash = contentHash({(const u8*)v->data(), (u32)(v->size() * sizeof(f32))}, hash);
+        return hash;
+    }
+
+    struct SimSnapshot
+    {
+        enum class ValueKind : u8
+        {
+            k_i32,
+            k_f32,
+            k_bool,
+            k_v4f,
+        };
+        struct Setting
+        {
+            std::string key;
+            ValueKind kind = ValueKind::k_f32;
+            u32 bits[4]{}; // raw value, kind tells how to read it
+        };
+
+        std::vector<Particle> particles; // live set, always full precision
+        std::vector<u32> groups;         // group of every particle
+        std::vector<Setting> settings;
+        std::vector<v2u32> goals;        // goal of every agent group
+        std::vector<v2f> flow_layers;    // flow field of every group, layer after layer
+        u32 active_group = 0;            // group whose flow field is being solved
+        u64 map_version = 0; // contentHash of walkability, replay needs the same map
+        u32 spawn_counter = 0; // seeds spawn jitter
+        f32 sim_accumulator = 0; // SimClock time not simulated yet
+    };
+
+    struct SessionEvent
+    {
+        enum class Kind : u8
+        {
+            k_spawn, // particles of group spawned around cell
+            k_goal,  // goal of group moved to cell, group becomes the active one
+        };
+        u32 frame = 0;
+        Kind kind = Kind::k_spawn;
+        u32 group = 0; // new group when past the last one
+        v2u32 cell{};
+    };
+
+    struct SessionRecord
+    {
+        static constexpr u32 k_magic = 0x5253'5856; // "VXSR"
+        static constexpr u32 k_version = 2;
+
+        SimSnapshot start;
+        std::vector<f32> frame_dt;
+        std::vector<SessionEvent> events; // ordered by frame
+
+        u32 frames() const { return (u32)frame_dt.size(); }
+
+        void clear() { *this = {}; }
+        // starts next frame, events added after belong to it
+        void addFrame(f32 dt) { frame_dt.push_back(dt); }
+        void addEvent(SessionEvent::Kind kind, u32 group, v2u32 cell)
+        {
+            if (frame_dt.empty())
+                addFrame(0);
+            events.push_back({.frame = frames() - 1, .kind = kind, .group = group, .cell = cell});
+        }
+
+        ROSpan<SessionEvent> eventsAt(u32 frame) const
+        {
+            auto by_frame = [](const SessionEvent& e, u32 f) { return e.frame < f; };
+            auto first = std::lower_bound(events.begin(), events.end(), frame, by_frame);
+            auto last = std::lower_bound(first, events.end(), frame + 1, by_frame);
+            return {events.data() + (first - events.begin()), (u32)(last - first)};
+        }
+
+        bool save(const char* path) const
+        {
+            std::ofstream out(path, std::ios::binary);
+            if (!out)
+                return false;
+            auto pod = [&](const auto& v) { out.write((const char*)&v, sizeof(v)); };
+            auto vec = [&](const auto& v)
+            {
+                pod((u32)v.size());
+                out.write((const char*)v.data(), v.size() * sizeof(v[0]));
+            };
+            pod(k_magic);
+            pod(k_version);
+            vec(start.particles);
+            vec(start.groups);
+            pod((u32)start.settings.size());
+            for (const SimSnapshot::Setting& s : start.settings)
+            {
+                vec(s.key);
+                pod(s.kind);
+                pod(s.bits);
+            }
+            vec(start.goals);
+            vec(start.flow_layers);
+            pod(start.active_group);
+            pod(start.map_version);
+            pod(start.spawn_counter);
+            pod(start.sim_accumulator);
+            vec(frame_dt);
+            vec(events);
+            return (bool)out;
+        }
+
+        bool load(const char* path)
+        {
+            clear();
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                return false;
+            auto pod = [&](auto& v) { return (bool)in.read((char*)&v, sizeof(v)); };
+            auto vec = [&](auto& v)
+            {
+                u32 len = 0;
+                if (!pod(len))
+                    return false;
+                v.resize(len);
+                return (bool)in.read((char*)v.data(), len * sizeof(v[0]));
+            };
+            u32 magic = 0;
+            u32 version = 0;
+            if (!pod(magic) || !pod(version) || magic != k_magic || version != k_version)
+                return false;
+            u32 num_settings = 0;
+            if (!vec(start.particles) || !vec(start.groups) || !pod(num_settings))
+                return false;
+            start.settings.resize(num_settings);
+            for (SimSnapshot::Setting& s : start.settings)
+                if (!vec(s.key) || !pod(s.kind) || !pod(s.bits))
+                    return false;
+            const bool ok = vec(start.goals) && vec(start.flow_layers) &&
+                            pod(start.active_group) && pod(start.map_version) &&
+                            pod(start.spawn_counter) && pod(start.sim_accumulator) &&
+                            vec(frame_dt) && vec(events);
+            if (!ok)
+                clear();
+            return ok;
+        }
+    };
+
+    // Replays 'record' on the headless simulation. spawn(cell, spawn_counter) returns particles of
+    // one spawn event, goal events only move ubo.group_goals (headless simulation follows the one
+    // flow field of 'map' whatever the group). ubo.delta_time is the fixed step, every frame runs
+    // as many of them as SimClock gives. Returns stateHash of the final state
+    template <typename TSpawn>
+    u64 replayCpu(ParticleSymCpu& sym, const SessionRecord& record, SimulateUBO ubo,
+        const ParticleSymCpu::MapView& map, TSpawn&& spawn,
+        ParticleSymCpu::PassTimings* timings = nullptr)
+    {
+        std::vector<Particle> live = record.start.particles;
+        sym.spawn({live.data(), (u32)live.size()});
+        SimClock clock{.step = ubo.delta_time, .accumulator = record.start.sim_accumulator};
+        u32 spawn_counter = record.start.spawn_counter;
+        ubo.num_groups =
+            std::clamp((u32)record.start.goals.size(), 1u, SimulateUBO::k_max_groups);
+        for (u32 g = 0; g < (u32)record.start.goals.size() && g < ubo.num_groups; ++g)
+            ubo.group_goals[g].cell = record.start.goals[g];
+        for (u32 frame = 0; frame < record.frames(); ++frame)
+        {
+            ROSpan<SessionEvent> events = record.eventsAt(frame);
+            bool spawned = false;
+            for (u32 i = 0; i < events.len; ++i)
+            {
+                const SessionEvent& e = events.data[i];
+                if (e.kind == SessionEvent::Kind::k_goal && e.group < SimulateUBO::k_max_groups)
+                {
+                    ubo.num_groups = std::max(ubo.num_groups, e.group + 1);
+                    ubo.group_goals[e.group].cell = e.cell;
+                }
+                else if (e.kind == SessionEvent::Kind::k_spawn)
+                {
+                    if (!spawned)
+                    {
+                        live.resize(sym.size());
+                        for (u32 p = 0; p < sym.size(); ++p)
+                            live[p] = sym.particle(p);
+                        spawned = true;
+                    }
+                    const std::vector<Particle> batch = spawn(e.cell, ++spawn_counter);
+                    live.insert(live.end(), batch.begin(), batch.end());
+                }
+            }
+            if (spawned)
+                sym.spawn({live.data(), (u32)live.size()});
+            const u32 steps = clock.advance(record.frame_dt[frame]);
+            ubo.num_particles = sym.size();
+            for (u32 s = 0; s < steps; ++s)
+                sym.step(ubo, map, timings);
+        }
+        return stateHash(sym);
+    }
+} // namespace vex::flow
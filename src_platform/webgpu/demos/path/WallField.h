@@ -0,0 +1,154 @@
+#pragma once
+#include <VCore/Utils/CoreTemplates.h>
+#include <VCore/Utils/VMath.h>
+#include <VCore/Utils/VUtilsBase.h>
+#include <utils/Parallel.h>
+
+#include <glm/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace vex::flow
+{
+    // Signed distance from a point to the closest wall edge, with its gradient (pointing away
+    // from walls), sampled on a grid finer than map cells. Particles collide with walls by
+    // a single bilinear lookup instead of testing boxes of neighbour cells.
+    // Units are cells, x grows right and y grows down from the top-left corner of the map (same
+    // as map rows). Area outside of the map is a wall. Distances are clamped to k_reach.
+    struct WallField
+    {
+        static constexpr u32 k_max_subdiv = 4;
+        static constexpr i32 k_reach = 2;                  // cells searched around a sample
+        static constexpr u64 k_max_bytes = 64ull << 20;    // subdiv drops on huge maps
+
+        // layout shared with flowfield_ps_sym.wgsl
+        struct Sample
+        {
+            u32 grad; // f16x2
+            f32 dist;
+        };
+        struct Hit
+        {
+            f32 dist;
+            v2f grad; // not normalized, zero when far from walls
+        };
+
+        std::vector<Sample> samples;
+        std::vector<u8> walkable; // copy of the map, non zero is free
+        v2u32 cells{0, 0};
+        v2u32 size{0, 0}; // samples per axis, cells * subdiv + 1
+        u32 subdiv = k_max_subdiv;
+
+        void build(ROSpan<u8> map_walkable, v2u32 map_size)
+        {
+            cells = map_size;
+            walkable.assign(map_walkable.data, map_walkable.data + map_walkable.len);
+            subdiv = k_max_subdiv;
+            while (subdiv > 1 && sampleCount(subdiv) * sizeof(Sample) > k_max_bytes)
+                subdiv--;
+            size = {cells.x * subdiv + 1, cells.y * subdiv + 1};
+            samples.resize((size_t)size.x * size.y);
+            updateRows(0, size.y);
+        }
+
+        // bilinear lookup, position in cells
+        Hit sample(v2f pos) const
+        {
+            const v2f s = glm::clamp(pos * f32(subdiv), v2f(0), v2f(size - 1u));
+            const v2u32 s0 = glm::min(v2u32(s), size - 2u);
+            const v2f t = s - v2f(s0);
+            const Sample& a = samples[s0.y * size.x + s0.x];
+            const Sample& b = samples[s0.y * size.x + s0.x + 1];
+            const Sample& c = samples[(s0.y + 1) * size.x + s0.x];
+            const Sample& d = samples[(s0.y + 1) * size.x + s0.x + 1];
+            auto lerp2 = [&](auto va, auto vb, auto vc, auto vd) {
+                const auto top = va + (vb - va) * t.x;
+                const auto bot = vc + (vd - vc) * t.x;
+                return top + (bot - top) * t.y;
+            };
+            return {
+                .dist = lerp2(a.dist, b.dist, c.dist, d.dist),
+                .grad = lerp2(glm::unpackHalf2x16(a.grad), glm::unpackHalf2x16(b.grad),
+                    glm::unpackHalf2x16(c.grad), glm::unpackHalf2x16(d.grad)),
+            };
+        }
+
+    private:
+        u64 sampleCount(u32 sd) const { return (u64)(cells.x * sd + 1) * (cells.y * sd + 1); }
+
+        bool isWall(i32 x, i32 y) const
+        {
+            if (x < 0 || y < 0 || x >= (i32)cells.x || y >= (i32)cells.y)
+                return true;
+            return walkable[y * cells.x + x] == 0;
+        }
+
+        void updateRows(u32 row_begin, u32 row_end)
+        {
+            parallelFor(row_end - row_begin, 16, [&](u32 begin, u32 end) {
+                for (u32 sy = row_begin + begin; sy < row_begin + end; ++sy)
+                    for (u32 sx = 0; sx < size.x; ++sx)
+                        samples[sy * size.x + sx] = compute(v2f(sx, sy) / f32(subdiv));
+            });
+        }
+
+        // exact distance to the union of wall cell boxes, or to the free area when inside
+        Sample compute(v2f p) const
+        {
+            const i32 px = (i32)std::floor(p.x);
+            const i32 py = (i32)std::floor(p.y);
+            const f32 reach = (f32)k_reach;
+            f32 to_wall = reach;
+            f32 to_free = reach;
+            v2f wall_pt = p;
+            v2f free_pt = p;
+            v2f touching_free{0, 0}; // p lies on a wall edge, direction to free cells around
+            for (i32 y = py - k_reach; y <= py + k_reach; ++y)
+                for (i32 x = px - k_reach; x <= px + k_reach; ++x)
+                {
+                    const v2f closest = glm::clamp(p, v2f(x, y), v2f(x + 1, y + 1));
+                    const f32 d = glm::length(closest - p);
+                    if (isWall(x, y))
+                    {
+                        if (d < to_wall)
+                        {
+                            to_wall = d;
+                            wall_pt = closest;
+                        }
+                    }
+                    else
+                    {
+                        if (d < to_free)
+                        {
+                            to_free = d;
+                            free_pt = closest;
+                        }
+                        if (d == 0)
+                            touching_free += v2f(x + 0.5f, y + 0.5f) - p;
+                    }
+                }
+
+            v2f grad{0, 0};
+            f32 dist = 0;
+            if (to_wall > 0)
+            {
+                dist = to_wall;
+                if (to_wall < reach)
+                    grad = (p - wall_pt) / to_wall;
+            }
+            else if (to_free > 0)
+            {
+                dist = -to_free;
+                if (to_free < reach)
+                    grad = (free_pt - p) / to_free;
+            }
+            else if (touching_free != v2f(0, 0))
+            {
+                grad = glm::normalize(touching_free);
+            }
+            return {.grad = glm::packHalf2x16(grad), .dist = dist};
+        }
+    };
+} // namespace vex::flow
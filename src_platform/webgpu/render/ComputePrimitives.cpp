@@ -0,0 +1,313 @@
+#include "ComputePrimitives.h"
+
+using namespace wgfx;
+using namespace wgfx::compute;
+
+namespace
+{
+    constexpr u32 k_scatter_group = 256; // cs_compact_scatter
+    constexpr u32 k_segment_group = 64;  // cs_segmented_reduce
+
+    GpuBuffer createParams(WGPUDevice device, const char* label, u32 num_slots)
+    {
+        return GpuBuffer::create(device, {
+                                             .label = label,
+                                             .usage = WGPUBufferUsage_CopyDst |
+                                                      WGPUBufferUsage_Uniform,
+                                             .size = num_slots * k_param_stride,
+                                         });
+    }
+    GpuBuffer createWords(WGPUDevice device, const char* label, u32 num_words)
+    {
+        return GpuBuffer::create(device, {
+                                             .label = label,
+                                             .usage = WGPUBufferUsage_Storage |
+                                                      WGPUBufferUsage_CopySrc,
+                                             .size = std::max(num_words, 4u) * 4,
+                                         });
+    }
+    void writeParams(const CompContext& ctx, const GpuBuffer& buf, u32 slot, Params params)
+    {
+        wgpuQueueWriteBuffer(
+            ctx.queue, buf.buffer, slot * k_param_stride, &params, sizeof(Params));
+    }
+    u32 groupsFor(u32 count, u32 group_size) { return (count + group_size - 1) / group_size; }
+} // namespace
+
+void wgfx::compute::Primitives::init(
+    const GpuContext& ctx, const vex::TextShaderLib& text_shad_lib)
+{
+    vex::InlineBufferAllocator<4096> temp_alloc_resource;
+    auto tmp_alloc = temp_alloc_resource.makeAllocatorHandle();
+
+    auto* src = text_shad_lib.shad_src.find(shader_file);
+    if (!checkAlwaysRel(src, "shader not found"))
+        return;
+    WGPUShaderModule shad = shaderFromSrc(ctx.device, src->text.c_str());
+
+    dummy_read_buf = createWords(ctx.device, "prim dummy read", 4);
+    dummy_write_buf = createWords(ctx.device, "prim dummy write", 4);
+
+    BGLayoutBuilder layout_builder{.entries = {tmp_alloc, 8}};
+    layout_builder.addUniform(sizeof(Params), WGPUShaderStage_Compute, true);
+    for (bool read_only : {true, false, false, true, true, false})
+    {
+        layout_builder.add(WGPUBindGroupLayoutEntry{
+            .visibility = WGPUShaderStage_Compute,
+            .buffer =
+                {
+                    .type = read_only ? WGPUBufferBindingType_ReadOnlyStorage
+                                      : WGPUBufferBindingType_Storage,
+                    .minBindingSize = 16,
+                },
+        });
+    }
+    bgl_layout = layout_builder.createLayout(ctx.device);
+    check_(bgl_layout);
+
+    block_reduce_pipeline = block_reduce_data.createPipeline(ctx, shad, bgl_layout);
+    scan_partials_pipeline = scan_partials_data.createPipeline(ctx, shad, bgl_layout);
+    scan_blocks_pipeline = scan_blocks_data.createPipeline(ctx, shad, bgl_layout);
+    reduce_final_pipeline = reduce_final_data.createPipeline(ctx, shad, bgl_layout);
+    segmented_reduce_pipeline = segmented_reduce_data.createPipeline(ctx, shad, bgl_layout);
+    compact_scatter_pipeline = compact_scatter_data.createPipeline(ctx, shad, bgl_layout);
+    radix_histogram_pipeline = radix_histogram_data.createPipeline(ctx, shad, bgl_layout);
+    radix_scatter_pipeline = radix_scatter_data.createPipeline(ctx, shad, bgl_layout);
+}
+
+bool wgfx::compute::Primitives::reloadShaders(
+    vex::TextShaderLib& shader_lib, const GpuContext& context)
+{
+    WGPUShaderModule shad = reloadShader(shader_lib, context, shader_file);
+    if (!shad)
+        return false;
+
+    WGPU_REL(ComputePipeline, block_reduce_pipeline);
+    WGPU_REL(ComputePipeline, scan_partials_pipeline);
+    WGPU_REL(ComputePipeline, scan_blocks_pipeline);
+    WGPU_REL(ComputePipeline, reduce_final_pipeline);
+    WGPU_REL(ComputePipeline, segmented_reduce_pipeline);
+    WGPU_REL(ComputePipeline, compact_scatter_pipeline);
+    WGPU_REL(ComputePipeline, radix_histogram_pipeline);
+    WGPU_REL(ComputePipeline, radix_scatter_pipeline);
+    block_reduce_pipeline = block_reduce_data.createPipeline(context, shad, bgl_layout);
+    scan_partials_pipeline = scan_partials_data.createPipeline(context, shad, bgl_layout);
+    scan_blocks_pipeline = scan_blocks_data.createPipeline(context, shad, bgl_layout);
+    reduce_final_pipeline = reduce_final_data.createPipeline(context, shad, bgl_layout);
+    segmented_reduce_pipeline = segmented_reduce_data.createPipeline(context, shad, bgl_layout);
+    compact_scatter_pipeline = compact_scatter_data.createPipeline(context, shad, bgl_layout);
+    radix_histogram_pipeline = radix_histogram_data.createPipeline(context, shad, bgl_layout);
+    radix_scatter_pipeline = radix_scatter_data.createPipeline(context, shad, bgl_layout);
+    check_(isValid());
+    return true;
+}
+
+WGPUBindGroup wgfx::compute::Primitives::createBindGroup(
+    WGPUDevice device, const GpuBuffer& params_buf, const Bindings& bindings) const
+{
+    vex::InlineBufferAllocator<1024> temp_alloc_resource;
+    auto tmp_alloc = temp_alloc_resource.makeAllocatorHandle();
+
+    BGBuilder group_builder{.entries = {tmp_alloc, 8}};
+    group_builder.add(WGPUBindGroupEntry{
+        .buffer = params_buf.buffer,
+        .offset = 0,
+        .size = sizeof(Params),
+    });
+    const GpuBuffer* slots[] = {bindings.src, bindings.dst, bindings.partials, bindings.aux,
+        bindings.src_values, bindings.dst_values};
+    const bool read_only[] = {true, false, false, true, true, false};
+    for (u32 i = 0; i < 6; ++i)
+    {
+        const GpuBuffer* buf = slots[i];
+        if (!buf)
+            buf = read_only[i] ? &dummy_read_buf : &dummy_write_buf;
+        group_builder.add(*buf);
+    }
+    // BGBuilder::createBindGroup releases the layout, this one is shared
+    auto desc = group_builder.toDescriptor(bgl_layout);
+    WGPUBindGroup group = wgpuDeviceCreateBindGroup(device, &desc);
+    check_(group);
+    return group;
+}
+
+void wgfx::compute::Primitives::dispatch(WGPUComputePassEncoder pass,
+    WGPUComputePipeline pipeline, WGPUBindGroup group, u32 param_slot, u32 num_groups) const
+{
+    const u32 offset = param_slot * k_param_stride;
+    wgpuComputePassEncoderSetBindGroup(pass, 0, group, 1, &offset);
+    wgpuComputePassEncoderSetPipeline(pass, pipeline);
+    wgpuComputePassEncoderDispatchWorkgroups(pass, num_groups, 1, 1);
+}
+
+void wgfx::compute::ScanPlan::init(const GpuContext& ctx, const Primitives& in_prims,
+    const GpuBuffer& in, const GpuBuffer& out, u32 in_max_count)
+{
+    prims = &in_prims;
+    max_count = in_max_count;
+    check_(in.buffer != out.buffer);
+    check_(out.desc.size >= (max_count + 1) * 4);
+    params_buf = createParams(ctx.device, "prim scan params", 1);
+    // block sums, then their offsets plus the total
+    partials_buf = createWords(ctx.device, "prim scan partials", numBlocks(max_count) + 1);
+    bind_group = prims->createBindGroup(ctx.device, params_buf,
+        {
+            .src = &in,
+            .dst = &out,
+            .partials = &partials_buf,
+        });
+}
+
+void wgfx::compute::ScanPlan::record(CompContext& ctx, u32 count)
+{
+    check_(count <= max_count);
+    // empty input still runs one block, it writes the zero total
+    const u32 blocks = std::max(numBlocks(count), 1u);
+    writeParams(ctx, params_buf, 0, {.count = count, .num_blocks = blocks});
+    prims->dispatch(ctx.comp_pass, prims->block_reduce_pipeline, bind_group, 0, blocks);
+    prims->dispatch(ctx.comp_pass, prims->scan_partials_pipeline, bind_group, 0, 1);
+    prims->dispatch(ctx.comp_pass, prims->scan_blocks_pipeline, bind_group, 0, blocks);
+}
+
+void wgfx::compute::ReducePlan::init(const GpuContext& ctx, const Primitives& in_prims,
+    const GpuBuffer& in, const GpuBuffer& out, u32 in_max_count)
+{
+    prims = &in_prims;
+    max_count = in_max_count;
+    check_(in.buffer != out.buffer);
+    params_buf = createParams(ctx.device, "prim reduce params", 1);
+    partials_buf = createWords(ctx.device, "prim reduce partials", numBlocks(max_count));
+    bind_group = prims->createBindGroup(ctx.device, params_buf,
+        {
+            .src = &in,
+            .dst = &out,
+            .partials = &partials_buf,
+        });
+}
+
+void wgfx::compute::ReducePlan::record(CompContext& ctx, u32 count, ReduceOp op)
+{
+    check_(count <= max_count);
+    const u32 blocks = std::max(numBlocks(count), 1u);
+    writeParams(ctx, params_buf, 0, {.count = count, .num_blocks = blocks, .op = (u32)op});
+    prims->dispatch(ctx.comp_pass, prims->block_reduce_pipeline, bind_group, 0, blocks);
+    prims->dispatch(ctx.comp_pass, prims->reduce_final_pipeline, bind_group, 0, 1);
+}
+
+void wgfx::compute::SegmentedReducePlan::init(const GpuContext& ctx, const Primitives& in_prims,
+    const GpuBuffer& values, const GpuBuffer& offsets, const GpuBuffer& out, u32 in_max_segments)
+{
+    prims = &in_prims;
+    max_segments = in_max_segments;
+    check_(offsets.desc.size >= (max_segments + 1) * 4);
+    params_buf = createParams(ctx.device, "prim segmented params", 1);
+    bind_group = prims->createBindGroup(ctx.device, params_buf,
+        {
+            .src = &values,
+            .dst = &out,
+            .aux = &offsets,
+        });
+}
+
+void wgfx::compute::SegmentedReducePlan::record(CompContext& ctx, u32 num_segments, ReduceOp op)
+{
+    check_(num_segments <= max_segments);
+    if (num_segments == 0)
+        return;
+    writeParams(ctx, params_buf, 0, {.count = num_segments, .op = (u32)op});
+    prims->dispatch(ctx.comp_pass, prims->segmented_reduce_pipeline, bind_group, 0,
+        groupsFor(num_segments, k_segment_group));
+}
+
+void wgfx::compute::CompactPlan::init(const GpuContext& ctx, const Primitives& in_prims,
+    const GpuBuffer& values, const GpuBuffer& flags, const GpuBuffer& out, u32 in_max_count)
+{
+    prims = &in_prims;
+    max_count = in_max_count;
+    check_(groupsFor(max_count, k_scatter_group) <= 65535);
+    params_buf = createParams(ctx.device, "prim compact params", 1);
+    offsets_buf = createWords(ctx.device, "prim compact offsets", max_count + 1);
+    flag_scan.init(ctx, *prims, flags, offsets_buf, max_count);
+    bind_group = prims->createBindGroup(ctx.device, params_buf,
+        {
+            .src = &values,
+            .dst = &out,
+            .aux = &offsets_buf,
+        });
+}
+
+void wgfx::compute::CompactPlan::record(CompContext& ctx, u32 count)
+{
+    check_(count <= max_count);
+    flag_scan.record(ctx, count);
+    if (count == 0)
+        return;
+    writeParams(ctx, params_buf, 0, {.count = count});
+    prims->dispatch(ctx.comp_pass, prims->compact_scatter_pipeline, bind_group, 0,
+        groupsFor(count, k_scatter_group));
+}
+
+void wgfx::compute::RadixSortPlan::init(const GpuContext& ctx, const Primitives& in_prims,
+    const GpuBuffer& keys, const GpuBuffer* values, u32 in_max_count)
+{
+    prims = &in_prims;
+    max_count = in_max_count;
+    has_values = values != nullptr;
+    const u32 max_hist = k_radix_digits * numBlocks(max_count);
+    params_buf = createParams(ctx.device, "prim radix params", k_max_passes);
+    hist_buf = createWords(ctx.device, "prim radix histogram", max_hist);
+    offsets_buf = createWords(ctx.device, "prim radix offsets", max_hist + 1);
+    tmp_keys_buf = createWords(ctx.device, "prim radix tmp keys", max_count);
+    if (has_values)
+        tmp_values_buf = createWords(ctx.device, "prim radix tmp values", max_count);
+    hist_scan.init(ctx, *prims, hist_buf, offsets_buf, max_hist);
+
+    const GpuBuffer* tmp_values = has_values ? &tmp_values_buf : nullptr;
+    bind_groups[0] = prims->createBindGroup(ctx.device, params_buf,
+        {
+            .src = &keys,
+            .dst = &tmp_keys_buf,
+            .partials = &hist_buf,
+            .aux = &offsets_buf,
+            .src_values = values,
+            .dst_values = tmp_values,
+        });
+    bind_groups[1] = prims->createBindGroup(ctx.device, params_buf,
+        {
+            .src = &tmp_keys_buf,
+            .dst = &keys,
+            .partials = &hist_buf,
+            .aux = &offsets_buf,
+            .src_values = tmp_values,
+            .dst_values = values,
+        });
+}
+
+void wgfx::compute::RadixSortPlan::record(CompContext& ctx, u32 count, u32 key_bits)
+{
+    check_(count <= max_count && key_bits <= 32);
+    if (count == 0)
+        return;
+    // extra pass sorts on zero digits, it only moves data back into the caller's buffers
+    u32 passes = (key_bits + k_radix_bits - 1) / k_radix_bits;
+    passes = std::max(passes + (passes & 1), 2u);
+    const u32 blocks = numBlocks(count);
+    for (u32 pass = 0; pass < passes; ++pass)
+    {
+        writeParams(ctx, params_buf, pass,
+            {
+                .count = count,
+                .num_blocks = blocks,
+                .shift = pass * k_radix_bits,
+                .op = has_values ? 1u : 0u,
+            });
+    }
+    for (u32 pass = 0; pass < passes; ++pass)
+    {
+        WGPUBindGroup group = bind_groups[pass & 1];
+        prims->dispatch(ctx.comp_pass, prims->radix_histogram_pipeline, group, pass, blocks);
+        // same histogram size every pass, so one parameter slot serves all of them
+        hist_scan.record(ctx, k_radix_digits * blocks);
+        prims->dispatch(ctx.comp_pass, prims->radix_scatter_pipeline, group, pass, blocks);
+    }
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include "ComputePrimitivesCpu.h"
+#include "LayoutManagement.h"
+#include "WgpuTypes.h"
+
+namespace wgfx::compute
+{
+    // Data parallel building blocks over u32 words: exclusive scan, reduce, segmented reduce,
+    // stream compaction and LSD radix sort. Kernels live in primitives.wgsl, CPU references with
+    // the same block decomposition in ComputePrimitivesCpu.h.
+    //
+    // Primitives holds pipelines and the bind group layout shared by all kernels. Every *Plan
+    // binds its buffers once at init and records dispatches into ctx.comp_pass, so several plans
+    // can run back to back in one pass. Parameters are queue writes: recording the same plan
+    // twice into one submit runs both with the parameters of the last record.
+    // Scan needs more passes than decoupled look-back, but look-back spins on other workgroups
+    // and WebGPU gives no forward progress guarantee between them, so reduce-then-scan is used.
+
+    struct Params
+    {
+        u32 count = 0;
+        u32 num_blocks = 0;
+        u32 shift = 0;
+        u32 op = 0;
+    };
+    // parameters of one dispatch live in a dynamic offset slot of a plan's uniform buffer
+    static constexpr u32 k_param_stride = 256;
+
+    // buffers of one bind group, null slots are bound to dummies
+    struct Bindings
+    {
+        const GpuBuffer* src = nullptr;
+        const GpuBuffer* dst = nullptr;
+        const GpuBuffer* partials = nullptr;
+        const GpuBuffer* aux = nullptr;
+        const GpuBuffer* src_values = nullptr;
+        const GpuBuffer* dst_values = nullptr;
+    };
+
+    struct Primitives
+    {
+        const char* shader_file = "content/shaders/wgsl/compute/primitives.wgsl";
+        WGPUBindGroupLayout bgl_layout = nullptr;
+        // read only and writable bindings can't share a buffer within a dispatch
+        GpuBuffer dummy_read_buf;
+        GpuBuffer dummy_write_buf;
+
+        wgfx::ComputePipeline block_reduce_data{
+            .label = "prim block reduce",
+            .descriptor = {.entryPoint = "cs_block_reduce"},
+        };
+        wgfx::ComputePipeline scan_partials_data{
+            .label = "prim scan partials",
+            .descriptor = {.entryPoint = "cs_scan_partials"},
+        };
+        wgfx::ComputePipeline scan_blocks_data{
+            .label = "prim scan blocks",
+            .descriptor = {.entryPoint = "cs_scan_blocks"},
+        };
+        wgfx::ComputePipeline reduce_final_data{
+            .label = "prim reduce final",
+            .descriptor = {.entryPoint = "cs_reduce_final"},
+        };
+        wgfx::ComputePipeline segmented_reduce_data{
+            .label = "prim segmented reduce",
+            .descriptor = {.entryPoint = "cs_segmented_reduce"},
+        };
+        wgfx::ComputePipeline compact_scatter_data{
+            .label = "prim compact scatter",
+            .descriptor = {.entryPoint = "cs_compact_scatter"},
+        };
+        wgfx::ComputePipeline radix_histogram_data{
+            .label = "prim radix histogram",
+            .descriptor = {.entryPoint = "cs_radix_histogram"},
+        };
+        wgfx::ComputePipeline radix_scatter_data{
+            .label = "prim radix scatter",
+            .descriptor = {.entryPoint = "cs_radix_scatter"},
+        };
+        WGPUComputePipeline block_reduce_pipeline = nullptr;
+        WGPUComputePipeline scan_partials_pipeline = nullptr;
+        WGPUComputePipeline scan_blocks_pipeline = nullptr;
+        WGPUComputePipeline reduce_final_pipeline = nullptr;
+        WGPUComputePipeline segmented_reduce_pipeline = nullptr;
+        WGPUComputePipeline compact_scatter_pipeline = nullptr;
+        WGPUComputePipeline radix_histogram_pipeline = nullptr;
+        WGPUComputePipeline radix_scatter_pipeline = nullptr;
+
+        void init(const GpuContext& ctx, const vex::TextShaderLib& text_shad_lib);
+        bool reloadShaders(vex::TextShaderLib& shader_lib, const GpuContext& context);
+
+        // 'params_buf' is bound at slot 0 with dynamic offset
+        WGPUBindGroup createBindGroup(
+            WGPUDevice device, const GpuBuffer& params_buf, const Bindings& bindings) const;
+        void dispatch(WGPUComputePassEncoder pass, WGPUComputePipeline pipeline,
+            WGPUBindGroup group, u32 param_slot, u32 num_groups) const;
+
+        void release()
+        {
+            WGPU_REL(BindGroupLayout, bgl_layout);
+            WGPU_REL(ComputePipeline, block_reduce_pipeline);
+            WGPU_REL(ComputePipeline, scan_partials_pipeline);
+            WGPU_REL(ComputePipeline, scan_blocks_pipeline);
+            WGPU_REL(ComputePipeline, reduce_final_pipeline);
+            WGPU_REL(ComputePipeline, segmented_reduce_pipeline);
+            WGPU_REL(ComputePipeline, compact_scatter_pipeline);
+            WGPU_REL(ComputePipeline, radix_histogram_pipeline);
+            WGPU_REL(ComputePipeline, radix_scatter_pipeline);
+            dummy_read_buf.release();
+            dummy_write_buf.release();
+        }
+        bool isValid() const
+        {
+            return bgl_layout && block_reduce_pipeline && scan_partials_pipeline &&
+                   scan_blocks_pipeline && reduce_final_pipeline && segmented_reduce_pipeline &&
+                   compact_scatter_pipeline && radix_histogram_pipeline && radix_scatter_pipeline;
+        }
+    };
+
+    // exclusive sum, 'out' gets count + 1 words, the last one is the total. In place isn't
+    // supported, 'in' and 'out' must differ
+    struct ScanPlan
+    {
+        const Primitives* prims = nullptr;
+        GpuBuffer params_buf;
+        GpuBuffer partials_buf;
+        WGPUBindGroup bind_group = nullptr;
+        u32 max_count = 0;
+
+        void init(const GpuContext& ctx, const Primitives& prims, const GpuBuffer& in,
+            const GpuBuffer& out, u32 max_count);
+        void record(CompContext& ctx, u32 count);
+        void release()
+        {
+            WGPU_REL(BindGroup, bind_group);
+            params_buf.release();
+            partials_buf.release();
+        }
+    };
+
+    // out[0] = op over in[0..count], identity when empty
+    struct ReducePlan
+    {
+        const Primitives* prims = nullptr;
+        GpuBuffer params_buf;
+        GpuBuffer partials_buf;
+        WGPUBindGroup bind_group = nullptr;
+        u32 max_count = 0;
+
+        void init(const GpuContext& ctx, const Primitives& prims, const GpuBuffer& in,
+            const GpuBuffer& out, u32 max_count);
+        void record(CompContext& ctx, u32 count, ReduceOp op);
+        void release()
+        {
+            WGPU_REL(BindGroup, bind_group);
+            params_buf.release();
+            partials_buf.release();
+        }
+    };
+
+    // out[s] = op over values[offsets[s]..offsets[s + 1]], one invocation per segment so it
+    // suits many short segments (cells of a spatial table) and not a few long ones
+    struct SegmentedReducePlan
+    {
+        const Primitives* prims = nullptr;
+        GpuBuffer params_buf;
+        WGPUBindGroup bind_group = nullptr;
+        u32 max_segments = 0;
+
+        void init(const GpuContext& ctx, const Primitives& prims, const GpuBuffer& values,
+            const GpuBuffer& offsets, const GpuBuffer& out, u32 max_segments);
+        void record(CompContext& ctx, u32 num_segments, ReduceOp op);
+        void release()
+        {
+            WGPU_REL(BindGroup, bind_group);
+            params_buf.release();
+        }
+    };
+
+    // values whose flag is 1 (flags are 0 or 1) packed to the front of 'out', order preserved.
+    // Kept count ends up in offsets_buf[count]
+    struct CompactPlan
+    {
+        const Primitives* prims = nullptr;
+        ScanPlan flag_scan;
+        GpuBuffer params_buf;
+        GpuBuffer offsets_buf; // exclusive scan of flags, count + 1 words
+        WGPUBindGroup bind_group = nullptr;
+        u32 max_count = 0;
+
+        void init(const GpuContext& ctx, const Primitives& prims, const GpuBuffer& values,
+            const GpuBuffer& flags, const GpuBuffer& out, u32 max_count);
+        void record(CompContext& ctx, u32 count);
+        void release()
+        {
+            WGPU_REL(BindGroup, bind_group);
+            flag_scan.release();
+            params_buf.release();
+            offsets_buf.release();
+        }
+    };
+
+    // stable LSD sort of u32 keys in place, 'values' (optional) are moved along. Passes ping-pong
+    // through owned temporaries, their number is rounded up to even so results land back in the
+    // caller's buffers
+    struct RadixSortPlan
+    {
+        static constexpr u32 k_max_passes = 32 / k_radix_bits;
+
+        const Primitives* prims = nullptr;
+        ScanPlan hist_scan;
+        GpuBuffer params_buf; // slot per pass
+        GpuBuffer hist_buf;   // digit-major block histograms
+        GpuBuffer offsets_buf;
+        GpuBuffer tmp_keys_buf;
+        GpuBuffer tmp_values_buf;
+        WGPUBindGroup bind_groups[2]{}; // caller -> tmp, tmp -> caller
+        u32 max_count = 0;
+        bool has_values = false;
+
+        void init(const GpuContext& ctx, const Primitives& prims, const GpuBuffer& keys,
+            const GpuBuffer* values, u32 max_count);
+        // keys must be below 1 << key_bits, fewer bits mean fewer passes
+        void record(CompContext& ctx, u32 count, u32 key_bits = 32);
+        void release()
+        {
+            for (WGPUBindGroup& group : bind_groups)
+                WGPU_REL(BindGroup, group);
+            hist_scan.release();
+            params_buf.release();
+            hist_buf.release();
+            offsets_buf.release();
+            tmp_keys_buf.release();
+            tmp_values_buf.release();
+        }
+    };
+} // namespace wgfx::compute
@@ -0,0 +1,136 @@
+#pragma once
+#include <VCore/Utils/CoreTemplates.h>
+#include <VCore/Utils/VUtilsBase.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace wgfx::compute
+{
+    // CPU references of ComputePrimitives.h. They run the same block decomposition as the
+    // kernels of primitives.wgsl (block partials, digit-major radix histograms, stable in-block
+    // ranks) so tests cover the algorithm and not only the result, and benches have a baseline.
+
+    static constexpr u32 k_block_items = 1024; // items per workgroup, 256 invocations x 4
+    static constexpr u32 k_radix_bits = 4;
+    static constexpr u32 k_radix_digits = 1u << k_radix_bits;
+
+    enum class ReduceOp : u32
+    {
+        k_sum,
+        k_min,
+        k_max,
+    };
+
+    constexpr u32 identity(ReduceOp op) { return op == ReduceOp::k_min ? ~0u : 0u; }
+    constexpr u32 combine(ReduceOp op, u32 a, u32 b)
+    {
+        switch (op)
+        {
+        case ReduceOp::k_min: return a < b ? a : b;
+        case ReduceOp::k_max: return a > b ? a : b;
+        default: return a + b;
+        }
+    }
+    constexpr u32 numBlocks(u32 count) { return (count + k_block_items - 1) / k_block_items; }
+
+    namespace ref
+    {
+        inline void blockReduce(ROSpan<u32> in, ReduceOp op, std::vector<u32>& partials)
+        {
+            partials.assign(numBlocks(in.len), identity(op));
+            for (u32 i = 0; i < in.len; ++i)
+                partials[i / k_block_items] = combine(op, partials[i / k_block_items], in.data[i]);
+        }
+
+        // reduce-then-scan, 'out' holds in.len + 1 values, the last one is the total
+        inline u32 exclusiveScan(ROSpan<u32> in, u32* out)
+        {
+            std::vector<u32> partials;
+            blockReduce(in, ReduceOp::k_sum, partials);
+            u32 run = 0;
+            for (u32& p : partials)
+            {
+                const u32 block_sum = p;
+                p = run;
+                run += block_sum;
+            }
+            for (u32 b = 0; b < (u32)partials.size(); ++b)
+            {
+                u32 offset = partials[b];
+                const u32 end = std::min((b + 1) * k_block_items, in.len);
+                for (u32 i = b * k_block_items; i < end; ++i)
+                {
+                    out[i] = offset;
+                    offset += in.data[i];
+                }
+            }
+            out[in.len] = run;
+            return run;
+        }
+
+        inline u32 reduce(ROSpan<u32> in, ReduceOp op)
+        {
+            std::vector<u32> partials;
+            blockReduce(in, op, partials);
+            u32 out = identity(op);
+            for (u32 p : partials)
+                out = combine(op, out, p);
+            return out;
+        }
+
+        // segment s is values[offsets[s]..offsets[s + 1]], empty segments give identity
+        inline void segmentedReduce(
+            ROSpan<u32> values, ROSpan<u32> offsets, ReduceOp op, u32* out)
+        {
+            for (u32 s = 0; s + 1 < offsets.len; ++s)
+            {
+                u32 acc = identity(op);
+                for (u32 i = offsets.data[s]; i < offsets.data[s + 1]; ++i)
+                    acc = combine(op, acc, values.data[i]);
+                out[s] = acc;
+            }
+        }
+
+        // keeps values whose flag is 1 (flags are 0 or 1), order preserved. Returns kept count
+        inline u32 compact(ROSpan<u32> values, ROSpan<u32> flags, u32* out)
+        {
+            std::vector<u32> offsets(flags.len + 1);
+            const u32 kept = exclusiveScan(flags, offsets.data());
+            for (u32 i = 0; i < values.len; ++i)
+                if (offsets[i + 1] != offsets[i])
+                    out[offsets[i]] = values.data[i];
+            return kept;
+        }
+
+        // LSD radix sort, k_radix_bits per pass, stable. 'values' is optional and follows keys
+        inline void radixSort(std::vector<u32>& keys, std::vector<u32>* values = nullptr)
+        {
+            const u32 count = (u32)keys.size();
+            const u32 blocks = numBlocks(count);
+            std::vector<u32> tmp_keys(count);
+            std::vector<u32> tmp_values(values ? count : 0);
+            std::vector<u32> hist(k_radix_digits * blocks + 1);
+            std::vector<u32> offsets(hist.size());
+            for (u32 shift = 0; shift < 32; shift += k_radix_bits)
+            {
+                auto digit = [&](u32 key) { return (key >> shift) & (k_radix_digits - 1); };
+                // digit-major, so one scan gives every block its output offset per digit
+                std::fill(hist.begin(), hist.end(), 0);
+                for (u32 i = 0; i < count; ++i)
+                    hist[digit(keys[i]) * blocks + i / k_block_items]++;
+                exclusiveScan({hist.data(), (u32)hist.size() - 1}, offsets.data());
+                for (u32 i = 0; i < count; ++i)
+                {
+                    const u32 dst = offsets[digit(keys[i]) * blocks + i / k_block_items]++;
+                    tmp_keys[dst] = keys[i];
+                    if (values)
+                        tmp_values[dst] = (*values)[i];
+                }
+                keys.swap(tmp_keys);
+                if (values)
+                    values->swap(tmp_values);
+            }
+        }
+    } // namespace ref
+} // namespace wgfx::compute
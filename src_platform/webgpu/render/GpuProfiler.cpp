@@ -0,0 +1,89 @@
+#include "GpuProfiler.h"
+
+void wgfx::GpuProfiler::init(const GpuContext& ctx, const Globals& globals)
+{
+    enabled = globals.has_timestamps_in_passes;
+    if (!enabled)
+    {
+        SPDLOG_WARN("gpu profiler: timestamp queries inside passes not supported, disabled");
+        return;
+    }
+
+    WGPUQuerySetDescriptor desc{
+        .label = "profiler queries",
+        .type = WGPUQueryType_Timestamp,
+        .count = k_max_scopes * 2,
+    };
+    query_set = wgpuDeviceCreateQuerySet(ctx.device, &desc);
+    const u32 size = k_max_scopes * 2 * sizeof(u64);
+    resolve_buf = GpuBuffer::create(ctx.device, {
+                                                    .label = "profiler resolve",
+                                                    .usage = WGPUBufferUsage_QueryResolve |
+                                                             WGPUBufferUsage_CopySrc,
+                                                    .size = size,
+                                                });
+    ring.init(ctx.device, size, 3, "profiler readback");
+}
+
+void wgfx::GpuProfiler::beginScope(WGPUComputePassEncoder pass, u32 scope)
+{
+    if (!isValid() || !checkAlwaysRel(scope < k_max_scopes, "profiler scope out of range"))
+        return;
+    wgpuComputePassEncoderWriteTimestamp(pass, query_set, scope * 2);
+}
+
+void wgfx::GpuProfiler::endScope(WGPUComputePassEncoder pass, u32 scope)
+{
+    if (!isValid() || scope >= k_max_scopes)
+        return;
+    wgpuComputePassEncoderWriteTimestamp(pass, query_set, scope * 2 + 1);
+    written_mask |= 1u << scope;
+}
+
+void wgfx::GpuProfiler::resolve(WGPUCommandEncoder encoder)
+{
+    if (!isValid() || written_mask == 0)
+        return;
+    defer_ { written_mask = 0; };
+    for (auto& it : in_flight)
+    {
+        if (it.ticket.isValid())
+            continue;
+        wgpuCommandEncoderResolveQuerySet(
+            encoder, query_set, 0, k_max_scopes * 2, resolve_buf.buffer, 0);
+        it.ticket = ring.request(encoder, resolve_buf.buffer, 0, resolve_buf.desc.size);
+        it.mask = written_mask;
+        return;
+    }
+}
+
+void wgfx::GpuProfiler::readback()
+{
+    if (!isValid())
+        return;
+    ring.submitted();
+    for (auto& it : in_flight)
+    {
+        if (!it.ticket.isValid() || ring.isPending(it.ticket))
+            continue;
+        ROSpan<u8> bytes = ring.tryGet(it.ticket);
+        auto* stamps = reinterpret_cast<const u64*>(bytes.data);
+        for (u32 i = 0; bytes.len > 0 && i < k_max_scopes; ++i)
+        {
+            if ((it.mask & (1u << i)) == 0)
+                continue;
+            const u64 begin = stamps[i * 2];
+            const u64 end = stamps[i * 2 + 1];
+            results_ms[i] = end > begin ? (end - begin) / 1'000'000.0 : 0.0;
+        }
+        ring.release(it.ticket);
+    }
+}
+
+void wgfx::GpuProfiler::release()
+{
+    WGPU_REL(QuerySet, query_set);
+    resolve_buf.release();
+    ring.release();
+    enabled = false;
+}
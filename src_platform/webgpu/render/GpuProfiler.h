@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ReadbackRing.h"
+#include "WgpuTypes.h"
+
+namespace wgfx
+{
+    // GPU timestamps for a handful of named scopes inside compute passes. Results come back
+    // through ReadbackRing a few frames later, the profiler never waits on GPU: when all
+    // readback slots are busy that frame's timings are just dropped.
+    // Requires TimestampQueryInsidePasses, without it all scopes report 0.
+    struct GpuProfiler
+    {
+        static constexpr u32 k_max_scopes = 8;
+
+        WGPUQuerySet query_set = nullptr;
+        GpuBuffer resolve_buf;
+        ReadbackRing ring;
+        bool enabled = false;
+
+        void init(const GpuContext& ctx, const Globals& globals);
+
+        void beginScope(WGPUComputePassEncoder pass, u32 scope);
+        void endScope(WGPUComputePassEncoder pass, u32 scope);
+        // call once per frame after last scope was closed, before encoder is finished
+        void resolve(WGPUCommandEncoder encoder);
+        // call after the command buffer with resolve() was submitted
+        void readback();
+
+        // last known duration of scope in milliseconds
+        f64 scopeMs(u32 scope) const { return scope < k_max_scopes ? results_ms[scope] : 0.0; }
+        bool isValid() const { return enabled && query_set && ring.isValid(); }
+        void release();
+
+      private:
+        struct InFlight
+        {
+            ReadbackRing::Ticket ticket;
+            u32 mask = 0;
+        };
+        f64 results_ms[k_max_scopes]{};
+        u32 written_mask = 0;
+        InFlight in_flight[ReadbackRing::k_max_slots];
+    };
+} // namespace wgfx
@@ -247,25 +247,43 @@ namespace wgfx
             group_builder.add(buf);
             return *this;
         }
-        inline BGLCombinedBuilder& addTexView(
-            WGPUTextureView view, WGPUTextureBindingLayout tex_layout = def_tex_layout)
+        inline BGLCombinedBuilder& addTexView(WGPUTextureView view,
+            WGPUTextureBindingLayout tex_layout = def_tex_layout,
+            WGPUShaderStageFlags visibility = WGPUShaderStage_Fragment)
         {
             layout_builder.add(WGPUBindGroupLayoutEntry{
-                .visibility = WGPUShaderStage_Fragment,
+                .visibility = visibility,
                 .texture = tex_layout,
             });
             group_builder.add(view);
             return *this;
         }
-        inline BGLCombinedBuilder& addSampler(WGPUSampler sampler)
+        inline BGLCombinedBuilder& addSampler(
+            WGPUSampler sampler, WGPUShaderStageFlags visibility = WGPUShaderStage_Fragment)
         {
             layout_builder.add(WGPUBindGroupLayoutEntry{
-                .visibility = WGPUShaderStage_Fragment,
+                .visibility = visibility,
                 .sampler = {.type = WGPUSamplerBindingType_Filtering},
             });
             group_builder.add(sampler);
             return *this;
         }
+        // write only, 2D
+        inline BGLCombinedBuilder& addStorageTexture(WGPUTextureView view,
+            WGPUTextureFormat format, WGPUShaderStageFlags visibility = WGPUShaderStage_Compute)
+        {
+            layout_builder.add(WGPUBindGroupLayoutEntry{
+                .visibility = visibility,
+                .storageTexture =
+                    {
+                        .access = WGPUStorageTextureAccess_WriteOnly,
+                        .format = format,
+                        .viewDimension = WGPUTextureViewDimension_2D,
+                    },
+            });
+            group_builder.add(view);
+            return *this;
+        }
         // will override binding
         inline BGLCombinedBuilder& add(
             WGPUBindGroupEntry bg_entry, WGPUBindGroupLayoutEntry layout_entry)
@@ -338,6 +356,7 @@ namespace wgfx
     };
     struct ComputePipeline
     {
+        static constexpr u32 k_max_constants = 8;
         const char* label = "compute";
         WGPUProgrammableStageDescriptor descriptor{
             .nextInChain = nullptr,
@@ -346,6 +365,22 @@ namespace wgfx
             .constantCount = 0,
             .constants = nullptr,
         };
+        // 0 keeps size written in shader, otherwise passed as 'wg_size' override constant which
+        // shader uses in @workgroup_size. See WorkgroupTuning
+        u32 workgroup_size = 0;
+
+        // workgroups covering 'items' invocations of 1D kernel
+        inline u32 groups(u32 items) const
+        {
+            check_(workgroup_size > 0);
+            return (items + workgroup_size - 1) / workgroup_size;
+        }
+        inline void dispatch(
+            WGPUComputePassEncoder pass, WGPUComputePipeline pipeline, u32 items) const
+        {
+            wgpuComputePassEncoderSetPipeline(pass, pipeline);
+            wgpuComputePassEncoderDispatchWorkgroups(pass, groups(items), 1, 1);
+        }
 
         inline WGPUComputePipeline createPipeline(
             const GpuContext& context, WGPUShaderModule shader, WGPUBindGroupLayout layout)
@@ -358,10 +393,11 @@ namespace wgfx
             check_(pipeline_layout);
             descriptor.module = shader;
             check_(descriptor.module);
+            WGPUConstantEntry constants[k_max_constants];
             WGPUComputePipelineDescriptor pipeline_desc{
                 .label = label,
                 .layout = pipeline_layout,
-                .compute = descriptor,
+                .compute = withWorkgroupSize(constants),
             };
             auto pl = wgpuDeviceCreateComputePipeline(context.device, &pipeline_desc);
             check_(pl);
@@ -378,15 +414,33 @@ namespace wgfx
             check_(pipeline_layout);
             descriptor.module = shader;
             check_(descriptor.module);
+            WGPUConstantEntry constants[k_max_constants];
             WGPUComputePipelineDescriptor pipeline_desc{
                 .label = label,
                 .layout = pipeline_layout,
-                .compute = descriptor,
+                .compute = withWorkgroupSize(constants),
             };
             auto pl = wgpuDeviceCreateComputePipeline(context.device, &pipeline_desc);
             check_(pl);
             return pl;
         }
+
+      private:
+        // descriptor plus 'wg_size' constant, 'storage' backs constants of returned copy
+        inline WGPUProgrammableStageDescriptor withWorkgroupSize(
+            WGPUConstantEntry (&storage)[k_max_constants]) const
+        {
+            if (workgroup_size == 0)
+                return descriptor;
+            check_(descriptor.constantCount < k_max_constants);
+            WGPUProgrammableStageDescriptor out = descriptor;
+            for (u32 i = 0; i < descriptor.constantCount; ++i)
+                storage[i] = descriptor.constants[i];
+            storage[descriptor.constantCount] = {.key = "wg_size", .value = f64(workgroup_size)};
+            out.constantCount = descriptor.constantCount + 1;
+            out.constants = storage;
+            return out;
+        }
     };
 
 } // namespace wgfx
@@ -0,0 +1,119 @@
+#include "ReadbackRing.h"
+
+void wgfx::ReadbackRing::init(WGPUDevice device, u32 slot_size, u32 in_num_slots, const char* label)
+{
+    check_(in_num_slots > 0 && in_num_slots <= k_max_slots);
+    num_slots = in_num_slots;
+    for (u32 i = 0; i < num_slots; ++i)
+    {
+        slots[i].buf = GpuBuffer::create(device, {
+                                                     .label = label,
+                                                     .usage = WGPUBufferUsage_CopyDst |
+                                                              WGPUBufferUsage_MapRead,
+                                                     .size = slot_size,
+                                                 });
+        slots[i].state = SlotState::Free;
+    }
+}
+
+wgfx::ReadbackRing::Ticket wgfx::ReadbackRing::request(
+    WGPUCommandEncoder encoder, WGPUBuffer src, u64 offset, u64 size)
+{
+    for (u32 n = 0; n < num_slots; ++n)
+    {
+        const u32 i = (next_slot + n) % num_slots;
+        Slot& slot = slots[i];
+        if (slot.state != SlotState::Free)
+            continue;
+        if (!checkAlwaysRel(size <= slot.buf.desc.size && size % 4 == 0, "invalid readback size"))
+            return {};
+
+        wgpuCommandEncoderCopyBufferToBuffer(encoder, src, offset, slot.buf.buffer, 0, size);
+        slot.size = size;
+        slot.failed = false;
+        slot.dropped = false;
+        slot.generation++;
+        slot.state = SlotState::Recorded;
+        next_slot = (i + 1) % num_slots;
+        return {.slot = i, .generation = slot.generation};
+    }
+    return {};
+}
+
+void wgfx::ReadbackRing::submitted()
+{
+    for (u32 i = 0; i < num_slots; ++i)
+    {
+        Slot& slot = slots[i];
+        if (slot.state != SlotState::Recorded)
+            continue;
+        slot.state = SlotState::Mapping;
+        auto on_mapped = [](WGPUBufferMapAsyncStatus status, void* userdata)
+        {
+            auto* slot = reinterpret_cast<Slot*>(userdata);
+            slot->failed = status != WGPUBufferMapAsyncStatus_Success;
+            if (slot->dropped)
+            {
+                if (!slot->failed)
+                    wgpuBufferUnmap(slot->buf.buffer);
+                slot->state = SlotState::Free;
+                return;
+            }
+            slot->state = SlotState::Ready;
+        };
+        wgpuBufferMapAsync(slot.buf.buffer, WGPUMapMode_Read, 0, slot.size, on_mapped, &slot);
+    }
+}
+
+bool wgfx::ReadbackRing::isReady(Ticket ticket) const
+{
+    return owns(ticket) && slots[ticket.slot].state == SlotState::Ready;
+}
+
+bool wgfx::ReadbackRing::isPending(Ticket ticket) const
+{
+    if (!owns(ticket))
+        return false;
+    const SlotState state = slots[ticket.slot].state;
+    return state == SlotState::Recorded || state == SlotState::Mapping;
+}
+
+ROSpan<u8> wgfx::ReadbackRing::tryGet(Ticket ticket) const
+{
+    if (!isReady(ticket))
+        return {};
+    const Slot& slot = slots[ticket.slot];
+    if (slot.failed)
+        return {};
+    auto* data = (const u8*)wgpuBufferGetConstMappedRange(slot.buf.buffer, 0, slot.size);
+    return {data, data ? (u32)slot.size : 0};
+}
+
+void wgfx::ReadbackRing::release(Ticket& ticket)
+{
+    defer_ { ticket = {}; };
+    if (!owns(ticket))
+        return;
+    Slot& slot = slots[ticket.slot];
+    switch (slot.state.load())
+    {
+        case SlotState::Ready:
+            if (!slot.failed)
+                wgpuBufferUnmap(slot.buf.buffer);
+            slot.state = SlotState::Free;
+            break;
+        case SlotState::Recorded: // copy is already in an encoder, map callback frees it
+        case SlotState::Mapping: slot.dropped = true; break;
+        default: break;
+    }
+}
+
+void wgfx::ReadbackRing::release()
+{
+    for (u32 i = 0; i < num_slots; ++i)
+    {
+        slots[i].buf.release();
+        slots[i].state = SlotState::Free;
+    }
+    num_slots = 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "WgpuTypes.h"
+
+#include <atomic>
+
+namespace wgfx
+{
+    // GPU -> CPU copies that never stall the queue. Consumer asks for a copy with request(),
+    // copy is recorded into the frame encoder, map starts after submit and the ticket resolves
+    // a few frames later. Nothing is copied unless asked for; when all slots are busy request
+    // fails and consumer simply tries again next frame.
+    struct ReadbackRing
+    {
+        static constexpr u32 k_max_slots = 4;
+        struct Ticket
+        {
+            u32 slot = ~0u;
+            u32 generation = 0;
+            bool isValid() const { return slot != ~0u; }
+        };
+
+        ReadbackRing() = default;
+        ReadbackRing(const ReadbackRing&) = delete;
+
+        // every slot can hold up to 'slot_size' bytes
+        void init(WGPUDevice device, u32 slot_size, u32 num_slots = k_max_slots,
+            const char* label = "readback slot");
+
+        // records copy into first free slot, returns invalid ticket if none is free
+        Ticket request(WGPUCommandEncoder encoder, WGPUBuffer src, u64 offset, u64 size);
+        // call after command buffer with request() calls was submitted, starts the maps
+        void submitted();
+
+        bool isReady(Ticket ticket) const;
+        bool isPending(Ticket ticket) const;
+        // mapped bytes of ready ticket, empty while pending. Valid until release(ticket)
+        ROSpan<u8> tryGet(Ticket ticket) const;
+        // unmaps slot and makes it available again, also drops tickets that are still pending
+        void release(Ticket& ticket);
+
+        bool isValid() const { return num_slots > 0; }
+        void release();
+
+      private:
+        enum class SlotState : u32
+        {
+            Free,
+            Recorded, // copy recorded, waiting for submit
+            Mapping,
+            Ready,
+        };
+        struct Slot
+        {
+            GpuBuffer buf;
+            std::atomic<SlotState> state = SlotState::Free;
+            u32 generation = 0;
+            u64 size = 0;
+            bool failed = false;
+            bool dropped = false; // released before map finished, freed by map callback
+        };
+        bool owns(Ticket ticket) const
+        {
+            return ticket.slot < num_slots && slots[ticket.slot].generation == ticket.generation;
+        }
+
+        Slot slots[k_max_slots];
+        u32 num_slots = 0;
+        u32 next_slot = 0;
+    };
+} // namespace wgfx
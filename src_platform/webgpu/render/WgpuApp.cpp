@@ -55,13 +55,34 @@ struct WgpuRenderInterface
 
             wgpuAdapterGetLimits(globals.adapter, &limits);
 
-            // WGPURequiredLimits required{.limits = limits.limits};
+            // request profiling features only when present, device creation fails otherwise
+            WGPUFeatureName features[2]{};
+            u32 num_features = 0;
+            if (wgpuAdapterHasFeature(globals.adapter, WGPUFeatureName_TimestampQuery))
+            {
+                features[num_features++] = WGPUFeatureName_TimestampQuery;
+                globals.has_timestamps = true;
+#ifdef VEX_GFX_WEBGPU_DAWN
+                if (wgpuAdapterHasFeature(
+                        globals.adapter, WGPUFeatureName_TimestampQueryInsidePasses))
+                {
+                    features[num_features++] = WGPUFeatureName_TimestampQueryInsidePasses;
+                    globals.has_timestamps_in_passes = true;
+                }
+#endif
+            }
+
+            // large particle counts need more than default 128MB storage bindings
+            WGPURequiredLimits required{.limits = limits.limits};
             WGPUDeviceDescriptor deviceDesc{
                 .label = "wgpu device",
-                //.requiredLimits = &required,
+                .requiredFeaturesCount = num_features,
+                .requiredFeatures = features,
+                .requiredLimits = &required,
                 .defaultQueue = {.label = "The default queue"},
             };
             wgfx::requestDevice(globals, &deviceDesc);
+            wgpuDeviceGetLimits(globals.device, &globals.limits);
 
             auto onDeviceError = [](WGPUErrorType type, char const* message, void*)
             {
@@ -149,6 +149,46 @@ void wgfx::wgpuPollWait(
     }
 }
 
+bool wgfx::readBufferBlocking(
+    const GpuContext& context, WGPUBuffer src, u64 offset, u64 size, void* out_data)
+{
+    const u64 aligned_size = (size + 3) & ~3ull;
+    WGPUBufferDescriptor desc{
+        .label = "blocking readback",
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead,
+        .size = aligned_size,
+        .mappedAtCreation = false,
+    };
+    WGPUBuffer staging = wgpuDeviceCreateBuffer(context.device, &desc);
+    defer_ { WGPU_REL(Buffer, staging); };
+
+    auto encoder = wgpuDeviceCreateCommandEncoder(context.device, nullptr);
+    wgpuCommandEncoderCopyBufferToBuffer(encoder, src, offset, staging, 0, aligned_size);
+    auto cmd_buf = wgpuCommandEncoderFinish(encoder, nullptr);
+    wgpuQueueSubmit(context.queue, 1, &cmd_buf);
+    WGPU_REL(CommandBuffer, cmd_buf);
+    WGPU_REL(CommandEncoder, encoder);
+
+    std::atomic_bool sync_ready = ATOMIC_VAR_INIT(false);
+    bool success = false;
+    wgpuRequest(
+        wgpuBufferMapAsync,
+        [&](WGPUBufferMapAsyncStatus status, void*)
+        {
+            success = status == WGPUBufferMapAsyncStatus_Success;
+            sync_ready = true;
+        },
+        staging, WGPUMapMode_Read, (size_t)0, (size_t)aligned_size);
+    wgpuPollWait(context, sync_ready);
+    if (!checkAlwaysRel(success, "buffer map failed"))
+        return false;
+
+    const void* mapped = wgpuBufferGetConstMappedRange(staging, 0, aligned_size);
+    std::memcpy(out_data, mapped, size);
+    wgpuBufferUnmap(staging);
+    return true;
+}
+
 WGPUInstance wgfx::createInstance(WGPUInstanceDescriptor desc)
 {
     return k_using_emscripten ? nullptr : wgpuCreateInstance(&desc);
@@ -60,6 +60,10 @@ namespace wgfx
     // microsec_timeout < 0 => no timeout
     void wgpuPollWait(
         const struct GpuContext& context, std::atomic_bool& flag, double microsec_timeout = -1);
+    // copies 'size' bytes through temporary MapRead buffer and waits for the map, meant for
+    // tests and benchmarks only - stalls the queue
+    bool readBufferBlocking(const struct GpuContext& context, WGPUBuffer src, u64 offset, u64 size,
+        void* out_data);
     WGPUInstance createInstance(WGPUInstanceDescriptor desc);
     void requestDevice(Globals& globals, WGPUDeviceDescriptor const* descriptor);
     void requestAdapter(Globals& globals, WGPURequestAdapterOptions& options);
@@ -106,6 +110,11 @@ namespace wgfx
 
         WGPUSwapChain swap_chain = nullptr;
         WGPUTextureFormat main_texture_fmt{};
+        // optional features granted at device creation
+        bool has_timestamps = false;
+        bool has_timestamps_in_passes = false;
+        // limits of the device, adapter maximums are requested
+        WGPUSupportedLimits limits{};
 
         //WGPUPipelineLayout debug_layout = nullptr;
         //WGPURenderPipeline debug_pipeline = nullptr;
@@ -0,0 +1,108 @@
+#include "WorkgroupTuning.h"
+
+#include <ini.h>
+#include <spdlog/stopwatch.h>
+
+#include <algorithm>
+
+using namespace std::literals::chrono_literals;
+
+namespace
+{
+    constexpr u32 k_dispatches_per_batch = 16;
+    constexpr u32 k_timed_batches = 3;
+} // namespace
+
+std::string wgfx::WorkgroupTuning::adapterKey(WGPUAdapter adapter)
+{
+    WGPUAdapterProperties props{};
+    wgpuAdapterGetProperties(adapter, &props);
+    return fmt::format("{:04x}:{:04x} {}", props.vendorID, props.deviceID,
+        props.name ? props.name : "unknown");
+}
+
+bool wgfx::WorkgroupTuning::load(const char* path, const std::string& adapter_key)
+{
+    adapter = adapter_key;
+    sizes.clear();
+    mINI::INIFile file(path);
+    mINI::INIStructure ini;
+    if (!file.read(ini) || !ini.has(k_section))
+        return false;
+    auto& section = ini[k_section];
+    if (section.get("adapter") != adapter_key)
+        return false;
+    for (auto& [key, value] : section)
+    {
+        if (key == "adapter")
+            continue;
+        const u32 size = (u32)std::strtoul(value.c_str(), nullptr, 10);
+        if (std::find(std::begin(k_candidates), std::end(k_candidates), size) !=
+            std::end(k_candidates))
+            sizes[key] = size;
+    }
+    return true;
+}
+
+bool wgfx::WorkgroupTuning::save(const char* path) const
+{
+    mINI::INIFile file(path);
+    mINI::INIStructure ini;
+    file.read(ini);
+    ini.remove(k_section);
+    auto& section = ini[k_section];
+    section["adapter"] = adapter;
+    for (const auto& [label, size] : sizes)
+        section[label] = std::to_string(size);
+    return file.generate(ini);
+}
+
+u32 wgfx::WorkgroupTuning::tune(const GpuContext& ctx, const KernelArgs& args)
+{
+    check_(args.data && args.shader && args.layout && args.bind_group && args.sync_buf);
+    u32 best_size = k_default_size;
+    f64 best_ms = 0;
+    for (u32 size : k_candidates)
+    {
+        args.data->workgroup_size = size;
+        WGPUComputePipeline pipeline = args.data->createPipeline(ctx, args.shader, args.layout);
+        defer_ { WGPU_REL(ComputePipeline, pipeline); };
+
+        auto runBatch = [&]()
+        {
+            auto encoder = wgpuDeviceCreateCommandEncoder(ctx.device, nullptr);
+            auto pass = wgpuCommandEncoderBeginComputePass(encoder, nullptr);
+            wgpuComputePassEncoderSetBindGroup(pass, 0, args.bind_group, 0, nullptr);
+            for (u32 i = 0; i < k_dispatches_per_batch; ++i)
+                args.data->dispatch(pass, pipeline, args.items);
+            wgpuComputePassEncoderEnd(pass);
+            WGPU_REL(ComputePassEncoder, pass);
+            auto cmd_buf = wgpuCommandEncoderFinish(encoder, nullptr);
+            wgpuQueueSubmit(ctx.queue, 1, &cmd_buf);
+            WGPU_REL(CommandBuffer, cmd_buf);
+            WGPU_REL(CommandEncoder, encoder);
+            // readback waits for the batch, so time includes GPU execution
+            u32 probe = 0;
+            readBufferBlocking(ctx, args.sync_buf->buffer, 0, sizeof(probe), &probe);
+        };
+        runBatch(); // warm up, first run pays for pipeline compilation
+        f64 size_ms = 0;
+        for (u32 b = 0; b < k_timed_batches; ++b)
+        {
+            spdlog::stopwatch sw;
+            runBatch();
+            const f64 ms = sw.elapsed() / 1ms;
+            size_ms = b == 0 ? ms : std::min(size_ms, ms);
+        }
+        if (best_ms == 0 || size_ms < best_ms)
+        {
+            best_ms = size_ms;
+            best_size = size;
+        }
+    }
+    args.data->workgroup_size = best_size;
+    sizes[args.data->label] = best_size;
+    SPDLOG_INFO("workgroup size of '{}': {} ({:.3f} ms per {} dispatches of {} items)",
+        args.data->label, best_size, best_ms, k_dispatches_per_batch, args.items);
+    return best_size;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "LayoutManagement.h"
+#include "WgpuTypes.h"
+
+#include <map>
+#include <string>
+
+namespace wgfx
+{
+    // Workgroup sizes of 1D kernels picked by timing on the current adapter. Kernels declare
+    // 'override wg_size' and use it in @workgroup_size, owners set ComputePipeline::workgroup_size
+    // from sizeOr() and dispatch with ComputePipeline::groups(). Measured once, then kept in
+    // cfg.ini until the adapter changes.
+    struct WorkgroupTuning
+    {
+        static constexpr u32 k_candidates[] = {32, 64, 128, 256};
+        static constexpr u32 k_default_size = 64;
+        static constexpr const char* k_section = "workgroup_sizes";
+
+        std::string adapter;           // sizes are valid only for this one
+        std::map<std::string, u32> sizes; // by pipeline label
+
+        // identifies adapter in cfg.ini, vendor, device and name
+        static std::string adapterKey(WGPUAdapter adapter);
+
+        // false when file has no sizes measured on 'adapter_key', sizes are cleared then
+        bool load(const char* path, const std::string& adapter_key);
+        // keeps other sections of the file
+        bool save(const char* path) const;
+
+        u32 sizeOr(const char* label, u32 fallback = k_default_size) const
+        {
+            auto it = sizes.find(label);
+            return it != sizes.end() ? it->second : fallback;
+        }
+
+        struct KernelArgs
+        {
+            ComputePipeline* data = nullptr; // label names the kernel, workgroup_size is set
+            WGPUShaderModule shader = nullptr;
+            WGPUBindGroupLayout layout = nullptr;
+            WGPUBindGroup bind_group = nullptr;
+            u32 items = 0;                   // invocations of one dispatch
+            const GpuBuffer* sync_buf = nullptr; // any CopySrc buffer, readback waits for queue
+        };
+        // builds kernel with every candidate size, times batches of dispatches and keeps the
+        // fastest. Kernel must tolerate repeated runs on whatever its bindings hold. Stalls
+        u32 tune(const GpuContext& ctx, const KernelArgs& args);
+    };
+} // namespace wgfx
@@ -0,0 +1,116 @@
+#include <webgpu/render/ComputePrimitivesCpu.h>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "../config.h"
+//
+using namespace wgfx::compute;
+
+// CPU references (ref::) only, the test binary has no WebGPU device. The kernels themselves are
+// compared word by word against these references by 'bench: compute primitives' of the
+// pathfinder demo, which reports how many words differ.
+// ============================================================
+namespace
+{
+	// empty, single item, one block, block edges and several blocks with a partial one
+	constexpr u32 test_sizes[] = {0, 1, 1023, 1024, 1025, 5000};
+
+	std::vector<u32> randomWords(u32 count, u32 seed, u32 mask = ~0u)
+	{
+		std::vector<u32> out(count);
+		for (u32& v : out)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			v = (seed ^ (seed >> 15)) & mask;
+		}
+		return out;
+	}
+} // namespace
+
+TEST_CASE("Reference exclusive scan matches std and ends with the total", "[compute]")
+{
+	for (u32 count : test_sizes)
+	{
+		const std::vector<u32> in = randomWords(count, count + 1, 0xff);
+		std::vector<u32> expected(count + 1, 0);
+		std::exclusive_scan(in.begin(), in.end(), expected.begin(), 0u);
+		expected[count] = std::accumulate(in.begin(), in.end(), 0u);
+
+		std::vector<u32> out(count + 1, ~0u);
+		const u32 total = ref::exclusiveScan({in.data(), count}, out.data());
+		REQUIRE(total == expected[count]);
+		REQUIRE(out == expected);
+	}
+}
+
+TEST_CASE("Reference reduce gives identity for empty input", "[compute]")
+{
+	for (u32 count : test_sizes)
+	{
+		const std::vector<u32> in = randomWords(count, count + 3);
+		const ROSpan<u32> span{in.data(), count};
+		REQUIRE(ref::reduce(span, ReduceOp::k_min) ==
+				(count ? *std::min_element(in.begin(), in.end()) : ~0u));
+		REQUIRE(ref::reduce(span, ReduceOp::k_max) ==
+				(count ? *std::max_element(in.begin(), in.end()) : 0u));
+		REQUIRE(ref::reduce(span, ReduceOp::k_sum) == std::accumulate(in.begin(), in.end(), 0u));
+	}
+}
+
+TEST_CASE("Reference segmented reduce handles empty and block crossing segments", "[compute]")
+{
+	const std::vector<u32> values = randomWords(3000, 11, 0xffff);
+	const std::vector<u32> offsets = {0, 0, 1, 1000, 1000, 2500, 3000};
+	std::vector<u32> out(offsets.size() - 1);
+	ref::segmentedReduce({values.data(), (u32)values.size()}, {offsets.data(), (u32)offsets.size()},
+		ReduceOp::k_max, out.data());
+	for (u32 s = 0; s + 1 < (u32)offsets.size(); ++s)
+	{
+		const auto first = values.begin() + offsets[s];
+		const auto last = values.begin() + offsets[s + 1];
+		REQUIRE(out[s] == (first == last ? 0u : *std::max_element(first, last)));
+	}
+}
+
+TEST_CASE("Reference compact keeps flagged values in order", "[compute]")
+{
+	for (u32 count : test_sizes)
+	{
+		const std::vector<u32> values = randomWords(count, count + 5);
+		std::vector<u32> flags = randomWords(count, count + 7, 1);
+		std::vector<u32> expected;
+		for (u32 i = 0; i < count; ++i)
+			if (flags[i])
+				expected.push_back(values[i]);
+
+		std::vector<u32> out(count, ~0u);
+		const u32 kept = ref::compact({values.data(), count}, {flags.data(), count}, out.data());
+		REQUIRE(kept == (u32)expected.size());
+		out.resize(kept);
+		REQUIRE(out == expected);
+	}
+}
+
+TEST_CASE("Reference radix sort matches std and keeps equal keys stable", "[compute]")
+{
+	for (u32 count : test_sizes)
+	{
+		// few distinct keys, so stability is actually exercised
+		std::vector<u32> keys = randomWords(count, count + 9, 0x3f0000f);
+		std::vector<u32> values(count);
+		std::iota(values.begin(), values.end(), 0u);
+
+		std::vector<u32> order = values;
+		std::stable_sort(
+			order.begin(), order.end(), [&](u32 a, u32 b) { return keys[a] < keys[b]; });
+		std::vector<u32> expected_keys(count);
+		for (u32 i = 0; i < count; ++i)
+			expected_keys[i] = keys[order[i]];
+
+		ref::radixSort(keys, &values);
+		REQUIRE(keys == expected_keys);
+		REQUIRE(values == order);
+	}
+}
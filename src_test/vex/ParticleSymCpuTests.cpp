@@ -0,0 +1,419 @@
+#include <webgpu/demos/path/ParticleSymCpu.h>
+#include <webgpu/demos/path/SimSession.h>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <vector>
+
+#include "../config.h"
+//
+using namespace vex;
+using namespace vex::flow;
+
+// ============================================================
+namespace
+{
+	constexpr u32 map_w = 16;
+	constexpr u32 map_h = 16;
+
+	struct TestWorld
+	{
+		SimulateUBO ubo{};
+		std::vector<u8> walkable;
+		WallField walls;
+		std::vector<v2f> flow;
+		std::vector<Particle> spawn;
+
+		ParticleSymCpu::MapView view() const
+		{
+			return {
+				.walls = &walls,
+				.flow = {flow.data(), (u32)flow.size()},
+			};
+		}
+	};
+
+	// walled border plus a pillar in the middle, flow pushes everything right and slightly down
+	TestWorld makeWorld(u32 num_particles)
+	{
+		TestWorld w;
+		w.ubo.bounds = {map_w, map_h};
+		w.ubo.grid_min = {-8, -8};
+		w.ubo.grid_size = {16, 16};
+		w.ubo.cell_size = {1, 1};
+		w.ubo.radius = 0.25f;
+		w.ubo.spatial_table_size = {map_w * 4, map_h * 4};
+		w.ubo.delta_time = 1.0f / 60.0f;
+
+		w.walkable.resize(map_w * map_h, 1);
+		w.flow.resize(map_w * map_h, v2f{0.8f, -0.6f});
+		for (u32 y = 0; y < map_h; ++y)
+			for (u32 x = 0; x < map_w; ++x)
+			{
+				const bool border = x == 0 || y == 0 || x == map_w - 1 || y == map_h - 1;
+				const bool pillar = x >= 7 && x <= 8 && y >= 6 && y <= 9;
+				if (border || pillar)
+					w.walkable[y * map_w + x] = 0;
+			}
+		w.walls.build({w.walkable.data(), (u32)w.walkable.size()}, {map_w, map_h});
+
+		u32 seed = 12345;
+		auto rnd = [&]() {
+			seed = seed * 1664525u + 1013904223u;
+			return f32(seed >> 8) / f32(1u << 24);
+		};
+		for (u32 i = 0; i < num_particles; ++i)
+		{
+			// spawn in the left open part, away from the walls
+			const v2f pos = {-6.5f + rnd() * 5.0f, -6.5f + rnd() * 13.0f};
+			w.spawn.push_back({pos, {0, 0}});
+		}
+		w.ubo.num_particles = num_particles;
+		return w;
+	}
+
+	// straightforward AoS brute force version of one step, kept independent from the SoA code
+	void referenceStep(const TestWorld& w, std::vector<Particle>& parts)
+	{
+		const SimulateUBO& u = w.ubo;
+		const f32 r = u.radius;
+		const f64 range = ParticleSymCpu::k_separation_range * r;
+
+		std::vector<Particle> before = parts;
+		for (u32 i = 0; i < (u32)parts.size(); ++i)
+		{
+			f64 ax = 0;
+			f64 ay = 0;
+			for (u32 j = 0; j < (u32)before.size(); ++j)
+			{
+				const f64 dx = before[j].pos.x - before[i].pos.x;
+				const f64 dy = before[j].pos.y - before[i].pos.y;
+				const f64 d = std::sqrt(dx * dx + dy * dy);
+				if (d > 0 && d < range)
+				{
+					ax -= dx / d;
+					ay -= dy / d;
+				}
+			}
+			parts[i].vel.x += f32(ax) * r * ParticleSymCpu::k_separation_push;
+			parts[i].vel.y += f32(ay) * r * ParticleSymCpu::k_separation_push;
+		}
+
+		const f32 dt = u.delta_time;
+		for (auto& p : parts)
+		{
+			i32 cx = (i32)((p.pos.x - u.grid_min.x) / u.cell_size.x);
+			i32 cy = (i32)u.bounds.y - (i32)((p.pos.y - u.grid_min.y) / u.cell_size.y + 1.0f);
+			cx = std::clamp(cx, 0, (i32)u.bounds.x - 1);
+			cy = std::clamp(cy, 0, (i32)u.bounds.y - 1);
+
+			const v2f target = w.flow[cy * u.bounds.x + cx] * u.speed_base * 2.0f;
+			v2f vel = p.vel * (1.0f - u.drag * dt);
+			if (vel.x == 0 && vel.y == 0)
+				vel = target;
+			vel = vel + (target - vel) * (dt * ((2.0f - u.inertia) * 2.0f + 0.5f));
+			vel = glm::clamp(vel, v2f(-4), v2f(4));
+			p.vel = vel;
+
+			v2f delta = vel * dt * 0.5f;
+			const v2f moved = p.pos + delta;
+			const WallField::Hit hit = w.walls.sample({(moved.x - u.grid_min.x) / u.cell_size.x,
+				(u.grid_min.y + u.grid_size.y - moved.y) / u.cell_size.y});
+			if (hit.dist * u.cell_size.x < r && glm::length(hit.grad) > 0)
+			{
+				const v2f normal = glm::normalize(v2f(hit.grad.x, -hit.grad.y));
+				delta += normal * (r - hit.dist * u.cell_size.x);
+			}
+			p.pos += delta;
+		}
+	}
+} // namespace
+
+TEST_CASE("ParticleSymCpu matches scalar reference trace", "[flow]")
+{
+	constexpr u32 num_particles = 300;
+	constexpr u32 num_steps = 60;
+	TestWorld w = makeWorld(num_particles);
+
+	ParticleSymCpu sym;
+	sym.spawn({w.spawn.data(), (u32)w.spawn.size()});
+	std::vector<Particle> ref = w.spawn;
+
+	for (u32 s = 0; s < num_steps; ++s)
+	{
+		sym.step(w.ubo, w.view());
+		referenceStep(w, ref);
+	}
+
+	REQUIRE(sym.size() == num_particles);
+	f32 max_err = 0;
+	for (u32 i = 0; i < num_particles; ++i)
+	{
+		const Particle p = sym.particle(i);
+		max_err = std::max(max_err, glm::length(p.pos - ref[i].pos));
+		max_err = std::max(max_err, glm::length(p.vel - ref[i].vel));
+	}
+	REQUIRE(max_err < 1e-3f);
+}
+
+TEST_CASE("ParticleSymCpu separation is symmetric and stays inside walls", "[flow]")
+{
+	TestWorld w = makeWorld(0);
+	std::fill(w.flow.begin(), w.flow.end(), v2f{0, 0});
+	w.spawn = {{{-3.1f, 0.0f}, {0, 0}}, {{-2.9f, 0.0f}, {0, 0}}};
+
+	ParticleSymCpu sym;
+	sym.spawn({w.spawn.data(), (u32)w.spawn.size()});
+	sym.step(w.ubo, w.view());
+
+	const Particle a = sym.particle(0);
+	const Particle b = sym.particle(1);
+	REQUIRE(a.vel.x < 0);
+	REQUIRE(b.vel.x > 0);
+	REQUIRE(std::abs(a.vel.x + b.vel.x) < 1e-6f);
+	REQUIRE(std::abs(a.pos.y) < 1e-6f);
+
+	// push a particle into the left border wall for a while, it must not pass through
+	std::fill(w.flow.begin(), w.flow.end(), v2f{-1, 0});
+	w.spawn = {{{-6.5f, 0.5f}, {0, 0}}};
+	sym.spawn({w.spawn.data(), (u32)w.spawn.size()});
+	for (u32 s = 0; s < 240; ++s)
+		sym.step(w.ubo, w.view());
+	REQUIRE(sym.particle(0).pos.x > -7.0f + w.ubo.radius * 0.5f);
+}
+
+TEST_CASE("WallField distance and gradient near walls", "[flow]")
+{
+	TestWorld w = makeWorld(0);
+	const WallField& f = w.walls;
+	REQUIRE(f.size.x == map_w * f.subdiv + 1);
+	REQUIRE(f.size.y == map_h * f.subdiv + 1);
+
+	// half a cell right of the left border wall, gradient points right (away from it)
+	WallField::Hit h = f.sample({1.5f, 3.5f});
+	REQUIRE(std::abs(h.dist - 0.5f) < 1e-3f);
+	REQUIRE(h.grad.x > 0.99f);
+	REQUIRE(std::abs(h.grad.y) < 1e-3f);
+
+	// inside the pillar (cells 7..8, rows 6..9), a quarter cell from its top edge
+	h = f.sample({8.0f, 6.25f});
+	REQUIRE(std::abs(h.dist + 0.25f) < 1e-3f);
+	REQUIRE(h.grad.y < -0.99f);
+
+	// open space further than the search reach is clamped and has no direction
+	h = f.sample({4.5f, 12.0f});
+	REQUIRE(h.dist == (f32)WallField::k_reach);
+	REQUIRE(h.grad.x == 0);
+	REQUIRE(h.grad.y == 0);
+}
+
+TEST_CASE("Packed particle keeps position and velocity precision", "[flow]")
+{
+	const v2f grid_min = {-8, -8};
+	const v2f grid_size = {16, 16};
+	// unorm16 over the grid rect, f16 velocity has 11 significant bits
+	const f32 pos_step = grid_size.x / 65535.0f;
+	const f32 vel_rel_err = 1.0f / 1024.0f;
+
+	TestWorld w = makeWorld(200);
+	for (Particle p : w.spawn)
+	{
+		p.vel = {(p.pos.x + 8) * 0.25f - 2, (p.pos.y + 8) * -0.25f + 2};
+		const Particle q = PackedParticle::pack(p, grid_min, grid_size).unpack(grid_min, grid_size);
+		REQUIRE(std::abs(q.pos.x - p.pos.x) <= pos_step * 0.5f + 1e-6f);
+		REQUIRE(std::abs(q.pos.y - p.pos.y) <= pos_step * 0.5f + 1e-6f);
+		REQUIRE(std::abs(q.vel.x - p.vel.x) <= std::abs(p.vel.x) * vel_rel_err + 1e-7f);
+		REQUIRE(std::abs(q.vel.y - p.vel.y) <= std::abs(p.vel.y) * vel_rel_err + 1e-7f);
+	}
+
+	// outside the grid rect positions clamp to its edges
+	const Particle out = {{-9, 9}, {0, 0}};
+	const Particle q = PackedParticle::pack(out, grid_min, grid_size).unpack(grid_min, grid_size);
+	REQUIRE(q.pos.x == grid_min.x);
+	REQUIRE(q.pos.y == grid_min.y + grid_size.y);
+	REQUIRE(particleStride(ParticleFormat::k_packed) * 2 == particleStride(ParticleFormat::k_f32));
+}
+
+TEST_CASE("SimClock steps do not depend on frame rate", "[flow]")
+{
+	// one simulated second at 30, 60 and 144 frames per second
+	for (const u32 fps : {30u, 60u, 144u})
+	{
+		SimClock clock{.step = 1.0f / 120.0f, .max_steps = 8};
+		u32 steps = 0;
+		for (u32 frame = 0; frame < fps; ++frame)
+			steps += clock.advance(1.0f / f32(fps));
+		REQUIRE(steps >= 119);
+		REQUIRE(steps <= 120);
+	}
+
+	// a stall is capped instead of being caught up
+	SimClock clock{.step = 1.0f / 120.0f, .max_steps = 4};
+	REQUIRE(clock.advance(1.0f) == 4);
+	REQUIRE(clock.accumulator == 0);
+
+	// fast particles get more substeps, small particles and cells too
+	const f32 step = 1.0f / 60.0f;
+	const f32 speed = glm::length(v2f(SimClock::k_max_vel));
+	const u32 base = SimClock::substeps(step, speed, 0.01f, 1.0f, 32);
+	REQUIRE(base > 1);
+	REQUIRE(SimClock::substeps(step, speed * 2, 0.01f, 1.0f, 32) >= base * 2 - 1);
+	REQUIRE(SimClock::substeps(step, speed * 0.25f, 0.01f, 1.0f, 32) < base);
+	REQUIRE(SimClock::substeps(step, speed, 0.005f, 1.0f, 32) >= base * 2 - 1);
+	REQUIRE(SimClock::substeps(step, speed, 0.01f, 0.01f, 32) > base);
+	REQUIRE(SimClock::substeps(step, speed, 0.001f, 1.0f, 8) == 8);
+	REQUIRE(SimClock::substeps(step, speed, 1.0f, 4.0f, 8) == 1);
+	REQUIRE(SimClock::substeps(step, 0.0f, 0.01f, 1.0f, 8) == 1);
+
+	// planned speed follows the measured one, never below cruise or above the clamp
+	REQUIRE(SimClock::plannedSpeed(0.0f, 1.0f) == SimClock::k_speed_headroom);
+	REQUIRE(SimClock::plannedSpeed(2.0f, 1.0f) > SimClock::plannedSpeed(1.0f, 1.0f));
+	REQUIRE(SimClock::plannedSpeed(100.0f, 1.0f) == speed);
+}
+
+TEST_CASE("Crowd density lands in map cells and only stuck crowds cost more", "[flow]")
+{
+	TestWorld w = makeWorld(300);
+	for (u32 i = 0; i < (u32)w.spawn.size(); ++i)
+		w.spawn[i].vel = i % 2 ? v2f{1, 0} : v2f{3, 0};
+	w.ubo.speed_max = 4.0f;
+	ParticleSymCpu sym;
+	sym.spawn({w.spawn.data(), (u32)w.spawn.size()});
+	sym.hash(w.ubo);
+	std::vector<v4f> density;
+	sym.density(w.ubo, density);
+	REQUIRE(density.size() == map_w * map_h);
+
+	std::vector<u32> expected(map_w * map_h, 0);
+	for (const Particle& p : w.spawn)
+	{
+		const u32 cx = (u32)(p.pos.x - w.ubo.grid_min.x);
+		const u32 cy = map_h - 1 - (u32)(p.pos.y - w.ubo.grid_min.y);
+		expected[cy * map_w + cx]++;
+	}
+	f32 total = 0;
+	for (u32 c = 0; c < map_w * map_h; ++c)
+	{
+		REQUIRE(density[c].x == f32(expected[c]));
+		total += density[c].x;
+		if (density[c].x == 0)
+			continue;
+		// every velocity is (1, 0) or (3, 0)
+		REQUIRE(density[c].y >= 1.0f);
+		REQUIRE(density[c].y <= 3.0f);
+		REQUIRE(density[c].z == 0.0f);
+		REQUIRE(std::abs(density[c].w - density[c].y / 4.0f) < 1e-5f);
+	}
+	REQUIRE(total == 300.0f);
+
+	const CrowdCost crowd{.weight = 1.0f, .comfort = 2.0f, .max_extra = 15};
+	REQUIRE(crowd.cost(v4f(0)) == 1);
+	REQUIRE(crowd.cost(v4f(2, 0, 0, 0)) == 1);
+	REQUIRE(crowd.cost(v4f(6, 0, 0, 0)) == 5);
+	REQUIRE(crowd.cost(v4f(6, 4, 0, 1)) == 1); // dense but flowing at full speed
+	REQUIRE(crowd.cost(v4f(100, 0, 0, 0)) == 16);
+	REQUIRE(CrowdCost{}.cost(v4f(100, 0, 0, 0)) == 1);
+}
+
+TEST_CASE("Recorded session replays identically after save and load", "[flow]")
+{
+	TestWorld w = makeWorld(300);
+	// small deterministic batch around the cell, like spawns of the demo
+	auto spawn = [](v2u32 cell, u32 counter)
+	{
+		std::vector<Particle> batch;
+		for (u32 i = 0; i < 16; ++i)
+		{
+			const f32 jx = f32((i * 7 + counter * 3) % 16) / 16.0f;
+			const f32 jy = f32((i * 11 + counter) % 16) / 16.0f;
+			batch.push_back({{-8.0f + f32(cell.x) + jx, 8.0f - f32(cell.y) - 1.0f + jy}, {0, 0}});
+		}
+		return batch;
+	};
+
+	SessionRecord rec;
+	rec.start.particles = w.spawn;
+	rec.start.goals = {{12, 3}};
+	rec.start.map_version = contentHash({w.walkable.data(), (u32)w.walkable.size()});
+	rec.start.settings.push_back({.key = "pf.PtSym_Radius", .bits = {0x3e80'0000u}});
+	// uneven frame times, the fixed step hides them
+	for (u32 frame = 0; frame < 40; ++frame)
+	{
+		rec.addFrame(frame % 3 == 0 ? 1.0f / 30.0f : 1.0f / 144.0f);
+		if (frame % 10 == 2)
+			rec.addEvent(SessionEvent::Kind::k_spawn, 0, {3, 4 + frame / 10});
+		if (frame == 25)
+			rec.addEvent(SessionEvent::Kind::k_goal, 1, {13, 12});
+	}
+	REQUIRE(rec.eventsAt(2).len == 1);
+	REQUIRE(rec.eventsAt(25).len == 1);
+	REQUIRE(rec.eventsAt(26).len == 0);
+
+	const std::string path =
+		(std::filesystem::temp_directory_path() / "vex_particle_session.bin").string();
+	REQUIRE(rec.save(path.c_str()));
+	SessionRecord loaded;
+	REQUIRE(loaded.load(path.c_str()));
+	std::filesystem::remove(path);
+	REQUIRE(loaded.frames() == rec.frames());
+	REQUIRE(loaded.events.size() == rec.events.size());
+	REQUIRE(loaded.start.map_version == rec.start.map_version);
+	REQUIRE(loaded.start.settings.size() == 1);
+	REQUIRE(loaded.start.settings[0].key == "pf.PtSym_Radius");
+	REQUIRE(loaded.start.goals.size() == 1);
+	REQUIRE(loaded.events[3].group == 1);
+
+	ParticleSymCpu first;
+	ParticleSymCpu second;
+	ParticleSymCpu::PassTimings timings;
+	const u64 hash_a = replayCpu(first, rec, w.ubo, w.view(), spawn, &timings);
+	const u64 hash_b = replayCpu(second, loaded, w.ubo, w.view(), spawn);
+	REQUIRE(first.size() == 300 + 4 * 16);
+	REQUIRE(hash_a == hash_b);
+	REQUIRE(timings.steps > 0);
+	REQUIRE(!loaded.load("vex_missing_session.bin"));
+}
+
+TEST_CASE("Session replay is deterministic and follows the recorded input", "[flow]")
+{
+	TestWorld w = makeWorld(200);
+	auto spawn = [](v2u32 cell, u32 counter)
+	{
+		std::vector<Particle> batch;
+		for (u32 i = 0; i < 32; ++i)
+		{
+			const f32 jitter = f32((i * 2654435761u + counter) >> 24) / 256.0f;
+			const v2f pos = {-8.0f + f32(cell.x) + jitter, 7.0f - f32(cell.y) + f32(i % 4) * 0.25f};
+			batch.push_back({pos, {0, 0}});
+		}
+		return batch;
+	};
+
+	// waves of spawns, goal moves and uneven frame times, like the replay bench
+	SessionRecord rec;
+	rec.start.particles = w.spawn;
+	rec.start.goals = {{12, 3}};
+	for (u32 frame = 0; frame < 60; ++frame)
+	{
+		rec.addFrame(frame % 7 == 0 ? 1.0f / 24.0f : 1.0f / 60.0f);
+		if (frame % 15 == 0)
+			rec.addEvent(SessionEvent::Kind::k_spawn, 0, {2 + frame / 15, 4});
+		if (frame == 20 || frame == 40)
+			rec.addEvent(SessionEvent::Kind::k_goal, 0, {frame / 4, 12});
+	}
+
+	// separate runs, nothing carried over but the record
+	ParticleSymCpu first;
+	ParticleSymCpu second;
+	const u64 hash_a = replayCpu(first, rec, w.ubo, w.view(), spawn);
+	const u64 hash_b = replayCpu(second, rec, w.ubo, w.view(), spawn);
+	REQUIRE(first.size() == 200 + 4 * 32);
+	REQUIRE(hash_a == hash_b);
+
+	// a different frame time changes the number of fixed steps and so the end state
+	SessionRecord other = rec;
+	other.frame_dt[10] = 1.0f / 10.0f;
+	ParticleSymCpu third;
+	REQUIRE(replayCpu(third, other, w.ubo, w.view(), spawn) != hash_a);
+}